@@ -0,0 +1,79 @@
+// Checks that lex_parallel() produces exactly the tokens of lex() and
+// measures its speedup. The generated shader is dense with block comments,
+// continued line comments and multi-line macros, so chunk boundaries
+// regularly fall inside them.
+//
+// Usage: bench_lex [megabytes] [max chunks]
+
+#include "corpus.hpp"
+#include "lexer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+static bool same_tokens(const std::vector<Token>& a, const std::vector<Token>& b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].kind != b[i].kind || a[i].offset != b[i].offset || a[i].length != b[i].length
+            || a[i].line != b[i].line || a[i].character != b[i].character) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename F>
+static double best_of(int runs, F f)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, std::chrono::duration<double, std::milli>(elapsed).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    unsigned max_chunks = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+
+    CorpusOptions options;
+    options.functions = 0;
+    options.size = megabytes << 20;
+    options.comment_density = 0.3;
+    options.macro_density = 0.3;
+    std::string text = generate_shader(options, "frag");
+    auto serial = lex(text);
+
+    // Many small chunks put boundaries in every kind of construct.
+    for (unsigned chunks : { 2u, 3u, 7u, 64u, 1000u }) {
+        if (!same_tokens(serial, lex_parallel(text, chunks))) {
+            std::printf("MISMATCH with %u chunks\n", chunks);
+            return 1;
+        }
+    }
+
+    double serial_ms = best_of(5, [&] { lex(text); });
+    std::printf("%zu MiB, %zu tokens\n", megabytes, serial.size());
+    std::printf("serial:    %8.2f ms\n", serial_ms);
+    for (unsigned chunks = 2; chunks <= max_chunks; chunks *= 2) {
+        std::vector<Token> tokens;
+        double ms = best_of(5, [&] { tokens = lex_parallel(text, chunks); });
+        if (!same_tokens(serial, tokens)) {
+            std::printf("MISMATCH with %u chunks\n", chunks);
+            return 1;
+        }
+        std::printf("%2u chunks: %8.2f ms (%.2fx)\n", chunks, ms, serial_ms / ms);
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Compares the heap traffic of parsing with a fresh glslang process and pool
+// per parse, as the server used to, with parsing into the thread's ParsePool.
+//
+// Usage: bench_parse_alloc [iterations] [shader files...]
+//
+// Without files, a generated shader of every stage is parsed.
+
+#include "analysis.hpp"
+#include "corpus.hpp"
+#include "parsepool.hpp"
+
+#include "ResourceLimits.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+
+static std::atomic<size_t> allocations{ 0 };
+static std::atomic<size_t> allocated_bytes{ 0 };
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    allocated_bytes += size;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+struct Sample {
+    std::string name;
+    std::string text;
+};
+
+struct Result {
+    double microseconds_per_parse;
+    double allocations_per_parse;
+    double bytes_per_parse;
+};
+
+template <typename F>
+static Result measure(const std::vector<Sample>& samples, int iterations, F&& parse)
+{
+    // Warm up, so that one-time setup isn't attributed to either side.
+    for (const auto& sample : samples) {
+        parse(sample);
+    }
+
+    size_t allocations_before = allocations;
+    size_t bytes_before = allocated_bytes;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        for (const auto& sample : samples) {
+            parse(sample);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    double parses = static_cast<double>(iterations) * samples.size();
+    return {
+        std::chrono::duration<double, std::micro>(elapsed).count() / parses,
+        (allocations - allocations_before) / parses,
+        (allocated_bytes - bytes_before) / parses,
+    };
+}
+
+static void print(const char* name, const Result& result)
+{
+    std::printf("%-28s %12.1f us %12.1f allocs %14.1f bytes\n", name,
+        result.microseconds_per_parse, result.allocations_per_parse, result.bytes_per_parse);
+}
+
+int main(int argc, char* argv[])
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+
+    std::vector<Sample> samples;
+    for (int i = 2; i < argc; ++i) {
+        if (!find_language(argv[i])) {
+            std::fprintf(stderr, "Skipping %s: not a shader stage glslang knows\n", argv[i]);
+            continue;
+        }
+        std::ifstream in(argv[i]);
+        samples.push_back({ argv[i], std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()) });
+    }
+    if (samples.empty()) {
+        for (auto& shader : generate_corpus(CorpusOptions()).shaders) {
+            samples.push_back({ shader.path, std::move(shader.text) });
+        }
+    }
+
+    TBuiltInResource resources = glslang::DefaultTBuiltInResource;
+
+    // Must run first: once ensure_glslang_initialized() was called, the
+    // process stays initialized and FinalizeProcess() no longer tears down.
+    auto fresh = measure(samples, iterations, [&](const Sample& sample) {
+        const char* text = sample.text.c_str();
+        glslang::InitializeProcess();
+        {
+            glslang::TShader shader(*find_language(sample.name));
+            shader.setStrings(&text, 1);
+            shader.parse(&resources, 110, false, EShMsgCascadingErrors);
+        }
+        glslang::FinalizeProcess();
+    });
+
+    auto pooled = measure(samples, iterations, [&](const Sample& sample) {
+        const char* text = sample.text.c_str();
+        ensure_glslang_initialized();
+        PooledShader shader(*find_language(sample.name), sample.text.size());
+        shader.setStrings(&text, 1);
+        shader.parse(&resources, 110, false, EShMsgCascadingErrors);
+    });
+
+    auto analyzed = measure(samples, iterations, [&](const Sample& sample) {
+        analyze_document(sample.name, sample.text);
+    });
+
+    std::printf("%zu shader(s), %d iterations, per parse:\n", samples.size(), iterations);
+    print("fresh process and pool", fresh);
+    print("thread ParsePool", pooled);
+    print("analyze_document", analyzed);
+
+    auto stats = parse_pool_stats();
+    std::printf("pool: %zu parses, %zu reuses, %zu trims, high water %zu bytes\n",
+        stats.parses, stats.reuses, stats.trims, stats.high_water);
+    return 0;
+}
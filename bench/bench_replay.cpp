@@ -0,0 +1,108 @@
+// Replays a synthetic editing session through the protocol layer: documents
+// are opened, edited keystroke by keystroke, completed in and closed, and
+// every response is encoded as if it was sent. Built once against glibc
+// malloc (bench_replay) and once with the slab allocator (bench_replay_slab)
+// to compare the two.
+//
+// Usage: bench_replay [documents] [edits per document]
+
+#include "allocator.hpp"
+#include "corpus.hpp"
+#include "messagebuffer.hpp"
+#include "server.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static std::string make_frame(const json& body)
+{
+    std::string content = body.dump();
+    return "Content-Length: " + std::to_string(content.size()) + "\r\n\r\n" + content;
+}
+
+// The line of the latest edit_shader() edit.
+static int last_edit_line(const std::string& text)
+{
+    auto end = text.rfind('}');
+    return static_cast<int>(std::count(text.begin(), text.begin() + end, '\n')) - 1;
+}
+
+static std::vector<std::string> make_session(int documents, int edits)
+{
+    std::vector<std::string> frames;
+    int id = 0;
+    CorpusOptions options;
+    options.functions = 4;
+    frames.push_back(make_frame({ { "jsonrpc", "2.0" }, { "id", id++ }, { "method", "initialize" }, { "params", json::object() } }));
+    for (int d = 0; d < documents; ++d) {
+        std::string uri = "file:///bench/shader" + std::to_string(d) + ".frag";
+        std::string shader = generate_shader(options, "frag", d);
+        frames.push_back(make_frame({ { "jsonrpc", "2.0" }, { "method", "textDocument/didOpen" },
+            { "params", { { "textDocument", { { "uri", uri }, { "version", 0 }, { "text", shader } } } } } }));
+        for (int e = 1; e <= edits; ++e) {
+            std::string text = edit_shader(shader, e);
+            frames.push_back(make_frame({ { "jsonrpc", "2.0" }, { "method", "textDocument/didChange" },
+                { "params", {
+                    { "textDocument", { { "uri", uri }, { "version", e } } },
+                    { "contentChanges", { { { "text", text } } } },
+                } } }));
+            frames.push_back(make_frame({ { "jsonrpc", "2.0" }, { "id", id++ }, { "method", "textDocument/completion" },
+                { "params", { { "textDocument", { { "uri", uri } } }, { "position", { { "line", last_edit_line(text) }, { "character", 9 } } } } } }));
+        }
+        frames.push_back(make_frame({ { "jsonrpc", "2.0" }, { "method", "textDocument/didClose" },
+            { "params", { { "textDocument", { { "uri", uri } } } } } }));
+    }
+    return frames;
+}
+
+int main(int argc, char* argv[])
+{
+    int documents = argc > 1 ? std::atoi(argv[1]) : 50;
+    int edits = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    auto frames = make_session(documents, edits);
+
+    AppState appstate;
+#ifdef GLSLLS_SLAB_ALLOCATOR
+    appstate.allocator_stats = allocator_stats;
+#endif
+
+    size_t bytes_out = 0;
+    auto start = std::chrono::steady_clock::now();
+    MessageBuffer message_buffer;
+    for (const auto& frame : frames) {
+        message_buffer.handle_string(frame);
+        if (message_buffer.message_completed()) {
+            process_message(message_buffer, appstate);
+        }
+        message_buffer.clear();
+        while (auto response = next_frame(appstate)) {
+            bytes_out += response->size();
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+#ifdef GLSLLS_SLAB_ALLOCATOR
+    const char* allocator = "slab allocator";
+#else
+    const char* allocator = "malloc";
+#endif
+    double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+    std::printf("%s: %zu messages in %.1f ms (%.1f us/message), %zu bytes out\n",
+        allocator, frames.size(), ms, 1000.0 * ms / frames.size(), bytes_out);
+
+    if (appstate.allocator_stats) {
+        auto stats = appstate.allocator_stats();
+        std::printf("%zu spans, %zu large allocations, %zu cross-thread frees\n",
+            stats.spans, stats.large_allocations, stats.cross_thread_frees);
+        for (const auto& size_class : stats.size_classes) {
+            std::printf("%6zu bytes: %10zu allocations %10zu live bytes\n",
+                size_class.size, size_class.allocations, size_class.live_bytes);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Measures analysis throughput and latency while sweeping the number of
+// worker threads and of open documents. Every document is edited, then all
+// of them are analyzed at once on the core's scheduler, as after a branch
+// switch; latency is from that burst to each analysis being done.
+//
+// Usage: bench_scaling [max threads] [max documents] [csv|json]
+//
+// Thread counts double from 1 up to the maximum (one per hardware thread by
+// default), document counts grow tenfold from 1 up to the maximum (10000).
+// Progress goes to stderr, the CSV or JSON results to stdout.
+
+#include "core.hpp"
+#include "corpus.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct Point {
+    unsigned threads;
+    int documents;
+    double seconds;
+    double throughput;
+    double p50_ms;
+    double p99_ms;
+    double max_ms;
+};
+
+static Point run(unsigned threads, int documents)
+{
+    Core core(threads);
+    std::vector<std::string> uris;
+    std::vector<std::string> shaders;
+    for (int d = 0; d < documents; ++d) {
+        uris.push_back("file:///bench/shader" + std::to_string(d) + ".frag");
+        shaders.push_back(generate_shader(CorpusOptions(), "frag", d));
+        core.open_document(uris.back(), shaders.back());
+    }
+    for (int d = 0; d < documents; ++d) {
+        core.update_document(uris[d], edit_shader(shaders[d], 1), 1);
+    }
+
+    std::vector<double> latencies(documents);
+    std::vector<std::future<void>> pending;
+    auto start = Clock::now();
+    for (int d = 0; d < documents; ++d) {
+        pending.push_back(core.scheduler().async(Scheduler::Priority::Interactive, [&, d]() {
+            core.analysis(uris[d]);
+            latencies[d] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }));
+    }
+    for (auto& future : pending) {
+        future.get();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies[std::min<size_t>(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+    return { threads, documents, seconds, documents / seconds, percentile(0.5), percentile(0.99), latencies.back() };
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned max_threads = argc > 1 ? std::atoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+    int max_documents = argc > 2 ? std::atoi(argv[2]) : 10000;
+    bool json = argc > 3 && std::strcmp(argv[3], "json") == 0;
+
+    std::vector<unsigned> thread_counts;
+    for (unsigned threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    std::vector<Point> points;
+    for (int documents = 1; documents <= max_documents; documents *= 10) {
+        for (unsigned threads : thread_counts) {
+            points.push_back(run(threads, documents));
+            const auto& p = points.back();
+            std::fprintf(stderr, "%2u threads %6d documents: %8.1f documents/s, p99 %8.1f ms\n",
+                p.threads, p.documents, p.throughput, p.p99_ms);
+        }
+    }
+
+    // Scaling efficiency compares each point to one thread on as many
+    // documents; a shared lock shows up as efficiency falling with threads.
+    auto baseline = [&](const Point& point) {
+        for (const auto& p : points) {
+            if (p.documents == point.documents && p.threads == 1) {
+                return p.throughput;
+            }
+        }
+        return point.throughput;
+    };
+
+    if (json) {
+        std::printf("[\n");
+        for (size_t i = 0; i < points.size(); ++i) {
+            const auto& p = points[i];
+            std::printf("  {\"threads\": %u, \"documents\": %d, \"seconds\": %.6f, \"throughput\": %.3f, "
+                        "\"efficiency\": %.3f, \"p50_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}%s\n",
+                p.threads, p.documents, p.seconds, p.throughput, p.throughput / baseline(p) / p.threads,
+                p.p50_ms, p.p99_ms, p.max_ms, i + 1 < points.size() ? "," : "");
+        }
+        std::printf("]\n");
+    } else {
+        std::printf("threads,documents,seconds,throughput,efficiency,p50_ms,p99_ms,max_ms\n");
+        for (const auto& p : points) {
+            std::printf("%u,%d,%.6f,%.3f,%.3f,%.3f,%.3f,%.3f\n", p.threads, p.documents, p.seconds,
+                p.throughput, p.throughput / baseline(p) / p.threads, p.p50_ms, p.p99_ms, p.max_ms);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Measures selection ranges on a generated shader: building the syntax tree,
+// which happens once per analysis, and answering requests for many cursors
+// at once, as one sweep and one position at a time. Also checks that every
+// range contains the one before it.
+//
+// Usage: bench_selection [cursors]
+
+#include "corpus.hpp"
+#include "syntaxtree.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double milliseconds(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+static bool nested(const SyntaxRange& inner, const SyntaxRange& outer)
+{
+    return std::tie(outer.start_line, outer.start_character) <= std::tie(inner.start_line, inner.start_character)
+        && std::tie(inner.end_line, inner.end_character) <= std::tie(outer.end_line, outer.end_character);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t cursors = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+
+    CorpusOptions options;
+    options.functions = 0;
+    options.size = 1 << 20;
+    std::string text = generate_shader(options, "frag");
+
+    auto lex_start = Clock::now();
+    auto tokens = lex(text);
+    auto lexed = Clock::now();
+    auto tree = build_syntax_tree(text, tokens);
+    auto built = Clock::now();
+
+    // Positions on random tokens, in no particular order, as a multi-cursor
+    // edit spread over the document would send them.
+    std::mt19937 random(1);
+    std::vector<std::pair<int, int>> positions;
+    for (size_t i = 0; i < cursors; ++i) {
+        const Token& token = tokens[random() % tokens.size()];
+        positions.emplace_back(token.line, token.character + random() % (token.length + 1));
+    }
+
+    auto start = Clock::now();
+    auto swept = selection_ranges(tree, positions);
+    auto sweep_time = milliseconds(start, Clock::now());
+
+    start = Clock::now();
+    std::vector<std::vector<SyntaxRange>> single;
+    for (const auto& position : positions) {
+        single.push_back(selection_ranges(tree, { position })[0]);
+    }
+    auto single_time = milliseconds(start, Clock::now());
+
+    size_t depth = 0;
+    for (size_t i = 0; i < positions.size(); ++i) {
+        const auto& ranges = swept[i];
+        if (ranges.empty() || ranges.size() != single[i].size()) {
+            std::printf("MISMATCH at position %zu\n", i);
+            return 1;
+        }
+        for (size_t j = 1; j < ranges.size(); ++j) {
+            if (!nested(ranges[j - 1], ranges[j])) {
+                std::printf("MISMATCH: range %zu of position %zu isn't nested\n", j, i);
+                return 1;
+            }
+        }
+        depth += ranges.size();
+    }
+
+    std::printf("%zu bytes, %zu tokens, %zu nodes\n", text.size(), tokens.size(), tree.nodes.size());
+    std::printf("lex %.3f ms, build %.3f ms\n", milliseconds(lex_start, lexed), milliseconds(lexed, built));
+    std::printf("%zu cursors, %.1f ranges each: %.3f ms in one sweep, %.3f ms one by one\n", cursors,
+        cursors ? static_cast<double>(depth) / cursors : 0.0, sweep_time, single_time);
+    return 0;
+}
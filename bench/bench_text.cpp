@@ -0,0 +1,188 @@
+// Compares the text utilities with the regex-based split_string() and the
+// copying trims they replaced: time and heap allocations for splitting a
+// generated shader into lines, trimming each line and classifying its
+// characters. Also checks that both give the same fields.
+//
+// Usage: bench_text [iterations]
+
+#include "corpus.hpp"
+#include "text.hpp"
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <regex>
+#include <string>
+#include <vector>
+
+static std::atomic<size_t> allocations{ 0 };
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// The functions of the former utils.cpp.
+static std::vector<std::string> legacy_split_string(const std::string& string_to_split, const std::string& pattern)
+{
+    std::vector<std::string> result;
+    const std::regex re(pattern);
+    std::sregex_token_iterator iter(string_to_split.begin(), string_to_split.end(), re, -1);
+    for (std::sregex_token_iterator end; iter != end; ++iter) {
+        result.push_back(iter->str());
+    }
+    return result;
+}
+
+static std::string legacy_trim_right(const std::string& s, const std::string& delimiters)
+{
+    return s.substr(0, s.find_last_not_of(delimiters) + 1);
+}
+
+static std::string legacy_trim_left(const std::string& s, const std::string& delimiters)
+{
+    return s.substr(s.find_first_not_of(delimiters));
+}
+
+static std::string legacy_trim(const std::string& s, const std::string& delimiters)
+{
+    return legacy_trim_left(legacy_trim_right(s, delimiters), delimiters);
+}
+
+struct Result {
+    double milliseconds;
+    size_t allocations;
+    size_t checksum;
+};
+
+template <typename F>
+static Result measure(int iterations, F f)
+{
+    size_t checksum = 0;
+    size_t allocations_before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        checksum += f();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return {
+        std::chrono::duration<double, std::milli>(elapsed).count() / iterations,
+        (allocations - allocations_before) / iterations,
+        checksum,
+    };
+}
+
+static void print(const char* name, const Result& legacy, const Result& current)
+{
+    std::printf("%-10s %10.3f ms %10zu allocs -> %10.3f ms %10zu allocs (%.1fx)\n", name,
+        legacy.milliseconds, legacy.allocations, current.milliseconds, current.allocations,
+        current.milliseconds > 0 ? legacy.milliseconds / current.milliseconds : 0.0);
+}
+
+int main(int argc, char* argv[])
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+
+    CorpusOptions options;
+    options.functions = 0;
+    options.size = 1 << 20;
+    options.comment_density = 0.2;
+    // Without a trailing line break, so that split_string() and split()
+    // agree on the last line.
+    std::string text = generate_shader(options, "frag");
+    text.pop_back();
+
+    auto legacy_lines = legacy_split_string(text, "\n");
+    size_t line = 0;
+    for (std::string_view field : split(text, "\n")) {
+        if (line >= legacy_lines.size() || field != legacy_lines[line]) {
+            std::printf("MISMATCH at line %zu\n", line);
+            return 1;
+        }
+        // The former trim() threw on lines of only whitespace.
+        bool blank = field.find_first_not_of(whitespace) == std::string_view::npos;
+        if (blank ? !trim(field).empty() : trim(field) != legacy_trim(legacy_lines[line], " \f\n\r\t\v")) {
+            std::printf("MISMATCH trimming line %zu\n", line);
+            return 1;
+        }
+        ++line;
+    }
+    if (line != legacy_lines.size()) {
+        std::printf("MISMATCH\n");
+        return 1;
+    }
+
+    auto split_legacy = measure(iterations, [&] {
+        size_t bytes = 0;
+        for (const auto& field : legacy_split_string(text, "\n")) {
+            bytes += field.size();
+        }
+        return bytes;
+    });
+    auto split_current = measure(iterations, [&] {
+        size_t bytes = 0;
+        for (std::string_view field : split(text, "\n")) {
+            bytes += field.size();
+        }
+        return bytes;
+    });
+    print("split", split_legacy, split_current);
+
+    auto trim_legacy = measure(iterations, [&] {
+        size_t bytes = 0;
+        for (const auto& field : legacy_lines) {
+            if (field.find_first_not_of(" \f\n\r\t\v") != std::string::npos) {
+                bytes += legacy_trim(field, " \f\n\r\t\v").size();
+            }
+        }
+        return bytes;
+    });
+    auto trim_current = measure(iterations, [&] {
+        size_t bytes = 0;
+        for (std::string_view field : split(text, "\n")) {
+            bytes += trim(field).size();
+        }
+        return bytes;
+    });
+    print("trim", trim_legacy, trim_current);
+
+    auto classify_legacy = measure(iterations, [&] {
+        size_t identifier_chars = 0;
+        for (char c : text) {
+            identifier_chars += std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+        }
+        return identifier_chars;
+    });
+    auto classify_current = measure(iterations, [&] {
+        size_t identifier_chars = 0;
+        for (char c : text) {
+            identifier_chars += is_identifier_char(c);
+        }
+        return identifier_chars;
+    });
+    print("classify", classify_legacy, classify_current);
+
+    if (split_legacy.checksum != split_current.checksum || trim_legacy.checksum != trim_current.checksum || classify_legacy.checksum != classify_current.checksum) {
+        std::printf("MISMATCH in results\n");
+        return 1;
+    }
+    std::printf("%zu bytes, %zu lines, %d iterations\n", text.size(), line, iterations);
+    return 0;
+}
@@ -0,0 +1,155 @@
+# Profile-guided optimization.
+#
+# With GLSLLS_PGO, the pgo target builds glslls twice in ${CMAKE_BINARY_DIR}/pgo
+# next to a plain RelWithDebInfo build, as the Makefile makes:
+#
+#   pgo-baseline    RelWithDebInfo build with the benchmarks, for comparison
+#   pgo-instrument  instrumented build (GLSLLS_PGO_PHASE=instrument)
+#   pgo-train       runs glslls on a generated corpus and the benchmarks
+#                   replaying editing sessions, collecting profiles
+#   pgo-optimize    the same build directory rebuilt with the profiles and
+#                   LTO (GLSLLS_PGO_PHASE=optimize)
+#   pgo-report      runs the benchmarks of both builds and writes
+#                   pgo/report.txt
+#
+# Both phases use the same build directory because GCC finds the profile of
+# an object by the object's path. The flags are added before any target is
+# defined, so that glslang, whose parser is where most of the time goes, is
+# instrumented and optimized as well.
+
+set(GLSLLS_PGO_PHASE "" CACHE STRING "Set by the pgo target: instrument or optimize")
+set(GLSLLS_PGO_PROFILE_DIR "${CMAKE_BINARY_DIR}/profile" CACHE PATH "Where profiles are written and read")
+
+if(GLSLLS_PGO_PHASE STREQUAL "instrument")
+    if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+        set(GLSLLS_PGO_FLAGS "-fprofile-generate=${GLSLLS_PGO_PROFILE_DIR} -fprofile-update=atomic")
+    elseif(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+        set(GLSLLS_PGO_FLAGS "-fprofile-instr-generate=${GLSLLS_PGO_PROFILE_DIR}/%p.profraw")
+    else()
+        message(FATAL_ERROR "Profile-guided optimization needs GCC or Clang")
+    endif()
+elseif(GLSLLS_PGO_PHASE STREQUAL "optimize")
+    if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+        # Threads update counters concurrently; -fprofile-correction smooths
+        # over what inconsistencies remain.
+        set(GLSLLS_PGO_FLAGS "-fprofile-use=${GLSLLS_PGO_PROFILE_DIR} -fprofile-correction -Wno-missing-profile -flto")
+        find_program(GLSLLS_GCC_AR gcc-ar)
+        find_program(GLSLLS_GCC_RANLIB gcc-ranlib)
+        if(GLSLLS_GCC_AR AND GLSLLS_GCC_RANLIB)
+            set(CMAKE_AR "${GLSLLS_GCC_AR}")
+            set(CMAKE_RANLIB "${GLSLLS_GCC_RANLIB}")
+        endif()
+    elseif(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+        set(GLSLLS_PGO_FLAGS "-fprofile-instr-use=${GLSLLS_PGO_PROFILE_DIR}/glslls.profdata -flto=thin -fuse-ld=lld")
+        find_program(GLSLLS_LLVM_AR llvm-ar)
+        find_program(GLSLLS_LLVM_RANLIB llvm-ranlib)
+        if(GLSLLS_LLVM_AR AND GLSLLS_LLVM_RANLIB)
+            set(CMAKE_AR "${GLSLLS_LLVM_AR}")
+            set(CMAKE_RANLIB "${GLSLLS_LLVM_RANLIB}")
+        endif()
+    else()
+        message(FATAL_ERROR "Profile-guided optimization needs GCC or Clang")
+    endif()
+elseif(NOT GLSLLS_PGO_PHASE STREQUAL "")
+    message(FATAL_ERROR "GLSLLS_PGO_PHASE must be instrument or optimize")
+endif()
+
+if(GLSLLS_PGO_FLAGS)
+    set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} ${GLSLLS_PGO_FLAGS}")
+    set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${GLSLLS_PGO_FLAGS}")
+    set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} ${GLSLLS_PGO_FLAGS}")
+    set(CMAKE_SHARED_LINKER_FLAGS "${CMAKE_SHARED_LINKER_FLAGS} ${GLSLLS_PGO_FLAGS}")
+endif()
+
+if(NOT GLSLLS_PGO)
+    return()
+endif()
+
+set(GLSLLS_PGO_ROOT "${CMAKE_BINARY_DIR}/pgo")
+set(GLSLLS_PGO_BASELINE "${GLSLLS_PGO_ROOT}/baseline")
+set(GLSLLS_PGO_BUILD "${GLSLLS_PGO_ROOT}/build")
+set(GLSLLS_PGO_PROFILES "${GLSLLS_PGO_ROOT}/profile")
+set(GLSLLS_PGO_CORPUS "${GLSLLS_PGO_ROOT}/corpus")
+
+set(GLSLLS_PGO_CONFIGURE
+    ${CMAKE_COMMAND} -G "${CMAKE_GENERATOR}"
+    -DCMAKE_BUILD_TYPE=RelWithDebInfo
+    -DCMAKE_C_COMPILER=${CMAKE_C_COMPILER}
+    -DCMAKE_CXX_COMPILER=${CMAKE_CXX_COMPILER}
+    -DGLSLLS_BUILD_BENCHMARKS=ON
+    -DGLSLLS_PGO=OFF
+)
+
+add_custom_target(pgo-baseline
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${GLSLLS_PGO_BASELINE}
+    COMMAND ${CMAKE_COMMAND} -E chdir ${GLSLLS_PGO_BASELINE}
+        ${GLSLLS_PGO_CONFIGURE} -DGLSLLS_PGO_PHASE= ${CMAKE_SOURCE_DIR}
+    COMMAND ${CMAKE_COMMAND} --build ${GLSLLS_PGO_BASELINE}
+    COMMENT "Building the RelWithDebInfo baseline"
+    VERBATIM
+)
+
+add_custom_target(pgo-instrument
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${GLSLLS_PGO_BUILD}
+    COMMAND ${CMAKE_COMMAND} -E chdir ${GLSLLS_PGO_BUILD}
+        ${GLSLLS_PGO_CONFIGURE} -DGLSLLS_PGO_PHASE=instrument
+        -DGLSLLS_PGO_PROFILE_DIR=${GLSLLS_PGO_PROFILES} ${CMAKE_SOURCE_DIR}
+    COMMAND ${CMAKE_COMMAND} --build ${GLSLLS_PGO_BUILD}
+    COMMENT "Building instrumented glslls"
+    VERBATIM
+)
+
+# The training run: glslls profiling generated shaders with includes, and the
+# benchmarks replaying editing sessions over generated corpora through the
+# protocol layer, the analysis and the scheduler.
+set(GLSLLS_PGO_TRAIN
+    COMMAND ${CMAKE_COMMAND} -E remove_directory ${GLSLLS_PGO_PROFILES}
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${GLSLLS_PGO_PROFILES}
+    COMMAND ${GLSLLS_PGO_BUILD}/tools/glslgen --out ${GLSLLS_PGO_CORPUS}
+        --stage vert --stage frag --stage comp --size 20000 --include-depth 2
+    COMMAND ${GLSLLS_PGO_BUILD}/glslls --profile ${GLSLLS_PGO_CORPUS}/shader0.vert
+    COMMAND ${GLSLLS_PGO_BUILD}/glslls --profile ${GLSLLS_PGO_CORPUS}/shader0.frag
+    COMMAND ${GLSLLS_PGO_BUILD}/glslls --profile ${GLSLLS_PGO_CORPUS}/shader0.comp
+    COMMAND ${GLSLLS_PGO_BUILD}/bench/bench_replay 20 20
+    COMMAND ${GLSLLS_PGO_BUILD}/bench/bench_parse_alloc 20
+    COMMAND ${GLSLLS_PGO_BUILD}/bench/bench_scaling 2 100
+)
+if(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+    find_program(GLSLLS_LLVM_PROFDATA llvm-profdata)
+    if(NOT GLSLLS_LLVM_PROFDATA)
+        message(FATAL_ERROR "GLSLLS_PGO with Clang needs llvm-profdata")
+    endif()
+    list(APPEND GLSLLS_PGO_TRAIN
+        COMMAND ${GLSLLS_LLVM_PROFDATA} merge -o ${GLSLLS_PGO_PROFILES}/glslls.profdata ${GLSLLS_PGO_PROFILES})
+endif()
+
+add_custom_target(pgo-train
+    ${GLSLLS_PGO_TRAIN}
+    COMMENT "Collecting profiles"
+    VERBATIM
+)
+add_dependencies(pgo-train pgo-instrument)
+
+add_custom_target(pgo-optimize
+    COMMAND ${CMAKE_COMMAND} -E chdir ${GLSLLS_PGO_BUILD}
+        ${GLSLLS_PGO_CONFIGURE} -DGLSLLS_PGO_PHASE=optimize
+        -DGLSLLS_PGO_PROFILE_DIR=${GLSLLS_PGO_PROFILES} ${CMAKE_SOURCE_DIR}
+    COMMAND ${CMAKE_COMMAND} --build ${GLSLLS_PGO_BUILD}
+    COMMENT "Building glslls with the profiles and LTO"
+    VERBATIM
+)
+add_dependencies(pgo-optimize pgo-train)
+
+add_custom_target(pgo-report
+    COMMAND ${CMAKE_COMMAND}
+        -DBASELINE=${GLSLLS_PGO_BASELINE}
+        -DOPTIMIZED=${GLSLLS_PGO_BUILD}
+        -DCORPUS=${GLSLLS_PGO_CORPUS}
+        -DOUTPUT=${GLSLLS_PGO_ROOT}/report.txt
+        -P ${CMAKE_CURRENT_LIST_DIR}/PGOReport.cmake
+    VERBATIM
+)
+add_dependencies(pgo-report pgo-baseline pgo-optimize)
+
+add_custom_target(pgo)
+add_dependencies(pgo pgo-report)
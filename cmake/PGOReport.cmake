@@ -0,0 +1,97 @@
+# Compares the benchmarks of the baseline and the profile-guided build.
+#
+# Usage: cmake -DBASELINE=dir -DOPTIMIZED=dir -DCORPUS=dir -DOUTPUT=file -P PGOReport.cmake
+
+# "12.3" -> 1230. CMake only does integer arithmetic.
+function(to_hundredths value out)
+    if(NOT value MATCHES "^([0-9]+)(\\.([0-9]*))?$")
+        message(FATAL_ERROR "Not a number: ${value}")
+    endif()
+    string(SUBSTRING "${CMAKE_MATCH_3}00" 0 2 fraction)
+    string(REGEX REPLACE "^0+([0-9])" "\\1" result "${CMAKE_MATCH_1}${fraction}")
+    set(${out} ${result} PARENT_SCOPE)
+endfunction()
+
+function(pad text width out)
+    string(LENGTH "${text}" length)
+    while(length LESS width)
+        set(text " ${text}")
+        math(EXPR length "${length} + 1")
+    endwhile()
+    set(${out} "${text}" PARENT_SCOPE)
+endfunction()
+
+# Runs `command` from the bin directory of both builds and extracts the first
+# capture of `regex` from its output. `better` is lower or higher.
+set(report "")
+set(failed FALSE)
+function(compare name regex better)
+    foreach(build BASELINE OPTIMIZED)
+        set(command ${ARGN})
+        list(GET command 0 program)
+        list(REMOVE_AT command 0)
+        execute_process(
+            COMMAND ${${build}}/${program} ${command}
+            OUTPUT_VARIABLE output
+            ERROR_VARIABLE errors
+            RESULT_VARIABLE result)
+        if(NOT result EQUAL 0 OR NOT output MATCHES "${regex}")
+            message(WARNING "${build}/${program} failed:\n${output}${errors}")
+            set(failed TRUE PARENT_SCOPE)
+            return()
+        endif()
+        set(${build}_value ${CMAKE_MATCH_1})
+    endforeach()
+
+    to_hundredths(${BASELINE_value} base)
+    to_hundredths(${OPTIMIZED_value} optimized)
+    if(base EQUAL 0)
+        set(change "n/a")
+    else()
+        # Improvement in tenths of a percent, positive when the optimized
+        # build is better.
+        if(better STREQUAL "lower")
+            math(EXPR permille "(${base} - ${optimized}) * 1000 / ${base}")
+        else()
+            math(EXPR permille "(${optimized} - ${base}) * 1000 / ${base}")
+        endif()
+        set(sign "+")
+        if(permille LESS 0)
+            set(sign "-")
+            math(EXPR permille "-${permille}")
+        endif()
+        math(EXPR whole "${permille} / 10")
+        math(EXPR tenth "${permille} % 10")
+        set(change "${sign}${whole}.${tenth}%")
+    endif()
+
+    pad("${BASELINE_value}" 12 base_text)
+    pad("${OPTIMIZED_value}" 12 optimized_text)
+    pad("${change}" 9 change_text)
+    set(report "${report}${base_text} ${optimized_text} ${change_text}  ${name}\n" PARENT_SCOPE)
+endfunction()
+
+compare("bench_replay, us per message (lower is better)"
+    "\\(([0-9.]+) us/message\\)" lower
+    bench/bench_replay 50 20)
+compare("bench_parse_alloc, analyze_document us per parse (lower is better)"
+    "analyze_document +([0-9.]+) us" lower
+    bench/bench_parse_alloc 100)
+compare("bench_parse_alloc, pooled glslang us per parse (lower is better)"
+    "thread ParsePool +([0-9.]+) us" lower
+    bench/bench_parse_alloc 100)
+compare("bench_scaling, 1 thread 1000 documents, documents/s (higher is better)"
+    "\n1,1000,[0-9.]+,([0-9.]+)," higher
+    bench/bench_scaling 1 1000 csv)
+foreach(stage vert frag comp)
+    compare("glslls --profile shader0.${stage}, ms (lower is better)"
+        "Profile of [^\n]*: ([0-9.]+) ms" lower
+        glslls --profile ${CORPUS}/shader0.${stage})
+endforeach()
+
+set(report "PGO + LTO build (${OPTIMIZED}/glslls) against RelWithDebInfo (${BASELINE}/glslls)\n\n    baseline    optimized    change\n${report}")
+file(WRITE ${OUTPUT} "${report}")
+message("${report}\nWritten to ${OUTPUT}")
+if(failed)
+    message(FATAL_ERROR "Some benchmarks failed")
+endif()
@@ -0,0 +1,391 @@
+// A fuzzer looking for slow inputs rather than crashes. It mutates LSP frames
+// and shaders, drives them through MessageBuffer and the analysis (parse,
+// AST traversal, scope tree, diagnostics and completion), and keeps the
+// inputs that cost the most time or peak memory per input byte. Inputs that
+// only grow linearly score the same however long they get, so the corpus
+// fills up with superlinear behaviours.
+//
+// The corpus is written to --out as <target>-<rank>.in. --replay runs such
+// a directory as a regression benchmark and fails if any input costs more
+// than --budget.
+
+#include "CLI/CLI.hpp"
+
+#include "corpus.hpp"
+#include "messagebuffer.hpp"
+#include "server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <experimental/filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <malloc.h>
+
+namespace fs = std::experimental::filesystem;
+
+// Peak memory is tracked through the global allocation functions.
+static std::atomic<size_t> live_bytes{ 0 };
+static std::atomic<size_t> peak_bytes{ 0 };
+
+void* operator new(size_t size)
+{
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    size_t live = live_bytes += malloc_usable_size(p);
+    size_t peak = peak_bytes;
+    while (live > peak && !peak_bytes.compare_exchange_weak(peak, live)) {
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p) {
+        live_bytes -= malloc_usable_size(p);
+        std::free(p);
+    }
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+static std::string frame(const std::string& body, const std::string& extra_headers = "")
+{
+    return "Content-Length: " + std::to_string(body.size()) + "\r\n" + extra_headers + "\r\n" + body;
+}
+
+// Small generated shaders, one of them broken, as the analyzer sees both.
+static std::vector<std::string> shader_seeds()
+{
+    CorpusOptions options;
+    options.functions = 2;
+    options.structs = 1;
+    options.macro_density = 0.3;
+    options.comment_density = 0.3;
+    std::vector<std::string> seeds;
+    for (int i = 0; i < 3; ++i) {
+        seeds.push_back(generate_shader(options, "frag", i));
+    }
+    options.error_rate = 1;
+    seeds.push_back(generate_shader(options, "frag", 3));
+    return seeds;
+}
+
+struct Target {
+    const char* name;
+    std::vector<std::string> seeds;
+
+    // Fragments that are more likely to reach deep code than random bytes.
+    std::vector<std::string> dictionary;
+    std::function<void(const std::string&)> run;
+};
+
+static std::vector<Target> make_targets(AppState& appstate)
+{
+    std::vector<std::string> frame_seeds{
+        frame(R"({"jsonrpc":"2.0","id":1,"method":"initialize","params":{}})"),
+        frame(R"({"jsonrpc":"2.0","method":"textDocument/didClose","params":{"textDocument":{"uri":"file:///a.frag"}}})",
+            "Content-Type: application/vscode-jsonrpc; charset=utf-8\r\n"),
+    };
+    std::vector<std::string> frame_dictionary{
+        "Content-Length: ", "Content-Type: application/cbor", "Content-Type: application/msgpack",
+        "\r\n", "\r\n\r\n", ": ", "{", "}", "[", "]", "\"", "\\u0000", "0", "99999",
+    };
+
+    // MessageBuffer and the analysis don't throw on malformed input; if they
+    // did, the fuzzer would stop on it.
+    auto feed_chars = [](const std::string& input) {
+        MessageBuffer message_buffer;
+        for (char c : input) {
+            message_buffer.handle_char(c);
+            if (message_buffer.message_completed()) {
+                message_buffer.clear();
+            }
+        }
+    };
+    auto feed_string = [](const std::string& input) {
+        MessageBuffer message_buffer;
+        message_buffer.handle_string(input);
+    };
+    auto analyze = [&appstate](const std::string& input) {
+        const std::string uri = "file:///fuzz.frag";
+        appstate.core.open_document(uri, input);
+        get_diagnostics(uri, appstate);
+        appstate.core.complete(uri, std::count(input.begin(), input.end(), '\n') / 2, 4);
+        appstate.core.close_document(uri);
+    };
+
+    return {
+        { "frame-chars", frame_seeds, frame_dictionary, feed_chars },
+        { "frame-string", frame_seeds, frame_dictionary, feed_string },
+        { "shader", shader_seeds(),
+            {
+                "{", "}", "(", ")", "[", "]", ";", ",", "/*", "*/", "//", "\\\n", "\n",
+                "#define A(x) x x\n", "#if 1\n", "#endif\n", "A(A(A(", "struct S { float a; };",
+                "float a, b;", "for (int i = 0; i < 4; ++i) ", "vec4(", ".xyzw", "1e38", "S s;",
+            },
+            analyze },
+    };
+}
+
+struct Cost {
+    double nanoseconds = 0;
+    double peak_bytes = 0;
+};
+
+static Cost measure(const Target& target, const std::string& input)
+{
+    size_t live_before = live_bytes;
+    peak_bytes = live_before;
+    auto start = std::chrono::steady_clock::now();
+    target.run(input);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return {
+        std::chrono::duration<double, std::nano>(elapsed).count(),
+        static_cast<double>(peak_bytes - live_before),
+    };
+}
+
+// Medians of a few runs, so that a single hiccup doesn't enter the corpus.
+static Cost measure_stable(const Target& target, const std::string& input, int runs = 3)
+{
+    std::vector<Cost> costs;
+    for (int i = 0; i < runs; ++i) {
+        costs.push_back(measure(target, input));
+    }
+    auto median = [&](double Cost::*field) {
+        std::vector<double> values;
+        for (const auto& cost : costs) {
+            values.push_back(cost.*field);
+        }
+        std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        return values[values.size() / 2];
+    };
+    return { median(&Cost::nanoseconds), median(&Cost::peak_bytes) };
+}
+
+struct Entry {
+    std::string input;
+    double score = 0;
+};
+
+class Mutator
+{
+
+public:
+    Mutator(const Target& target, size_t max_length, unsigned seed)
+        : m_target(target)
+        , m_max_length(max_length)
+        , m_random(seed)
+    {
+    }
+
+    std::string mutate(std::string input, const std::vector<Entry>& corpus)
+    {
+        int count = 1 + pick(4);
+        for (int i = 0; i < count; ++i) {
+            mutate_once(input, corpus);
+        }
+        if (input.size() > m_max_length) {
+            input.resize(m_max_length);
+        }
+        return input;
+    }
+
+private:
+    size_t pick(size_t n)
+    {
+        return n == 0 ? 0 : std::uniform_int_distribution<size_t>(0, n - 1)(m_random);
+    }
+
+    void mutate_once(std::string& input, const std::vector<Entry>& corpus)
+    {
+        size_t position = pick(input.size() + 1);
+        const auto& dictionary = m_target.dictionary;
+        switch (pick(7)) {
+        case 0:
+            if (!input.empty()) {
+                input[pick(input.size())] ^= static_cast<char>(1 << pick(8));
+            }
+            break;
+        case 1:
+            input.insert(position, 1, static_cast<char>(pick(256)));
+            break;
+        case 2:
+            input.erase(position, 1 + pick(16));
+            break;
+        case 3: {
+            // Duplicating a range is what turns nesting into deep nesting.
+            size_t begin = pick(input.size() + 1);
+            std::string range = input.substr(begin, 1 + pick(64));
+            input.insert(position, range);
+            break;
+        }
+        case 4:
+            input.insert(position, dictionary[pick(dictionary.size())]);
+            break;
+        case 5: {
+            const std::string& token = dictionary[pick(dictionary.size())];
+            for (size_t n = 1 + pick(64); n > 0; --n) {
+                input.insert(position, token);
+            }
+            break;
+        }
+        case 6:
+            if (!corpus.empty()) {
+                const std::string& other = corpus[pick(corpus.size())].input;
+                size_t begin = pick(other.size() + 1);
+                input = input.substr(0, position) + other.substr(begin);
+            }
+            break;
+        }
+    }
+
+    const Target& m_target;
+    size_t m_max_length;
+    std::mt19937 m_random;
+};
+
+static double score_of(const Cost& cost, const std::string& input, bool memory)
+{
+    // Short inputs are dominated by fixed costs, so they are scored as if
+    // they were at least 64 bytes long.
+    double bytes = std::max<double>(input.size(), 64);
+    return (memory ? cost.peak_bytes : cost.nanoseconds) / bytes;
+}
+
+static int fuzz(const Target& target, long iterations, double seconds, bool memory,
+    size_t max_length, size_t corpus_size, const std::string& out)
+{
+    std::vector<Entry> corpus;
+    for (const auto& seed : target.seeds) {
+        corpus.push_back({ seed, score_of(measure_stable(target, seed), seed, memory) });
+    }
+    std::sort(corpus.begin(), corpus.end(), [](const Entry& a, const Entry& b) { return a.score > b.score; });
+
+    Mutator mutator(target, max_length, std::random_device{}());
+    std::mt19937 random(std::random_device{}());
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    for (long i = 0; i < iterations && std::chrono::steady_clock::now() < deadline; ++i) {
+        // Prefer the costliest entries as parents: the minimum of two draws
+        // over a corpus sorted by decreasing score.
+        std::uniform_int_distribution<size_t> draw(0, corpus.size() - 1);
+        const Entry& parent = corpus[std::min(draw(random), draw(random))];
+        std::string input = mutator.mutate(parent.input, corpus);
+
+        double score = score_of(measure(target, input), input, memory);
+        if (corpus.size() >= corpus_size && score <= corpus.back().score) {
+            continue;
+        }
+        score = score_of(measure_stable(target, input), input, memory);
+        if (corpus.size() >= corpus_size && score <= corpus.back().score) {
+            continue;
+        }
+        auto position = std::find_if(corpus.begin(), corpus.end(),
+            [&](const Entry& entry) { return entry.score < score; });
+        corpus.insert(position, { input, score });
+        if (corpus.size() > corpus_size) {
+            corpus.pop_back();
+        }
+        std::printf("%8ld  %-12s %12.1f %s/byte  %6zu bytes\n", i, target.name, score,
+            memory ? "bytes" : "ns", input.size());
+    }
+
+    fs::create_directories(out);
+    for (size_t rank = 0; rank < corpus.size(); ++rank) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "-%03zu.in", rank);
+        std::ofstream file(fs::path(out) / (std::string(target.name) + name), std::ios::binary);
+        file << corpus[rank].input;
+    }
+    std::printf("%s: %zu inputs written to %s, worst %.1f %s/byte\n", target.name, corpus.size(),
+        out.c_str(), corpus.empty() ? 0.0 : corpus.front().score, memory ? "bytes" : "ns");
+    return 0;
+}
+
+static int replay(const std::vector<Target>& targets, const std::string& directory, bool memory, double budget)
+{
+    int failures = 0;
+    std::vector<fs::path> paths;
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        paths.push_back(entry.path());
+    }
+    std::sort(paths.begin(), paths.end());
+
+    for (const auto& path : paths) {
+        auto name = path.filename().string();
+        auto target = std::find_if(targets.begin(), targets.end(), [&](const Target& target) {
+            return name.compare(0, std::strlen(target.name) + 1, std::string(target.name) + "-") == 0;
+        });
+        if (target == targets.end()) {
+            continue;
+        }
+        std::ifstream file(path, std::ios::binary);
+        std::string input{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+        auto cost = measure_stable(*target, input, 5);
+        double score = score_of(cost, input, memory);
+        bool failed = budget > 0 && score > budget;
+        failures += failed;
+        std::printf("%-24s %6zu bytes %12.0f ns %12.0f peak bytes %10.1f %s/byte%s\n", name.c_str(),
+            input.size(), cost.nanoseconds, cost.peak_bytes, score, memory ? "bytes" : "ns",
+            failed ? "  OVER BUDGET" : "");
+    }
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    CLI::App app{ "Performance fuzzer for glslls" };
+
+    std::string target_name = "all";
+    long iterations = 100000;
+    double seconds = 60;
+    std::string metric = "time";
+    size_t max_length = 4096;
+    size_t corpus_size = 16;
+    std::string out = "perf-corpus";
+    std::string replay_directory;
+    double budget = 0;
+
+    app.add_option("--target", target_name, "frame-chars, frame-string, shader or all", true);
+    app.add_option("--iterations", iterations, "Maximum number of inputs per target", true);
+    app.add_option("--seconds", seconds, "Time limit per target", true);
+    app.add_option("--metric", metric, "Cost to maximize per input byte: time or memory", true);
+    app.add_option("--max-length", max_length, "Maximum input length in bytes", true);
+    app.add_option("--corpus-size", corpus_size, "Number of inputs kept per target", true);
+    app.add_option("--out", out, "Directory the corpus is written to", true);
+    app.add_option("--replay", replay_directory, "Measure the inputs of a corpus directory instead of fuzzing");
+    app.add_option("--budget", budget, "With --replay, fail if an input costs more than this per byte");
+
+    CLI11_PARSE(app, argc, argv);
+
+    AppState appstate;
+    appstate.core.set_initialized(true);
+    auto targets = make_targets(appstate);
+    bool memory = metric == "memory";
+
+    if (!replay_directory.empty()) {
+        return replay(targets, replay_directory, memory, budget);
+    }
+    for (const auto& target : targets) {
+        if (target_name == "all" || target_name == target.name) {
+            fuzz(target, iterations, seconds, memory, max_length, corpus_size, out);
+        }
+    }
+    return 0;
+}
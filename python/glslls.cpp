@@ -0,0 +1,532 @@
+// The glslls Python module: the C API of glslls_core for Python scripts.
+//
+// Every call into the core runs with the GIL released, so other Python
+// threads go on while shaders are compiled, and validate() compiles its batch
+// on the core's worker pool. Shader text is read in place from str objects or
+// any object supporting the buffer protocol (bytes, bytearray, memoryview,
+// mmap, numpy arrays) instead of being copied first.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "glslls_core.h"
+
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace {
+
+PyObject* glslls_error = nullptr;
+
+PyTypeObject diagnostic_type;
+PyTypeObject symbol_type;
+PyTypeObject validation_type;
+
+PyStructSequence_Field diagnostic_fields[] = {
+    { "line", "0-based line" },
+    { "start_character", "0-based start character on the line" },
+    { "end_character", "0-based end character on the line" },
+    { "severity", "1 for errors, 2 for warnings" },
+    { "message", nullptr },
+    { nullptr, nullptr },
+};
+
+PyStructSequence_Desc diagnostic_desc = {
+    "glslls.Diagnostic", "A diagnostic reported by glslang.", diagnostic_fields, 5
+};
+
+PyStructSequence_Field symbol_fields[] = {
+    { "name", nullptr },
+    { "type", "glslang's type, or the signature of a function" },
+    { "kind", "'variable', 'function' or 'struct'" },
+    { "line", "0-based line of the declaration" },
+    { "character", "0-based character of the declaration" },
+    { nullptr, nullptr },
+};
+
+PyStructSequence_Desc symbol_desc = {
+    "glslls.Symbol", "A declaration at global scope.", symbol_fields, 5
+};
+
+PyStructSequence_Field validation_fields[] = {
+    { "uri", nullptr },
+    { "parsed", "whether glslang compiled the shader" },
+    { "diagnostics", "list of Diagnostic" },
+    { "globals", "list of Symbol" },
+    { "error", "None, or why the shader couldn't be analyzed" },
+    { nullptr, nullptr },
+};
+
+PyStructSequence_Desc validation_desc = {
+    "glslls.Validation", "The result of validating one shader.", validation_fields, 5
+};
+
+const char* error_message(int status)
+{
+    switch (status) {
+    case GLSLLS_ERROR_UNKNOWN_DOCUMENT:
+        return "unknown document";
+    case GLSLLS_ERROR_UNSUPPORTED_LANGUAGE:
+        return "unsupported language";
+    case GLSLLS_ERROR_NOT_FOUND:
+        return "not found";
+    default:
+        return "internal error";
+    }
+}
+
+PyObject* raise_status(int status, const char* uri)
+{
+    PyErr_Format(glslls_error, "%s: %s", uri, error_message(status));
+    return nullptr;
+}
+
+PyObject* to_str(glslls_string string)
+{
+    return PyUnicode_DecodeUTF8(string.data, static_cast<Py_ssize_t>(string.size), "replace");
+}
+
+const char* kind_name(int kind)
+{
+    switch (kind) {
+    case GLSLLS_KIND_FUNCTION:
+        return "function";
+    case GLSLLS_KIND_STRUCT:
+        return "struct";
+    default:
+        return "variable";
+    }
+}
+
+// Sets the fields of a new struct sequence to `values`, new references. False
+// if any is NULL, with the error set; the sequence releases the rest.
+bool fill(PyObject* item, std::initializer_list<PyObject*> values)
+{
+    bool filled = true;
+    Py_ssize_t i = 0;
+    for (PyObject* value : values) {
+        filled = filled && value;
+        PyStructSequence_SET_ITEM(item, i++, value);
+    }
+    return filled;
+}
+
+PyObject* make_diagnostics(const glslls_diagnostic* diagnostics, size_t count)
+{
+    PyObject* list = PyList_New(static_cast<Py_ssize_t>(count));
+    for (size_t i = 0; list && i < count; ++i) {
+        PyObject* item = PyStructSequence_New(&diagnostic_type);
+        if (!item
+            || !fill(item,
+                {
+                    PyLong_FromLong(diagnostics[i].line),
+                    PyLong_FromLong(diagnostics[i].start_character),
+                    PyLong_FromLong(diagnostics[i].end_character),
+                    PyLong_FromLong(diagnostics[i].severity),
+                    to_str(diagnostics[i].message),
+                })) {
+            Py_XDECREF(item);
+            Py_CLEAR(list);
+            break;
+        }
+        PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), item);
+    }
+    return list;
+}
+
+PyObject* make_symbols(const glslls_symbol* symbols, size_t count)
+{
+    PyObject* list = PyList_New(static_cast<Py_ssize_t>(count));
+    for (size_t i = 0; list && i < count; ++i) {
+        PyObject* item = PyStructSequence_New(&symbol_type);
+        if (!item
+            || !fill(item,
+                {
+                    to_str(symbols[i].name),
+                    to_str(symbols[i].type),
+                    PyUnicode_FromString(kind_name(symbols[i].kind)),
+                    PyLong_FromLong(symbols[i].line),
+                    PyLong_FromLong(symbols[i].character),
+                })) {
+            Py_XDECREF(item);
+            Py_CLEAR(list);
+            break;
+        }
+        PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), item);
+    }
+    return list;
+}
+
+// A view of shader text passed from Python, valid while the object is alive:
+// the UTF-8 form of a str, cached in the str itself, or the memory exported
+// by a buffer.
+class Text
+{
+
+public:
+    Text() = default;
+    Text(const Text&) = delete;
+    Text& operator=(const Text&) = delete;
+
+    ~Text()
+    {
+        if (m_has_buffer) {
+            PyBuffer_Release(&m_buffer);
+        }
+    }
+
+    bool set(PyObject* object)
+    {
+        if (PyUnicode_Check(object)) {
+            Py_ssize_t size = 0;
+            data = PyUnicode_AsUTF8AndSize(object, &size);
+            this->size = static_cast<size_t>(size);
+            return data != nullptr;
+        }
+        if (PyObject_GetBuffer(object, &m_buffer, PyBUF_SIMPLE) != 0) {
+            return false;
+        }
+        m_has_buffer = true;
+        data = static_cast<const char*>(m_buffer.buf);
+        size = static_cast<size_t>(m_buffer.len);
+        return true;
+    }
+
+    const char* data = nullptr;
+    size_t size = 0;
+
+private:
+    Py_buffer m_buffer;
+    bool m_has_buffer = false;
+};
+
+// Results of the C API are borrowed views that the next call of the same
+// kind may invalidate, so each call holds the mutex until its results are
+// converted. It is always taken with the GIL released: a thread holding it
+// may need the GIL back to convert.
+struct CoreObject {
+    PyObject_HEAD
+    glslls_core* core;
+    std::mutex* mutex;
+};
+
+class Lock
+{
+
+public:
+    explicit Lock(CoreObject* self)
+        : m_lock(*self->mutex, std::defer_lock)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        m_lock.lock();
+        Py_END_ALLOW_THREADS
+    }
+
+private:
+    std::unique_lock<std::mutex> m_lock;
+};
+
+PyObject* core_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+{
+    static const char* keywords[] = { "threads", nullptr };
+    unsigned threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|I:Core", const_cast<char**>(keywords), &threads)) {
+        return nullptr;
+    }
+
+    auto* self = reinterpret_cast<CoreObject*>(type->tp_alloc(type, 0));
+    if (!self) {
+        return nullptr;
+    }
+    self->mutex = new (std::nothrow) std::mutex;
+    self->core = glslls_core_create(threads);
+    if (!self->mutex || !self->core) {
+        Py_DECREF(self);
+        PyErr_SetString(glslls_error, "couldn't create the core");
+        return nullptr;
+    }
+    return reinterpret_cast<PyObject*>(self);
+}
+
+void core_dealloc(CoreObject* self)
+{
+    if (self->core) {
+        Py_BEGIN_ALLOW_THREADS
+        glslls_core_destroy(self->core);
+        Py_END_ALLOW_THREADS
+    }
+    delete self->mutex;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+using DocumentCall = int (*)(glslls_core*, const char*, const char*, size_t, int);
+
+PyObject* set_document(CoreObject* self, PyObject* args, PyObject* kwargs, DocumentCall call, const char* format)
+{
+    static const char* keywords[] = { "uri", "text", "version", nullptr };
+    const char* uri = nullptr;
+    PyObject* object = nullptr;
+    int version = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, format, const_cast<char**>(keywords), &uri, &object, &version)) {
+        return nullptr;
+    }
+    Text text;
+    if (!text.set(object)) {
+        return nullptr;
+    }
+
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = call(self->core, uri, text.data, text.size, version);
+    Py_END_ALLOW_THREADS
+    if (status != GLSLLS_OK) {
+        return raise_status(status, uri);
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* core_open(CoreObject* self, PyObject* args, PyObject* kwargs)
+{
+    return set_document(self, args, kwargs, glslls_open_document, "sO|i:open");
+}
+
+PyObject* core_update(CoreObject* self, PyObject* args, PyObject* kwargs)
+{
+    return set_document(self, args, kwargs, glslls_update_document, "sO|i:update");
+}
+
+PyObject* core_close(CoreObject* self, PyObject* args)
+{
+    const char* uri = nullptr;
+    if (!PyArg_ParseTuple(args, "s:close", &uri)) {
+        return nullptr;
+    }
+
+    // Closing drops the document's results, which another thread may be
+    // converting.
+    Lock lock(self);
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = glslls_close_document(self->core, uri);
+    Py_END_ALLOW_THREADS
+    if (status != GLSLLS_OK) {
+        return raise_status(status, uri);
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* core_diagnostics(CoreObject* self, PyObject* args)
+{
+    const char* uri = nullptr;
+    if (!PyArg_ParseTuple(args, "s:diagnostics", &uri)) {
+        return nullptr;
+    }
+
+    Lock lock(self);
+    const glslls_diagnostic* diagnostics = nullptr;
+    size_t count = 0;
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = glslls_get_diagnostics(self->core, uri, &diagnostics, &count);
+    Py_END_ALLOW_THREADS
+    if (status != GLSLLS_OK) {
+        return raise_status(status, uri);
+    }
+    return make_diagnostics(diagnostics, count);
+}
+
+PyObject* core_reflect(CoreObject* self, PyObject* args)
+{
+    const char* uri = nullptr;
+    if (!PyArg_ParseTuple(args, "s:reflect", &uri)) {
+        return nullptr;
+    }
+
+    Lock lock(self);
+    const glslls_symbol* globals = nullptr;
+    size_t count = 0;
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = glslls_get_globals(self->core, uri, &globals, &count);
+    Py_END_ALLOW_THREADS
+    if (status != GLSLLS_OK) {
+        return raise_status(status, uri);
+    }
+    return make_symbols(globals, count);
+}
+
+PyObject* core_cost_report(CoreObject* self, PyObject* args)
+{
+    const char* uri = nullptr;
+    if (!PyArg_ParseTuple(args, "s:cost_report", &uri)) {
+        return nullptr;
+    }
+
+    Lock lock(self);
+    double total = 0;
+    glslls_string report = {};
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = glslls_profile(self->core, uri, &total, &report);
+    Py_END_ALLOW_THREADS
+    if (status != GLSLLS_OK) {
+        return raise_status(status, uri);
+    }
+    PyObject* text = to_str(report);
+    return text ? Py_BuildValue("(dN)", total, text) : nullptr;
+}
+
+PyObject* core_validate(CoreObject* self, PyObject* args)
+{
+    PyObject* iterable = nullptr;
+    if (!PyArg_ParseTuple(args, "O:validate", &iterable)) {
+        return nullptr;
+    }
+    // A tuple of its own, so the pairs, and so the URIs and texts, stay alive
+    // while the GIL is released, whatever other threads do to the input.
+    PyObject* sequence = PySequence_Tuple(iterable);
+    if (!sequence) {
+        return nullptr;
+    }
+    Py_ssize_t count = PyTuple_GET_SIZE(sequence);
+
+    std::vector<glslls_source> sources(static_cast<size_t>(count));
+    std::vector<std::unique_ptr<Text>> texts;
+    for (Py_ssize_t i = 0; i < count; ++i) {
+        PyObject* pair = PyTuple_GET_ITEM(sequence, i);
+        PyObject* uri = nullptr;
+        PyObject* object = nullptr;
+        texts.push_back(std::make_unique<Text>());
+        if (!PyArg_ParseTuple(pair, "UO:validate", &uri, &object) || !texts.back()->set(object)) {
+            Py_DECREF(sequence);
+            return nullptr;
+        }
+        sources[i].uri = PyUnicode_AsUTF8(uri);
+        if (!sources[i].uri) {
+            Py_DECREF(sequence);
+            return nullptr;
+        }
+        sources[i].text = texts.back()->data;
+        sources[i].text_size = texts.back()->size;
+    }
+
+    Lock lock(self);
+    const glslls_validation* validations = nullptr;
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = glslls_validate(self->core, sources.data(), sources.size(), &validations);
+    Py_END_ALLOW_THREADS
+    if (status != GLSLLS_OK) {
+        Py_DECREF(sequence);
+        return raise_status(status, "validate");
+    }
+
+    PyObject* list = PyList_New(count);
+    for (Py_ssize_t i = 0; list && i < count; ++i) {
+        const glslls_validation& validation = validations[i];
+        PyObject* item = PyStructSequence_New(&validation_type);
+        if (!item) {
+            Py_CLEAR(list);
+            break;
+        }
+        PyObject* uri = PyTuple_GET_ITEM(PyTuple_GET_ITEM(sequence, i), 0);
+        Py_INCREF(uri);
+        PyObject* error = Py_None;
+        if (validation.status != GLSLLS_OK) {
+            error = PyUnicode_FromString(error_message(validation.status));
+        } else {
+            Py_INCREF(error);
+        }
+        if (!fill(item,
+                {
+                    uri,
+                    PyBool_FromLong(validation.parsed),
+                    make_diagnostics(validation.diagnostics, validation.diagnostic_count),
+                    make_symbols(validation.globals, validation.global_count),
+                    error,
+                })) {
+            Py_DECREF(item);
+            Py_CLEAR(list);
+            break;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+    Py_DECREF(sequence);
+    return list;
+}
+
+PyMethodDef core_methods[] = {
+    { "open", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(core_open)), METH_VARARGS | METH_KEYWORDS,
+        "open(uri, text, version=0)\n\nOpens a document. `text` is a str or a buffer of UTF-8." },
+    { "update", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(core_update)),
+        METH_VARARGS | METH_KEYWORDS, "update(uri, text, version=0)\n\nReplaces the text of an open document." },
+    { "close", reinterpret_cast<PyCFunction>(core_close), METH_VARARGS, "close(uri)" },
+    { "diagnostics", reinterpret_cast<PyCFunction>(core_diagnostics), METH_VARARGS,
+        "diagnostics(uri) -> list of Diagnostic" },
+    { "reflect", reinterpret_cast<PyCFunction>(core_reflect), METH_VARARGS,
+        "reflect(uri) -> list of Symbol\n\nThe declarations at global scope of an open document." },
+    { "cost_report", reinterpret_cast<PyCFunction>(core_cost_report), METH_VARARGS,
+        "cost_report(uri) -> (total_milliseconds, report)\n\nWhere glslang spends its time on the document." },
+    { "validate", reinterpret_cast<PyCFunction>(core_validate), METH_VARARGS,
+        "validate(sources) -> list of Validation\n\n"
+        "Analyzes (uri, text) pairs in parallel on the worker pool without opening them." },
+    { nullptr, nullptr, 0, nullptr },
+};
+
+PyTypeObject core_type = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+};
+
+PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT,
+    "glslls",
+    "GLSL validation and reflection with the glslls core.",
+    -1,
+    nullptr,
+};
+
+}
+
+PyMODINIT_FUNC PyInit_glslls()
+{
+    core_type.tp_name = "glslls.Core";
+    core_type.tp_doc = "Core(threads=0)\n\nOpen documents and a worker pool; 0 threads means one per hardware thread.";
+    core_type.tp_basicsize = sizeof(CoreObject);
+    core_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    core_type.tp_new = core_new;
+    core_type.tp_dealloc = reinterpret_cast<destructor>(core_dealloc);
+    core_type.tp_methods = core_methods;
+    if (PyType_Ready(&core_type) < 0
+        || PyStructSequence_InitType2(&diagnostic_type, &diagnostic_desc) < 0
+        || PyStructSequence_InitType2(&symbol_type, &symbol_desc) < 0
+        || PyStructSequence_InitType2(&validation_type, &validation_desc) < 0) {
+        return nullptr;
+    }
+
+    PyObject* module = PyModule_Create(&module_def);
+    if (!module) {
+        return nullptr;
+    }
+    glslls_error = PyErr_NewException("glslls.Error", nullptr, nullptr);
+    const std::pair<const char*, PyObject*> objects[] = {
+        { "Core", reinterpret_cast<PyObject*>(&core_type) },
+        { "Diagnostic", reinterpret_cast<PyObject*>(&diagnostic_type) },
+        { "Symbol", reinterpret_cast<PyObject*>(&symbol_type) },
+        { "Validation", reinterpret_cast<PyObject*>(&validation_type) },
+        { "Error", glslls_error },
+    };
+    for (auto [name, object] : objects) {
+        // PyModule_AddObject() steals the reference only when it succeeds.
+        Py_XINCREF(object);
+        if (!object || PyModule_AddObject(module, name, object) < 0) {
+            Py_XDECREF(object);
+            Py_DECREF(module);
+            return nullptr;
+        }
+    }
+    return module;
+}
@@ -0,0 +1,378 @@
+#include "allocator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+#include <sys/mman.h>
+
+namespace {
+
+const size_t span_size = 64 * 1024;
+
+// Spans are carved from one reserved range of address space, so that a
+// pointer can be told apart from a malloc'ed one by its address alone.
+const size_t region_size = size_t(16) << 30;
+const size_t max_spans = region_size / span_size;
+
+const size_t class_sizes[] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256,
+    320, 384, 448, 512, 640, 768, 896, 1024,
+};
+const size_t num_classes = sizeof(class_sizes) / sizeof(class_sizes[0]);
+const size_t max_small_size = class_sizes[num_classes - 1];
+
+// Blocks moved between a thread cache and the central list at once, and the
+// most a thread cache holds before giving half of them back.
+const uint32_t batch_size = 32;
+const uint32_t max_cached = 4 * batch_size;
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct Region {
+    Region()
+    {
+        void* memory = mmap(nullptr, region_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        // Without the reservation everything goes to malloc.
+        base = memory == MAP_FAILED ? nullptr : static_cast<char*>(memory);
+    }
+
+    bool contains(const void* p) const
+    {
+        return base && p >= base && p < base + region_size;
+    }
+
+    size_t span_of(const void* p) const
+    {
+        return (static_cast<const char*>(p) - base) / span_size;
+    }
+
+    char* base;
+    std::atomic<size_t> next_span{ 0 };
+    uint8_t span_class[max_spans];
+    uint32_t span_owner[max_spans];
+};
+
+struct CentralList {
+    std::mutex mutex;
+    FreeBlock* head = nullptr;
+};
+
+struct ThreadCache {
+    FreeBlock* lists[num_classes] = {};
+    uint32_t counts[num_classes] = {};
+    uint32_t id = 0;
+
+    // Only written by the owning thread, read by allocator_stats().
+    std::atomic<size_t> allocations[num_classes] = {};
+    std::atomic<size_t> frees[num_classes] = {};
+    std::atomic<size_t> cross_thread_frees{ 0 };
+
+    ThreadCache* next = nullptr;
+};
+
+Region& region()
+{
+    static Region region;
+    return region;
+}
+
+CentralList central[num_classes];
+std::atomic<uint32_t> next_thread_id{ 1 };
+std::atomic<size_t> large_allocations{ 0 };
+
+// Live thread caches, and the counters of the ones whose thread exited.
+std::mutex caches_mutex;
+ThreadCache* caches = nullptr;
+ThreadCache retired;
+
+thread_local ThreadCache* tls_cache = nullptr;
+thread_local bool tls_cache_dead = false;
+
+size_t size_class_of(size_t size)
+{
+    size_t index = 0;
+    while (class_sizes[index] < size) {
+        ++index;
+    }
+    return index;
+}
+
+void push_central(size_t size_class, FreeBlock* first, FreeBlock* last)
+{
+    std::lock_guard<std::mutex> lock(central[size_class].mutex);
+    last->next = central[size_class].head;
+    central[size_class].head = first;
+}
+
+void flush_cache(ThreadCache* cache, size_t size_class, uint32_t keep)
+{
+    FreeBlock* first = cache->lists[size_class];
+    if (!first || cache->counts[size_class] <= keep) {
+        return;
+    }
+    uint32_t count = cache->counts[size_class] - keep;
+    FreeBlock* last = first;
+    for (uint32_t i = 1; i < count; ++i) {
+        last = last->next;
+    }
+    cache->lists[size_class] = last->next;
+    cache->counts[size_class] = keep;
+    push_central(size_class, first, last);
+}
+
+struct CacheReaper {
+    ~CacheReaper()
+    {
+        ThreadCache* cache = tls_cache;
+        for (size_t i = 0; i < num_classes; ++i) {
+            flush_cache(cache, i, 0);
+        }
+
+        std::lock_guard<std::mutex> lock(caches_mutex);
+        for (ThreadCache** it = &caches; *it; it = &(*it)->next) {
+            if (*it == cache) {
+                *it = cache->next;
+                break;
+            }
+        }
+        for (size_t i = 0; i < num_classes; ++i) {
+            retired.allocations[i] += cache->allocations[i].load(std::memory_order_relaxed);
+            retired.frees[i] += cache->frees[i].load(std::memory_order_relaxed);
+        }
+        retired.cross_thread_frees += cache->cross_thread_frees.load(std::memory_order_relaxed);
+
+        // Blocks freed by this thread from now on go straight to the central
+        // lists.
+        tls_cache = nullptr;
+        tls_cache_dead = true;
+        cache->~ThreadCache();
+        std::free(cache);
+    }
+};
+
+ThreadCache* thread_cache()
+{
+    if (tls_cache || tls_cache_dead) {
+        return tls_cache;
+    }
+
+    // Allocated with malloc, since we may be inside operator new already.
+    void* memory = std::malloc(sizeof(ThreadCache));
+    if (!memory) {
+        return nullptr;
+    }
+    ThreadCache* cache = new (memory) ThreadCache();
+    cache->id = next_thread_id++;
+    {
+        std::lock_guard<std::mutex> lock(caches_mutex);
+        cache->next = caches;
+        caches = cache;
+    }
+    tls_cache = cache;
+
+    thread_local CacheReaper reaper;
+    (void)reaper;
+    return cache;
+}
+
+// Splits a new span into blocks of the given class and returns them as a
+// list, or nullptr once the region is exhausted.
+FreeBlock* carve_span(size_t size_class, uint32_t owner, FreeBlock** last, uint32_t* count)
+{
+    Region& r = region();
+    if (!r.base) {
+        return nullptr;
+    }
+    size_t span = r.next_span.fetch_add(1);
+    if (span >= max_spans) {
+        return nullptr;
+    }
+    r.span_class[span] = static_cast<uint8_t>(size_class);
+    r.span_owner[span] = owner;
+
+    char* start = r.base + span * span_size;
+    size_t block_size = class_sizes[size_class];
+    size_t blocks = span_size / block_size;
+    for (size_t i = 0; i + 1 < blocks; ++i) {
+        reinterpret_cast<FreeBlock*>(start + i * block_size)->next
+            = reinterpret_cast<FreeBlock*>(start + (i + 1) * block_size);
+    }
+    *last = reinterpret_cast<FreeBlock*>(start + (blocks - 1) * block_size);
+    (*last)->next = nullptr;
+    *count = blocks;
+    return reinterpret_cast<FreeBlock*>(start);
+}
+
+bool refill(ThreadCache* cache, size_t size_class)
+{
+    {
+        std::lock_guard<std::mutex> lock(central[size_class].mutex);
+        FreeBlock* head = central[size_class].head;
+        if (head) {
+            FreeBlock* last = head;
+            uint32_t count = 1;
+            while (count < batch_size && last->next) {
+                last = last->next;
+                ++count;
+            }
+            central[size_class].head = last->next;
+            last->next = nullptr;
+            cache->lists[size_class] = head;
+            cache->counts[size_class] = count;
+            return true;
+        }
+    }
+
+    FreeBlock* last;
+    uint32_t count;
+    FreeBlock* first = carve_span(size_class, cache->id, &last, &count);
+    if (!first) {
+        return false;
+    }
+    cache->lists[size_class] = first;
+    cache->counts[size_class] = count;
+    flush_cache(cache, size_class, max_cached);
+    return true;
+}
+
+void* allocate(size_t size)
+{
+    if (size <= max_small_size) {
+        size_t size_class = size_class_of(size ? size : 1);
+        ThreadCache* cache = thread_cache();
+        if (cache && (cache->lists[size_class] || refill(cache, size_class))) {
+            FreeBlock* block = cache->lists[size_class];
+            cache->lists[size_class] = block->next;
+            --cache->counts[size_class];
+            auto& allocations = cache->allocations[size_class];
+            allocations.store(allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return block;
+        }
+    }
+    large_allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void deallocate(void* p)
+{
+    if (!p) {
+        return;
+    }
+    Region& r = region();
+    if (!r.contains(p)) {
+        std::free(p);
+        return;
+    }
+
+    size_t span = r.span_of(p);
+    size_t size_class = r.span_class[span];
+    FreeBlock* block = static_cast<FreeBlock*>(p);
+
+    ThreadCache* cache = thread_cache();
+    if (!cache) {
+        block->next = nullptr;
+        push_central(size_class, block, block);
+        return;
+    }
+
+    auto& frees = cache->frees[size_class];
+    frees.store(frees.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (r.span_owner[span] != cache->id) {
+        auto& cross = cache->cross_thread_frees;
+        cross.store(cross.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    block->next = cache->lists[size_class];
+    cache->lists[size_class] = block;
+    if (++cache->counts[size_class] > max_cached) {
+        flush_cache(cache, size_class, max_cached / 2);
+    }
+}
+
+}
+
+void* operator new(size_t size)
+{
+    if (void* p = allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    deallocate(p);
+}
+
+AllocatorStats allocator_stats()
+{
+    AllocatorStats stats;
+    size_t allocations[num_classes] = {};
+    size_t frees[num_classes] = {};
+    {
+        std::lock_guard<std::mutex> lock(caches_mutex);
+        for (size_t i = 0; i < num_classes; ++i) {
+            allocations[i] = retired.allocations[i].load(std::memory_order_relaxed);
+            frees[i] = retired.frees[i].load(std::memory_order_relaxed);
+        }
+        stats.cross_thread_frees = retired.cross_thread_frees.load(std::memory_order_relaxed);
+        for (ThreadCache* cache = caches; cache; cache = cache->next) {
+            for (size_t i = 0; i < num_classes; ++i) {
+                allocations[i] += cache->allocations[i].load(std::memory_order_relaxed);
+                frees[i] += cache->frees[i].load(std::memory_order_relaxed);
+            }
+            stats.cross_thread_frees += cache->cross_thread_frees.load(std::memory_order_relaxed);
+        }
+    }
+
+    for (size_t i = 0; i < num_classes; ++i) {
+        SizeClassStats size_class;
+        size_class.size = class_sizes[i];
+        size_class.allocations = allocations[i];
+        size_class.frees = frees[i];
+        // Counters are read without stopping other threads, so frees may
+        // briefly run ahead of allocations.
+        size_class.live_bytes = allocations[i] > frees[i] ? (allocations[i] - frees[i]) * class_sizes[i] : 0;
+        stats.size_classes.push_back(size_class);
+    }
+    stats.large_allocations = large_allocations.load(std::memory_order_relaxed);
+    stats.spans = std::min(region().next_span.load(), max_spans);
+    return stats;
+}
@@ -0,0 +1,33 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <cstddef>
+#include <vector>
+
+// Statistics of the built-in allocator that replaces the global operator
+// new/delete when configured with -DGLSLLS_SLAB_ALLOCATOR=ON.
+//
+// Requests up to the largest size class are served from 64 KiB spans split
+// into equally sized blocks. Each thread keeps a small cache of free blocks
+// per size class and only takes a lock to exchange batches with the central
+// free lists. Everything larger goes to malloc.
+
+struct SizeClassStats {
+    size_t size = 0;
+    size_t live_bytes = 0;
+    size_t allocations = 0;
+    size_t frees = 0;
+};
+
+struct AllocatorStats {
+    std::vector<SizeClassStats> size_classes;
+
+    // Blocks freed by a thread other than the one that carved their span.
+    size_t cross_thread_frees = 0;
+    size_t large_allocations = 0;
+    size_t spans = 0;
+};
+
+AllocatorStats allocator_stats();
+
+#endif /* ALLOCATOR_H */
@@ -0,0 +1,211 @@
+#include "analysis.hpp"
+#include "lexer.hpp"
+#include "parsepool.hpp"
+#include "scopetree.hpp"
+#include "syntaxtree.hpp"
+#include "text.hpp"
+
+#include "ResourceLimits.h"
+#include "glslang/MachineIndependent/localintermediate.h"
+#include "glslang/Include/intermediate.h"
+
+#include <algorithm>
+#include <charconv>
+#include <experimental/filesystem>
+#include <regex>
+#include <tuple>
+
+namespace fs = std::experimental::filesystem;
+
+Expected<EShLanguage> find_language(const std::string& name)
+{
+    auto ext = fs::path(name).extension();
+    if (ext == ".vert")
+        return EShLangVertex;
+    else if (ext == ".tesc")
+        return EShLangTessControl;
+    else if (ext == ".tese")
+        return EShLangTessEvaluation;
+    else if (ext == ".geom")
+        return EShLangGeometry;
+    else if (ext == ".frag")
+        return EShLangFragment;
+    else if (ext == ".comp")
+        return EShLangCompute;
+    return Error{ ErrorCode::UnsupportedLanguage, "Unknown file extension: " + name };
+}
+
+class SymbolCollector : public glslang::TIntermTraverser {
+public:
+    std::vector<SymbolOccurrence> symbols;
+
+private:
+    void visitSymbol(glslang::TIntermSymbol* interm) override
+    {
+        SymbolOccurrence symbol;
+        symbol.name = interm->getName().c_str();
+        symbol.type = interm->getType().getCompleteString().c_str();
+        symbol.kind = SymbolKind::Variable;
+        set_position(symbol, interm->getLoc());
+        symbols.push_back(symbol);
+    }
+
+    bool visitAggregate(glslang::TVisit, glslang::TIntermAggregate* interm) override
+    {
+        if (interm->getOp() == glslang::EOpFunction) {
+            // Function names are mangled with their parameter types, as in
+            // "main(" or "foo(vf4;".
+            std::string name = interm->getName().c_str();
+            SymbolOccurrence symbol;
+            symbol.name = name.substr(0, name.find('('));
+            symbol.type = interm->getType().getCompleteString().c_str();
+            symbol.kind = SymbolKind::Function;
+            set_position(symbol, interm->getLoc());
+            symbols.push_back(symbol);
+        }
+        return true;
+    }
+
+    static void set_position(SymbolOccurrence& symbol, const glslang::TSourceLoc& loc)
+    {
+        // glslang locations are 1-based.
+        symbol.line = loc.line - 1;
+        symbol.character = std::max(loc.column - 1, 0);
+    }
+};
+
+std::vector<Diagnostic> parse_info_log(const std::string& info_log, std::string_view content, int string)
+{
+    // Locations are <string>:<line>, with lines counted from 1 in each
+    // string. The patterns are compiled once and shared by all threads.
+    static const std::regex location_re("(.*): (\\d+):(\\d*): (.*)");
+    static const std::regex identifier_re("'(.*)' : (.*)");
+    std::cmatch matches;
+
+    std::vector<Diagnostic> diagnostics;
+    for (std::string_view error_line : split(info_log, "\n")) {
+        std::regex_search(error_line.data(), error_line.data() + error_line.size(), matches, location_re);
+        int string_no = -1;
+        if (matches.size() == 5) {
+            std::from_chars(matches[2].first, matches[2].second, string_no);
+        }
+        if (string_no == string) {
+            Diagnostic diagnostic;
+            diagnostic.severity_name = matches[1];
+            if (diagnostic.severity_name == "ERROR") {
+                diagnostic.severity = 1;
+            } else if (diagnostic.severity_name == "WARNING") {
+                diagnostic.severity = 2;
+            }
+            diagnostic.message = trim(std::string_view(matches[4].first, matches[4].length()), " ");
+
+            // -1 because lines are 0-indexed as per LSP specification.
+            int line_no = 0;
+            std::from_chars(matches[3].first, matches[3].second, line_no);
+            line_no -= 1;
+            std::string_view source_line;
+            if (line_no >= 0) {
+                source_line = line_at(content, line_no);
+            }
+
+            int start_char = -1;
+            int end_char = -1;
+
+            // If this is an undeclared identifier, we can find the exact
+            // position of the broken identifier.
+            std::smatch message_matches;
+            std::regex_search(diagnostic.message, message_matches, identifier_re);
+            auto source_pos = std::string::npos;
+            if (message_matches.size() == 3) {
+                source_pos = source_line.find(message_matches[1].str());
+            }
+            if (source_pos != std::string::npos) {
+                int identifier_length = message_matches[1].length();
+                start_char = source_pos;
+                end_char = source_pos + identifier_length - 1;
+            } else {
+                // If we can't find a precise position, we'll just use the whole line.
+                start_char = 0;
+                end_char = source_line.length();
+            }
+
+            diagnostic.line = line_no;
+            diagnostic.start_character = start_char;
+            diagnostic.end_character = end_char;
+            diagnostics.push_back(diagnostic);
+        }
+    }
+    return diagnostics;
+}
+
+Expected<Analysis> analyze_document(const std::string& uri, std::string_view text, const ScopeTree* previous_scopes)
+{
+    auto lang = find_language(uri);
+    if (!lang) {
+        return lang.error();
+    }
+
+    Analysis analysis;
+    analysis.hash = hash_string(text);
+
+    // The text needn't be null-terminated.
+    const char* shader_string = text.data();
+    int shader_length = static_cast<int>(text.size());
+    ensure_glslang_initialized();
+    {
+        PooledShader shader(*lang, text.size());
+        shader.setStringsWithLengths(&shader_string, &shader_length, 1);
+        TBuiltInResource Resources = glslang::DefaultTBuiltInResource;
+        EShMessages messages = EShMsgCascadingErrors;
+        analysis.parsed = shader.parse(&Resources, 110, false, messages);
+        analysis.info_log = shader.getInfoLog();
+
+        const auto intermediate = shader.getIntermediate();
+        if (intermediate && intermediate->getTreeRoot()) {
+            SymbolCollector collector;
+            intermediate->getTreeRoot()->traverse(&collector);
+            analysis.symbols = std::move(collector.symbols);
+        }
+    }
+
+    std::stable_sort(analysis.symbols.begin(), analysis.symbols.end(),
+        [](const SymbolOccurrence& a, const SymbolOccurrence& b) {
+            return std::tie(a.line, a.character) < std::tie(b.line, b.character);
+        });
+    analysis.diagnostics = parse_info_log(analysis.info_log, text);
+    auto tokens = lex_document(text);
+    analysis.scopes = std::make_shared<const ScopeTree>(build_scope_tree(text, tokens, previous_scopes));
+    analysis.syntax = std::make_shared<const SyntaxTree>(build_syntax_tree(text, tokens));
+    return analysis;
+}
+
+std::vector<SymbolOccurrence> global_declarations(const Analysis& analysis)
+{
+    std::vector<SymbolOccurrence> globals;
+    if (!analysis.scopes) {
+        return globals;
+    }
+    for (const auto& declaration : analysis.scopes->scopes[0].declarations) {
+        globals.push_back(declaration);
+        const SymbolOccurrence* symbol = find_symbol(analysis, declaration.line, declaration.character);
+        if (symbol && symbol->name == declaration.name && symbol->character == declaration.character) {
+            globals.back().type = symbol->type;
+        }
+    }
+    return globals;
+}
+
+const SymbolOccurrence* find_symbol(const Analysis& analysis, int line, int character)
+{
+    // Occurrences are sorted, so only those on `line` have to be looked at.
+    auto it = std::lower_bound(analysis.symbols.begin(), analysis.symbols.end(), line,
+        [](const SymbolOccurrence& symbol, int line) { return symbol.line < line; });
+    for (; it != analysis.symbols.end() && it->line == line; ++it) {
+        const auto start = it->character;
+        const auto end = it->character + static_cast<int>(it->name.size());
+        if (character >= start && character <= end) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
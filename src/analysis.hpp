@@ -0,0 +1,86 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "expected.hpp"
+
+#include "ShaderLang.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ScopeTree;
+struct SyntaxTree;
+
+// All positions are 0-based, as in the LSP specification.
+
+struct Diagnostic {
+    int line = 0;
+    int start_character = 0;
+    int end_character = 0;
+
+    // 1 for errors, 2 for warnings and -1 if glslang reported something else.
+    int severity = -1;
+    std::string severity_name;
+    std::string message;
+
+    // For headers, the includer contexts the diagnostic was reported in.
+    std::vector<std::string> contexts;
+};
+
+enum class SymbolKind {
+    Variable,
+    Function,
+    Struct,
+};
+
+struct SymbolOccurrence {
+    std::string name;
+    std::string type;
+    SymbolKind kind = SymbolKind::Variable;
+    int line = 0;
+    int character = 0;
+};
+
+// Everything that is extracted from a single parse of a document. Results
+// are immutable once built and shared between threads.
+struct Analysis {
+    uint64_t hash = 0;
+
+    // Whether glslang accepted the shader.
+    bool parsed = false;
+    std::string info_log;
+    std::vector<Diagnostic> diagnostics;
+
+    // Every symbol occurrence in the AST, sorted by position.
+    std::vector<SymbolOccurrence> symbols;
+
+    // Built from the tokens, so they are there even if glslang failed.
+    std::shared_ptr<const ScopeTree> scopes;
+    std::shared_ptr<const SyntaxTree> syntax;
+};
+
+// The stage of a shader, by the extension of its file name.
+Expected<EShLanguage> find_language(const std::string& name);
+
+// Unchanged functions of `previous_scopes`, the scope tree of an earlier
+// version of the document, are reused. Fails only if the document isn't of a
+// stage glslang knows; a shader that doesn't compile still has an Analysis.
+Expected<Analysis> analyze_document(const std::string& uri, std::string_view text,
+    const ScopeTree* previous_scopes = nullptr);
+
+// The diagnostics glslang reported in source string `string` of a shader,
+// whose text is `content`.
+std::vector<Diagnostic> parse_info_log(const std::string& info_log, std::string_view content, int string = 0);
+
+// The declarations at global scope, sorted by position: functions, structs,
+// uniforms, inputs and outputs and other globals. Their types are glslang's
+// where it saw the declaration, as written otherwise.
+std::vector<SymbolOccurrence> global_declarations(const Analysis& analysis);
+
+// Returns the symbol occurrence covering the given position, or nullptr.
+const SymbolOccurrence* find_symbol(const Analysis& analysis, int line, int character);
+
+#endif /* ANALYSIS_H */
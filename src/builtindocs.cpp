@@ -0,0 +1,82 @@
+#include "builtindocs.hpp"
+#include "docstable.hpp"
+#include "text.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+static std::string_view entry_name(const DocsTable& table, const DocsEntry& entry)
+{
+    return std::string_view(table.names + entry.name, entry.name_size);
+}
+
+static const DocsEntry* find_entry(const DocsTable& table, std::string_view name)
+{
+    uint32_t bucket = docs_hash(name, 0) % table.bucket_count;
+    uint32_t slot = docs_hash(name, table.displacements[bucket]) % table.entry_count;
+    const DocsEntry& entry = table.entries[slot];
+    return entry_name(table, entry) == name ? &entry : nullptr;
+}
+
+static std::unique_ptr<BuiltinDoc> decompress(const DocsTable& table, const DocsEntry& entry)
+{
+    std::string text;
+    std::string_view dictionary(reinterpret_cast<const char*>(table.dictionary), table.dictionary_size);
+    if (!lz_decompress(table.data + entry.data, entry.data_size, dictionary, entry.text_size, text)) {
+        return nullptr;
+    }
+    auto doc = std::make_unique<BuiltinDoc>();
+    doc->name = entry_name(table, entry);
+    std::string_view signatures = std::string_view(text).substr(0, entry.signatures_size);
+    for (std::string_view signature : split(trim_right(signatures, "\n"), "\n")) {
+        doc->signatures.emplace_back(signature);
+        doc->is_function = doc->is_function || signature.find('(') != std::string_view::npos;
+    }
+    doc->description = text.substr(entry.signatures_size);
+    return doc;
+}
+
+const BuiltinDoc* find_builtin_doc(std::string_view name)
+{
+    const DocsTable& table = builtin_docs_table;
+    const DocsEntry* entry = find_entry(table, name);
+    if (!entry) {
+        return nullptr;
+    }
+
+    static std::mutex mutex;
+    static std::vector<std::unique_ptr<BuiltinDoc>> docs(table.entry_count);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& doc = docs[entry - table.entries];
+    if (!doc) {
+        doc = decompress(table, *entry);
+    }
+    return doc.get();
+}
+
+std::vector<std::string_view> builtin_doc_names(std::string_view prefix)
+{
+    const DocsTable& table = builtin_docs_table;
+    std::vector<std::string_view> names;
+    for (uint32_t i = 0; i < table.entry_count; ++i) {
+        std::string_view name = entry_name(table, table.entries[i]);
+        if (name.substr(0, prefix.size()) == prefix) {
+            names.push_back(name);
+        }
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+std::string builtin_doc_markdown(const BuiltinDoc& doc)
+{
+    std::string markdown = "```glsl\n";
+    for (const auto& signature : doc.signatures) {
+        markdown += signature;
+        markdown += '\n';
+    }
+    markdown += "```\n\n";
+    markdown += doc.description;
+    return markdown;
+}
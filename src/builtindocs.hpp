@@ -0,0 +1,35 @@
+#ifndef BUILTINDOCS_H
+#define BUILTINDOCS_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Reference documentation of the GLSL builtin functions and variables, from
+// docs/builtins.txt. It is compiled into the binary as a compressed table
+// (see docstable.hpp): nothing is read from disk, and an entry is only
+// decompressed the first time it is looked up.
+struct BuiltinDoc {
+    std::string name;
+
+    // One per line, as in the specification: genFType stands for float and
+    // vecN, gvec4 for vec4, ivec4 and uvec4, and so on.
+    std::vector<std::string> signatures;
+    std::string description;
+
+    // Variables have a declaration as their only signature.
+    bool is_function = false;
+};
+
+// The documentation of `name`, or null if it isn't a documented builtin. The
+// entry lives until the process exits.
+const BuiltinDoc* find_builtin_doc(std::string_view name);
+
+// The names of the documented builtins starting with `prefix`, sorted. Names
+// aren't compressed, so this decompresses nothing.
+std::vector<std::string_view> builtin_doc_names(std::string_view prefix);
+
+// Markdown for hover: the signatures as a GLSL block, then the description.
+std::string builtin_doc_markdown(const BuiltinDoc& doc);
+
+#endif /* BUILTINDOCS_H */
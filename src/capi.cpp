@@ -0,0 +1,319 @@
+#include "glslls_core.h"
+#include "core.hpp"
+
+#include <map>
+
+namespace {
+
+// Keeps alive whatever the views handed out for one document point into.
+struct DocumentResults {
+    std::shared_ptr<const Analysis> diagnostics_analysis;
+    std::vector<glslls_diagnostic> diagnostics;
+
+    std::shared_ptr<const Analysis> symbol_analysis;
+
+    std::vector<CompletionItem> completion;
+    std::vector<glslls_completion_item> completion_items;
+
+    std::shared_ptr<const Analysis> globals_analysis;
+    std::vector<SymbolOccurrence> globals;
+    std::vector<glslls_symbol> global_symbols;
+
+    std::string profile_report;
+};
+
+// The same for the last batch validated.
+struct BatchResults {
+    std::vector<std::shared_ptr<const Analysis>> analyses;
+    std::vector<std::vector<SymbolOccurrence>> globals;
+    std::vector<std::vector<glslls_diagnostic>> diagnostics;
+    std::vector<std::vector<glslls_symbol>> global_symbols;
+    std::vector<glslls_validation> validations;
+};
+
+glslls_string view(const std::string& s)
+{
+    return { s.data(), s.size() };
+}
+
+int symbol_kind(SymbolKind kind)
+{
+    switch (kind) {
+    case SymbolKind::Function:
+        return GLSLLS_KIND_FUNCTION;
+    case SymbolKind::Struct:
+        return GLSLLS_KIND_STRUCT;
+    default:
+        return GLSLLS_KIND_VARIABLE;
+    }
+}
+
+glslls_symbol symbol_view(const SymbolOccurrence& symbol)
+{
+    return { view(symbol.name), view(symbol.type), symbol_kind(symbol.kind), symbol.line, symbol.character };
+}
+
+std::vector<glslls_diagnostic> diagnostic_views(const Analysis& analysis)
+{
+    std::vector<glslls_diagnostic> diagnostics;
+    for (const auto& diagnostic : analysis.diagnostics) {
+        diagnostics.push_back({
+            diagnostic.line,
+            diagnostic.start_character,
+            diagnostic.end_character,
+            diagnostic.severity,
+            view(diagnostic.message),
+        });
+    }
+    return diagnostics;
+}
+
+int error_code(const Error& error)
+{
+    switch (error.code) {
+    case ErrorCode::UnknownDocument:
+        return GLSLLS_ERROR_UNKNOWN_DOCUMENT;
+    case ErrorCode::UnsupportedLanguage:
+        return GLSLLS_ERROR_UNSUPPORTED_LANGUAGE;
+    default:
+        return GLSLLS_ERROR_INTERNAL;
+    }
+}
+
+// The core reports failures by return value; what can still throw is
+// running out of memory.
+template <typename F>
+int guarded(F&& f)
+{
+    try {
+        return f();
+    } catch (...) {
+        return GLSLLS_ERROR_INTERNAL;
+    }
+}
+
+}
+
+struct glslls_core {
+    explicit glslls_core(unsigned num_threads)
+        : core(num_threads)
+    {
+    }
+
+    Core core;
+
+    std::mutex results_mutex;
+    std::map<std::string, DocumentResults> results;
+    BatchResults batch;
+};
+
+glslls_core* glslls_core_create(unsigned num_threads)
+{
+    try {
+        return new glslls_core(num_threads);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void glslls_core_destroy(glslls_core* core)
+{
+    delete core;
+}
+
+int glslls_open_document(glslls_core* core, const char* uri,
+        const char* text, size_t text_size, int version)
+{
+    return guarded([&]() {
+        core->core.open_document(uri, std::string(text, text_size), version);
+        return GLSLLS_OK;
+    });
+}
+
+int glslls_update_document(glslls_core* core, const char* uri,
+        const char* text, size_t text_size, int version)
+{
+    return guarded([&]() {
+        if (!core->core.update_document(uri, std::string(text, text_size), version)) {
+            return GLSLLS_ERROR_UNKNOWN_DOCUMENT;
+        }
+        return GLSLLS_OK;
+    });
+}
+
+int glslls_close_document(glslls_core* core, const char* uri)
+{
+    return guarded([&]() {
+        {
+            std::lock_guard<std::mutex> lock(core->results_mutex);
+            core->results.erase(uri);
+        }
+        if (!core->core.close_document(uri)) {
+            return GLSLLS_ERROR_UNKNOWN_DOCUMENT;
+        }
+        return GLSLLS_OK;
+    });
+}
+
+int glslls_get_diagnostics(glslls_core* core, const char* uri,
+        const glslls_diagnostic** diagnostics, size_t* count)
+{
+    return guarded([&]() -> int {
+        auto result = core->core.analysis(uri);
+        if (!result) {
+            return error_code(result.error());
+        }
+        const auto& analysis = *result;
+
+        std::lock_guard<std::mutex> lock(core->results_mutex);
+        auto& results = core->results[uri];
+        if (results.diagnostics_analysis != analysis) {
+            results.diagnostics_analysis = analysis;
+            results.diagnostics = diagnostic_views(*analysis);
+        }
+        *diagnostics = results.diagnostics.data();
+        *count = results.diagnostics.size();
+        return GLSLLS_OK;
+    });
+}
+
+int glslls_query_position(glslls_core* core, const char* uri,
+        int line, int character, glslls_symbol* symbol)
+{
+    return guarded([&]() -> int {
+        auto result = core->core.analysis(uri);
+        if (!result) {
+            return error_code(result.error());
+        }
+        const auto& analysis = *result;
+        const auto found = find_symbol(*analysis, line, character);
+        if (!found) {
+            return GLSLLS_ERROR_NOT_FOUND;
+        }
+
+        std::lock_guard<std::mutex> lock(core->results_mutex);
+        core->results[uri].symbol_analysis = analysis;
+        *symbol = symbol_view(*found);
+        return GLSLLS_OK;
+    });
+}
+
+int glslls_complete(glslls_core* core, const char* uri,
+        int line, int character, const glslls_completion_item** items, size_t* count)
+{
+    return guarded([&]() -> int {
+        auto completion = core->core.complete(uri, line, character);
+        if (!completion) {
+            return error_code(completion.error());
+        }
+
+        std::lock_guard<std::mutex> lock(core->results_mutex);
+        auto& results = core->results[uri];
+        results.completion = std::move(*completion);
+        results.completion_items.clear();
+        for (const auto& item : results.completion) {
+            int kind = GLSLLS_KIND_VARIABLE;
+            if (item.kind == CompletionKind::Function) {
+                kind = GLSLLS_KIND_FUNCTION;
+            } else if (item.kind == CompletionKind::Keyword) {
+                kind = GLSLLS_KIND_KEYWORD;
+            } else if (item.kind == CompletionKind::Struct) {
+                kind = GLSLLS_KIND_STRUCT;
+            }
+            results.completion_items.push_back({ view(item.label), view(item.detail), kind });
+        }
+        *items = results.completion_items.data();
+        *count = results.completion_items.size();
+        return GLSLLS_OK;
+    });
+}
+
+int glslls_get_globals(glslls_core* core, const char* uri,
+        const glslls_symbol** globals, size_t* count)
+{
+    return guarded([&]() -> int {
+        auto result = core->core.analysis(uri);
+        if (!result) {
+            return error_code(result.error());
+        }
+        const auto& analysis = *result;
+
+        std::lock_guard<std::mutex> lock(core->results_mutex);
+        auto& results = core->results[uri];
+        if (results.globals_analysis != analysis) {
+            results.globals_analysis = analysis;
+            results.globals = global_declarations(*analysis);
+            results.global_symbols.clear();
+            for (const auto& global : results.globals) {
+                results.global_symbols.push_back(symbol_view(global));
+            }
+        }
+        *globals = results.global_symbols.data();
+        *count = results.global_symbols.size();
+        return GLSLLS_OK;
+    });
+}
+
+int glslls_profile(glslls_core* core, const char* uri,
+        double* total_milliseconds, glslls_string* report)
+{
+    return guarded([&]() -> int {
+        auto profile = core->core.profile(uri);
+        if (!profile) {
+            return error_code(profile.error());
+        }
+
+        std::lock_guard<std::mutex> lock(core->results_mutex);
+        auto& results = core->results[uri];
+        results.profile_report = profile_report(*profile);
+        *total_milliseconds = profile->total;
+        *report = view(results.profile_report);
+        return GLSLLS_OK;
+    });
+}
+
+int glslls_validate(glslls_core* core, const glslls_source* sources, size_t count,
+        const glslls_validation** results)
+{
+    return guarded([&]() {
+        std::vector<std::pair<std::string, std::string_view>> batch;
+        for (size_t i = 0; i < count; ++i) {
+            batch.emplace_back(sources[i].uri, std::string_view(sources[i].text, sources[i].text_size));
+        }
+        auto analyses = core->core.analyze_batch(batch);
+
+        BatchResults next;
+        next.analyses.resize(count);
+        next.globals.resize(count);
+        next.diagnostics.resize(count);
+        next.global_symbols.resize(count);
+        next.validations.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            auto& validation = next.validations[i];
+            if (!analyses[i]) {
+                validation = { error_code(analyses[i].error()), 0, nullptr, 0, nullptr, 0 };
+                continue;
+            }
+            const auto& analysis = *analyses[i];
+            next.analyses[i] = analysis;
+            next.globals[i] = global_declarations(*analysis);
+            next.diagnostics[i] = diagnostic_views(*analysis);
+            for (const auto& global : next.globals[i]) {
+                next.global_symbols[i].push_back(symbol_view(global));
+            }
+            validation = {
+                GLSLLS_OK,
+                analysis->parsed,
+                next.diagnostics[i].data(),
+                next.diagnostics[i].size(),
+                next.global_symbols[i].data(),
+                next.global_symbols[i].size(),
+            };
+        }
+
+        std::lock_guard<std::mutex> lock(core->results_mutex);
+        core->batch = std::move(next);
+        *results = core->batch.validations.data();
+        return GLSLLS_OK;
+    });
+}
@@ -0,0 +1,738 @@
+#include "core.hpp"
+#include "builtindocs.hpp"
+#include "scopetree.hpp"
+#include "text.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <set>
+
+// Keywords and builtin types offered by completion on top of the symbols
+// found in the document.
+static const char* const keywords[] = {
+    "attribute", "bool", "break", "bvec2", "bvec3", "bvec4", "buffer",
+    "case", "centroid", "coherent", "const", "continue", "default",
+    "discard", "do", "double", "dvec2", "dvec3", "dvec4", "else", "false",
+    "flat", "float", "for", "highp", "if", "in", "inout", "int", "invariant",
+    "isampler2D", "ivec2", "ivec3", "ivec4", "layout", "lowp", "mat2",
+    "mat3", "mat4", "mediump", "noperspective", "out", "patch", "precise",
+    "precision", "readonly", "restrict", "return", "sample", "sampler2D",
+    "sampler2DArray", "sampler2DShadow", "sampler3D", "samplerCube",
+    "shared", "smooth", "struct", "subroutine", "switch", "true", "uint",
+    "uniform", "usampler2D", "uvec2", "uvec3", "uvec4", "varying", "vec2",
+    "vec3", "vec4", "void", "volatile", "while", "writeonly",
+};
+
+Core::Core(unsigned num_threads)
+    : m_scheduler(num_threads)
+{
+}
+
+Core::~Core()
+{
+    m_index.cancel();
+}
+
+bool Core::is_initialized()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_workspace.is_initialized();
+}
+
+void Core::set_initialized(bool new_value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_workspace.set_initialized(new_value);
+}
+
+void Core::open_document(const std::string& uri, std::string text, int version)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    release(uri);
+    m_workspace.add_document(uri, std::move(text), version);
+    retain(uri);
+}
+
+bool Core::update_document(const std::string& uri, std::string text, int version)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    release(uri);
+    bool changed = m_workspace.change_document(uri, std::move(text), version);
+    retain(uri);
+    return changed;
+}
+
+bool Core::close_document(const std::string& uri)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    release(uri);
+    bool removed = m_workspace.remove_document(uri);
+    m_last_parsed.erase(uri);
+    m_header_analyses.erase(uri);
+    return removed;
+}
+
+std::vector<std::string> Core::document_uris()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> uris;
+    for (const auto& [uri, document] : m_workspace.documents()) {
+        uris.push_back(uri);
+    }
+    return uris;
+}
+
+void Core::add_folder(WorkspaceFolder folder)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_workspace.add_folder(std::move(folder));
+    ++m_folders_generation;
+}
+
+bool Core::remove_folder(const std::string& uri)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const WorkspaceFolder* folder = m_workspace.find_folder(uri);
+        if (!folder) {
+            return false;
+        }
+        path = folder->path;
+        m_workspace.remove_folder(uri);
+        ++m_folders_generation;
+    }
+    m_index.remove_root(path);
+    return true;
+}
+
+std::vector<std::string> Core::documents_in(const std::string& uri)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_workspace.documents_in(uri);
+}
+
+std::vector<WorkspaceFolder> Core::folders()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<WorkspaceFolder> folders;
+    for (const auto& [path, folder] : m_workspace.folders()) {
+        folders.push_back(folder);
+    }
+    return folders;
+}
+
+Expected<std::shared_ptr<const Analysis>> Core::analysis(const std::string& uri)
+{
+    if (is_header(uri)) {
+        return header_analysis(uri);
+    }
+
+    std::string text;
+    uint64_t hash;
+    std::shared_ptr<const Analysis> previous;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_workspace.documents().find(uri);
+        if (it == m_workspace.documents().end()) {
+            return Error{ ErrorCode::UnknownDocument, "Unknown document: " + uri };
+        }
+        AnalysisKey key = analysis_key(uri, it->second.hash);
+        auto cached = m_cache.find(key);
+        if (cached == m_cache.end()) {
+            auto restored = m_restored.find(key);
+            if (restored != m_restored.end()) {
+                cached = m_cache.insert(*restored).first;
+                m_restored.erase(restored);
+            }
+        }
+        if (cached != m_cache.end()) {
+            if (cached->second->parsed) {
+                m_last_parsed[uri] = cached->second;
+            }
+            return cached->second;
+        }
+        text = it->second.text;
+        hash = it->second.hash;
+        auto last = m_last_parsed.find(uri);
+        if (last != m_last_parsed.end()) {
+            previous = last->second;
+        }
+    }
+
+    // Parse without holding the lock, so that other documents can be
+    // analyzed concurrently.
+    auto result = analyze_document(uri, text, previous ? previous->scopes.get() : nullptr);
+    if (!result) {
+        return result.error();
+    }
+    auto analysis = std::make_shared<const Analysis>(std::move(*result));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_workspace.documents().find(uri);
+    if (it != m_workspace.documents().end() && it->second.hash == hash) {
+        m_cache[analysis_key(uri, hash)] = analysis;
+        if (analysis->parsed) {
+            m_last_parsed[uri] = analysis;
+        }
+    }
+    return analysis;
+}
+
+std::vector<Expected<std::shared_ptr<const Analysis>>> Core::analyze_batch(
+    const std::vector<std::pair<std::string, std::string_view>>& sources)
+{
+    std::vector<std::future<Expected<std::shared_ptr<const Analysis>>>> pending;
+    for (const auto& [uri, text] : sources) {
+        pending.push_back(m_scheduler.async(Scheduler::Priority::Interactive,
+            [&uri = uri, text = text]() -> Expected<std::shared_ptr<const Analysis>> {
+                auto result = analyze_document(uri, text);
+                if (!result) {
+                    return result.error();
+                }
+                return std::make_shared<const Analysis>(std::move(*result));
+            }));
+    }
+    std::vector<Expected<std::shared_ptr<const Analysis>>> results;
+    for (auto& future : pending) {
+        results.push_back(future.get());
+    }
+    return results;
+}
+
+namespace {
+
+// A context analysis runs on whichever thread gets to it first: a worker, or
+// the thread waiting for it, which runs those still queued itself. So
+// waiting never deadlocks, even on a worker.
+struct ContextJob {
+    std::atomic<bool> claimed{ false };
+    std::promise<void> done;
+    std::shared_ptr<const HeaderContextResult> result;
+};
+
+}
+
+Expected<std::shared_ptr<const Analysis>> Core::header_analysis(const std::string& uri)
+{
+    auto text = std::make_shared<std::string>();
+    uint64_t hash;
+    uint64_t includers;
+    Workspace workspace;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_workspace.documents().find(uri);
+        if (it == m_workspace.documents().end()) {
+            return Error{ ErrorCode::UnknownDocument, "Unknown document: " + uri };
+        }
+        includers = includers_hash();
+        auto cached = m_header_analyses.find(uri);
+        if (cached != m_header_analyses.end() && cached->second.analysis->hash == it->second.hash
+            && cached->second.includers == includers) {
+            return cached->second.analysis;
+        }
+        *text = it->second.text;
+        hash = it->second.hash;
+        workspace = m_workspace;
+    }
+
+    // Looking for includers reads every document and the file system, so it
+    // is done on a copy.
+    std::vector<HeaderContext> contexts = choose_header_contexts(uri, workspace);
+    uint64_t key = hash;
+    for (const auto& context : contexts) {
+        key = (key ^ context.hash) * 1099511628211ull;
+    }
+
+    std::vector<std::shared_ptr<const HeaderContextResult>> results;
+    std::shared_ptr<const Analysis> previous;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto cached = m_header_analyses.find(uri);
+        if (cached != m_header_analyses.end() && cached->second.key == key) {
+            cached->second.includers = includers;
+            return cached->second.analysis;
+        }
+        for (const auto& context : contexts) {
+            auto result = m_header_contexts.find({ hash, context.hash });
+            results.push_back(result != m_header_contexts.end() ? result->second : nullptr);
+        }
+        auto last = m_last_parsed.find(uri);
+        if (last != m_last_parsed.end()) {
+            previous = last->second;
+        }
+    }
+
+    std::vector<std::shared_ptr<ContextJob>> jobs(contexts.size());
+    for (size_t i = 0; i < contexts.size(); ++i) {
+        if (results[i]) {
+            continue;
+        }
+        auto job = std::make_shared<ContextJob>();
+        jobs[i] = job;
+        m_scheduler.submit(Scheduler::Priority::Interactive, [job, uri, text, context = contexts[i]]() {
+            if (!job->claimed.exchange(true)) {
+                job->result = std::make_shared<const HeaderContextResult>(analyze_header_context(uri, *text, context));
+                job->done.set_value();
+            }
+        });
+    }
+    for (size_t i = 0; i < contexts.size(); ++i) {
+        if (jobs[i] && !jobs[i]->claimed.exchange(true)) {
+            jobs[i]->result = std::make_shared<const HeaderContextResult>(analyze_header_context(uri, *text, contexts[i]));
+            jobs[i]->done.set_value();
+        }
+    }
+
+    auto analysis = std::make_shared<Analysis>();
+    analysis->hash = hash;
+    analysis->parsed = true;
+    analysis->info_log = "Analyzed in the context of";
+    std::vector<std::pair<std::string, const HeaderContextResult*>> named;
+    for (size_t i = 0; i < contexts.size(); ++i) {
+        if (jobs[i]) {
+            jobs[i]->done.get_future().wait();
+            results[i] = jobs[i]->result;
+        }
+        analysis->parsed = analysis->parsed && results[i]->parsed;
+        analysis->info_log += (i == 0 ? " " : ", ") + contexts[i].name;
+        named.emplace_back(contexts[i].name, results[i].get());
+    }
+    analysis->diagnostics = merge_context_diagnostics(named);
+    auto tokens = lex_document(*text);
+    analysis->scopes = std::make_shared<const ScopeTree>(
+        build_scope_tree(*text, tokens, previous ? previous->scopes.get() : nullptr));
+    analysis->syntax = std::make_shared<const SyntaxTree>(build_syntax_tree(*text, tokens));
+
+    // Results of contexts the header is no longer analyzed in are dropped, so
+    // that edits to the prologue of an includer don't pile them up. Those of
+    // a header changed meanwhile are not kept at all: nothing would release
+    // them.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_workspace.documents().find(uri);
+    if (it != m_workspace.documents().end() && it->second.hash == hash) {
+        std::set<uint64_t> current;
+        for (size_t i = 0; i < contexts.size(); ++i) {
+            m_header_contexts[{ hash, contexts[i].hash }] = results[i];
+            current.insert(contexts[i].hash);
+        }
+        for (auto context = m_header_contexts.lower_bound({ hash, 0 });
+             context != m_header_contexts.end() && context->first.first == hash;) {
+            context = current.count(context->first.second) ? std::next(context) : m_header_contexts.erase(context);
+        }
+        m_header_analyses[uri] = { key, includers, analysis };
+        if (analysis->parsed) {
+            m_last_parsed[uri] = analysis;
+        }
+    }
+    return std::shared_ptr<const Analysis>(analysis);
+}
+
+std::optional<SymbolOccurrence> Core::symbol_at(const std::string& uri, int line, int character)
+{
+    auto analysis = this->analysis(uri);
+    if (!analysis) {
+        return std::nullopt;
+    }
+    const auto symbol = find_symbol(**analysis, line, character);
+    if (!symbol) {
+        return std::nullopt;
+    }
+    return *symbol;
+}
+
+Expected<std::vector<CompletionItem>> Core::complete(const std::string& uri, int line, int character)
+{
+    auto analyzed = this->analysis(uri);
+    if (!analyzed) {
+        return analyzed.error();
+    }
+    const auto& analysis = *analyzed;
+
+    // The identifier being typed is whatever precedes the cursor on its line.
+    std::string prefix;
+    std::shared_ptr<const Analysis> last_parsed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_workspace.documents().find(uri);
+        if (it == m_workspace.documents().end()) {
+            return Error{ ErrorCode::UnknownDocument, "Unknown document: " + uri };
+        }
+        const std::string& text = it->second.text;
+        if (!analysis->parsed) {
+            auto it = m_last_parsed.find(uri);
+            if (it != m_last_parsed.end()) {
+                last_parsed = it->second;
+            }
+        }
+        std::string_view line_text = line >= 0 ? line_at(text, line) : std::string_view();
+        size_t end = std::min(line_text.size(), static_cast<size_t>(std::max(character, 0)));
+        size_t begin = end;
+        while (begin > 0 && is_identifier_char(line_text[begin - 1])) {
+            --begin;
+        }
+        prefix = line_text.substr(begin, end - begin);
+    }
+
+    // Declarations come from the scope tree, which is built even when the
+    // shader doesn't parse. What glslang saw on top of them are builtins such
+    // as gl_Position, or, while the shader doesn't parse, declarations the
+    // tree lost track of in the broken text.
+    std::vector<SymbolOccurrence> symbols;
+    std::set<std::string> declared;
+    if (analysis->scopes) {
+        symbols = visible_symbols(*analysis->scopes, line, character);
+        for (const auto& scope : analysis->scopes->scopes) {
+            for (const auto& declaration : scope.declarations) {
+                declared.insert(declaration.name);
+            }
+        }
+    }
+    const Analysis* ast = analysis->parsed ? analysis.get() : last_parsed.get();
+    if (ast) {
+        for (const auto& symbol : ast->symbols) {
+            if (declared.count(symbol.name) == 0) {
+                symbols.push_back(symbol);
+            }
+        }
+    }
+
+    std::map<std::string, CompletionItem> items;
+    for (const auto& symbol : symbols) {
+        if (symbol.name.compare(0, prefix.size(), prefix) != 0 || items.count(symbol.name)) {
+            continue;
+        }
+        CompletionItem item;
+        item.label = symbol.name;
+        item.detail = symbol.type;
+        item.kind = CompletionKind::Variable;
+        if (symbol.kind == SymbolKind::Function) {
+            item.kind = CompletionKind::Function;
+        } else if (symbol.kind == SymbolKind::Struct) {
+            item.kind = CompletionKind::Struct;
+        }
+        items[item.label] = item;
+    }
+    // Builtins glslang reported keep their type as detail; those the document
+    // doesn't use yet are offered too.
+    for (std::string_view name : builtin_doc_names(prefix)) {
+        std::string label(name);
+        if (declared.count(label)) {
+            continue;
+        }
+        const BuiltinDoc* doc = find_builtin_doc(name);
+        if (!doc) {
+            continue;
+        }
+        CompletionItem& item = items[label];
+        if (item.label.empty()) {
+            item.label = label;
+            item.detail = doc->signatures.front();
+            item.kind = doc->is_function ? CompletionKind::Function : CompletionKind::Variable;
+        }
+        item.documentation = builtin_doc_markdown(*doc);
+    }
+    for (const char* keyword : keywords) {
+        std::string label = keyword;
+        if (label.compare(0, prefix.size(), prefix) != 0 || items.count(label)) {
+            continue;
+        }
+        CompletionItem item;
+        item.label = label;
+        item.kind = CompletionKind::Keyword;
+        items[label] = item;
+    }
+
+    std::vector<CompletionItem> result;
+    for (auto& [label, item] : items) {
+        result.push_back(std::move(item));
+    }
+    return result;
+}
+
+Expected<std::optional<HoverInfo>> Core::hover(const std::string& uri, int line, int character)
+{
+    auto analyzed = this->analysis(uri);
+    if (!analyzed) {
+        return analyzed.error();
+    }
+    if (line < 0) {
+        return std::optional<HoverInfo>();
+    }
+    const auto& analysis = *analyzed;
+
+    HoverInfo hover;
+    hover.line = line;
+    std::string name;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_workspace.documents().find(uri);
+        if (it == m_workspace.documents().end()) {
+            return Error{ ErrorCode::UnknownDocument, "Unknown document: " + uri };
+        }
+        std::string_view line_text = line_at(it->second.text, line);
+        size_t begin = std::min(line_text.size(), static_cast<size_t>(std::max(character, 0)));
+        size_t end = begin;
+        while (begin > 0 && is_identifier_char(line_text[begin - 1])) {
+            --begin;
+        }
+        while (end < line_text.size() && is_identifier_char(line_text[end])) {
+            ++end;
+        }
+        name = line_text.substr(begin, end - begin);
+        hover.start_character = static_cast<int>(begin);
+        hover.end_character = static_cast<int>(end);
+    }
+    if (name.empty() || !is_identifier_start(name[0])) {
+        return std::optional<HoverInfo>();
+    }
+
+    // A declaration of the document shadows the builtin of the same name.
+    bool declared = false;
+    if (analysis->scopes) {
+        for (const auto& symbol : visible_symbols(*analysis->scopes, line, character)) {
+            declared = declared || symbol.name == name;
+        }
+    }
+    const BuiltinDoc* doc = declared ? nullptr : find_builtin_doc(name);
+    if (doc) {
+        hover.contents = builtin_doc_markdown(*doc);
+        return std::optional<HoverInfo>(hover);
+    }
+    const SymbolOccurrence* symbol = find_symbol(*analysis, line, character);
+    if (!symbol || symbol->name != name) {
+        return std::optional<HoverInfo>();
+    }
+    hover.contents = "```glsl\n" + symbol->type + " " + symbol->name + "\n```";
+    return std::optional<HoverInfo>(hover);
+}
+
+Expected<std::vector<std::vector<SyntaxRange>>> Core::selection_ranges(const std::string& uri,
+    const std::vector<std::pair<int, int>>& positions)
+{
+    auto analysis = this->analysis(uri);
+    if (!analysis) {
+        return analysis.error();
+    }
+    std::shared_ptr<const SyntaxTree> syntax = (*analysis)->syntax;
+    if (!syntax) {
+        // Analyses restored from a snapshot don't have one.
+        std::string text;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_workspace.documents().find(uri);
+            if (it == m_workspace.documents().end()) {
+                return Error{ ErrorCode::UnknownDocument, "Unknown document: " + uri };
+            }
+            text = it->second.text;
+        }
+        syntax = std::make_shared<const SyntaxTree>(build_syntax_tree(text, lex_document(text)));
+    }
+    return ::selection_ranges(*syntax, positions);
+}
+
+Expected<ShaderProfile> Core::profile(const std::string& uri)
+{
+    std::string text;
+    std::vector<std::string> include_paths;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_workspace.documents().find(uri);
+        if (it == m_workspace.documents().end()) {
+            return Error{ ErrorCode::UnknownDocument, "Unknown document: " + uri };
+        }
+        text = it->second.text;
+        if (const WorkspaceFolder* folder = m_workspace.folder_of(uri)) {
+            include_paths = folder->include_paths;
+        }
+    }
+    return profile_document(uri, text, include_paths);
+}
+
+Expected<IndexStats> Core::index_folder(const std::string& uri, const std::string& cache_path)
+{
+    std::string root;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const WorkspaceFolder* folder = m_workspace.find_folder(uri);
+        if (!folder) {
+            return Error{ ErrorCode::InvalidParams, "Unknown workspace folder: " + uri };
+        }
+        root = folder->path;
+    }
+    if (!cache_path.empty()) {
+        std::lock_guard<std::mutex> lock(m_index_cache_mutex);
+        if (m_loaded_index_caches.insert(cache_path).second) {
+            m_index.load(cache_path);
+        }
+    }
+    // Summaries only depend on the content, not on the folder's settings:
+    // shaders are compiled without includes and headers not compiled at all.
+    // Headers have no stage; their globals come from the scope tree alone.
+    auto summarize = [](const std::string& uri, const std::string& text) -> std::optional<FileSummary> {
+        Analysis analysis;
+        if (is_header(uri)) {
+            analysis.scopes = std::make_shared<const ScopeTree>(build_scope_tree(text, lex_document(text)));
+        } else {
+            auto analyzed = analyze_document(uri, text);
+            if (!analyzed) {
+                return std::nullopt;
+            }
+            analysis = std::move(*analyzed);
+        }
+        FileSummary summary;
+        summary.parsed = analysis.parsed;
+        for (const auto& diagnostic : analysis.diagnostics) {
+            summary.errors += diagnostic.severity == 1;
+            summary.warnings += diagnostic.severity == 2;
+        }
+        summary.globals = global_declarations(analysis);
+        return summary;
+    };
+    IndexStats stats = m_index.build(root, m_scheduler, summarize);
+    {
+        // The folder may have been removed before the build started.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_workspace.find_folder(uri)) {
+            m_index.remove_root(root);
+        }
+    }
+    if (!cache_path.empty()) {
+        m_index.save(cache_path);
+    }
+    return stats;
+}
+
+std::vector<std::string> Core::folders_to_reindex()
+{
+    auto roots = m_index.changed_roots();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> uris;
+    for (const auto& root : roots) {
+        auto it = m_workspace.folders().find(root);
+        if (it != m_workspace.folders().end()) {
+            uris.push_back(it->second.uri);
+        }
+    }
+    return uris;
+}
+
+std::optional<std::string> Core::indexed_folder_of(const std::string& uri)
+{
+    std::string root;
+    std::string folder_uri;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const WorkspaceFolder* folder = m_workspace.folder_of(uri);
+        if (!folder) {
+            return std::nullopt;
+        }
+        root = folder->path;
+        folder_uri = folder->uri;
+    }
+    if (!m_index.has_root(root)) {
+        return std::nullopt;
+    }
+    return folder_uri;
+}
+
+std::vector<std::pair<std::string, SymbolOccurrence>> Core::workspace_symbols(std::string_view query, size_t limit)
+{
+    return m_index.find_symbols(query, limit);
+}
+
+IndexStats Core::index_stats()
+{
+    return m_index.stats();
+}
+
+std::map<std::string, IndexStats> Core::folder_index_stats()
+{
+    return m_index.root_stats();
+}
+
+bool Core::save_snapshot(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_restored.clear();
+    return write_snapshot(path, m_workspace, m_cache);
+}
+
+std::optional<RestoredSnapshot> Core::load_snapshot(const std::string& path)
+{
+    auto restored = restore_snapshot(path);
+    if (!restored.has_value()) {
+        return std::nullopt;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_restored.insert(restored->analyses.begin(), restored->analyses.end());
+    }
+
+    // Nothing waits for these: a document opened before its analysis is
+    // ready is simply analyzed on demand.
+    for (const auto& [uri, text] : restored->stale_documents) {
+        m_scheduler.submit(Scheduler::Priority::Background, [this, uri = uri, text = text]() {
+            // Documents of no stage glslang knows stay unanalyzed.
+            auto result = analyze_document(uri, text);
+            if (!result) {
+                return;
+            }
+            AnalysisKey key = analysis_key(uri, result->hash);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_cache.count(key) == 0) {
+                m_restored[key] = std::make_shared<const Analysis>(std::move(*result));
+            }
+        });
+    }
+    return restored;
+}
+
+Scheduler& Core::scheduler()
+{
+    return m_scheduler;
+}
+
+uint64_t Core::includers_hash() const
+{
+    uint64_t hash = m_folders_generation;
+    for (const auto& [uri, document] : m_workspace.documents()) {
+        if (!is_header(uri)) {
+            hash = (hash ^ hash_string(uri) ^ document.hash) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+void Core::retain(const std::string& uri)
+{
+    auto it = m_workspace.documents().find(uri);
+    if (it != m_workspace.documents().end()) {
+        ++m_references[analysis_key(uri, it->second.hash)];
+    }
+}
+
+void Core::release(const std::string& uri)
+{
+    auto it = m_workspace.documents().find(uri);
+    if (it == m_workspace.documents().end()) {
+        return;
+    }
+    AnalysisKey key = analysis_key(uri, it->second.hash);
+    auto references = m_references.find(key);
+    if (references == m_references.end() || --references->second > 0) {
+        return;
+    }
+    m_references.erase(references);
+    m_cache.erase(key);
+    // Headers have no stage, so this was the last header with the content.
+    if (key.first == -1) {
+        auto first = m_header_contexts.lower_bound({ key.second, 0 });
+        auto last = first;
+        while (last != m_header_contexts.end() && last->first.first == key.second) {
+            ++last;
+        }
+        m_header_contexts.erase(first, last);
+    }
+}
@@ -0,0 +1,191 @@
+#ifndef CORE_H
+#define CORE_H
+
+#include "analysis.hpp"
+#include "headers.hpp"
+#include "profiler.hpp"
+#include "scheduler.hpp"
+#include "snapshot.hpp"
+#include "syntaxtree.hpp"
+#include "workspace.hpp"
+#include "workspaceindex.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+enum class CompletionKind {
+    Variable,
+    Function,
+    Keyword,
+    Struct,
+};
+
+struct CompletionItem {
+    std::string label;
+    std::string detail;
+    CompletionKind kind = CompletionKind::Variable;
+
+    // Markdown, for builtins.
+    std::string documentation;
+};
+
+struct HoverInfo {
+    // Markdown.
+    std::string contents;
+
+    // The identifier hovered.
+    int line = 0;
+    int start_character = 0;
+    int end_character = 0;
+};
+
+// The language server minus the protocol: documents, their analyses and the
+// workers computing them. Every method is thread safe, so the core can be
+// embedded and driven from any number of threads.
+//
+// A workspace may have several folders, each with its include paths and its
+// part of the index. The documents, the caches of results keyed by content,
+// glslang and the workers are shared by all of them.
+class Core
+{
+
+public:
+    // 0 threads means one worker per hardware thread.
+    explicit Core(unsigned num_threads = 0);
+    virtual ~Core();
+
+    Core(const Core&) = delete;
+    Core& operator=(const Core&) = delete;
+
+    bool is_initialized();
+    void set_initialized(bool new_value);
+
+    void open_document(const std::string& uri, std::string text, int version = 0);
+    bool update_document(const std::string& uri, std::string text, int version = 0);
+    bool close_document(const std::string& uri);
+    std::vector<std::string> document_uris();
+
+    // Adds a workspace folder, or replaces the settings of one. Documents
+    // under it are analyzed with its include paths from then on.
+    void add_folder(WorkspaceFolder folder);
+    // Forgets the folder and its part of the index, stopping its indexing.
+    bool remove_folder(const std::string& uri);
+    std::vector<WorkspaceFolder> folders();
+    // The open documents inside the directory `uri`, whose include paths
+    // change with the folders around it.
+    std::vector<std::string> documents_in(const std::string& uri);
+
+    // Returns the analysis of the current content of `uri`, parsing it if it
+    // hasn't been analyzed yet. Fails for unknown documents and documents of
+    // no stage glslang knows. Headers are analyzed in the contexts of the
+    // open documents including them (see headers.hpp), in parallel, and
+    // their diagnostics merged.
+    Expected<std::shared_ptr<const Analysis>> analysis(const std::string& uri);
+
+    // Analyzes shaders that aren't open, in parallel on the workers, each of
+    // the given URI's stage. Nothing is cached.
+    std::vector<Expected<std::shared_ptr<const Analysis>>> analyze_batch(
+        const std::vector<std::pair<std::string, std::string_view>>& sources);
+
+    std::optional<SymbolOccurrence> symbol_at(const std::string& uri, int line, int character);
+    // Offers the declarations visible at the position. While the document
+    // doesn't parse, symbols of its last successful parse are offered too.
+    // Like the other queries, fails for documents analysis() fails for.
+    Expected<std::vector<CompletionItem>> complete(const std::string& uri, int line, int character);
+    // Builtins get their reference documentation, declarations of the
+    // document their type. Empty when there is nothing to show.
+    Expected<std::optional<HoverInfo>> hover(const std::string& uri, int line, int character);
+    // For each (line, character) position, the ranges containing it from the
+    // innermost out, as selection_ranges().
+    Expected<std::vector<std::vector<SyntaxRange>>> selection_ranges(const std::string& uri,
+        const std::vector<std::pair<int, int>>& positions);
+
+    // Profiles glslang on the current content of `uri`, on the calling
+    // thread.
+    Expected<ShaderProfile> profile(const std::string& uri);
+
+    // Indexes the shader files of the workspace folder `uri` as
+    // WorkspaceIndex::build(), leaving other folders be. The summaries cached
+    // at `cache_path` are loaded the first time, and saved after every
+    // folder, unless it is empty. Blocks until done; meant to run in the
+    // background. Fails for unknown folders.
+    Expected<IndexStats> index_folder(const std::string& uri, const std::string& cache_path);
+    // The indexed folders whose git index was rewritten since, as by a
+    // checkout or a commit, each reported once per change.
+    std::vector<std::string> folders_to_reindex();
+    // The innermost folder containing `uri`, if it is indexed.
+    std::optional<std::string> indexed_folder_of(const std::string& uri);
+    // Global declarations of the indexed files matching `query`, in all
+    // folders.
+    std::vector<std::pair<std::string, SymbolOccurrence>> workspace_symbols(std::string_view query,
+        size_t limit = 256);
+    // Of all folders together, and of each folder by its path.
+    IndexStats index_stats();
+    std::map<std::string, IndexStats> folder_index_stats();
+
+    bool save_snapshot(const std::string& path);
+    // Makes the analyses of a snapshot available to documents opened with
+    // the same content, and reanalyzes the stale ones in the background.
+    std::optional<RestoredSnapshot> load_snapshot(const std::string& path);
+
+    Scheduler& scheduler();
+
+private:
+    Expected<std::shared_ptr<const Analysis>> header_analysis(const std::string& uri);
+
+    // Count the documents using each analysis key, before and after a
+    // document changes. Results no document uses any more are dropped. Must be
+    // called with m_mutex held.
+    void retain(const std::string& uri);
+    void release(const std::string& uri);
+    // Of the URIs and contents of all shaders that could include a header,
+    // and of the folders. Must be called with m_mutex held.
+    uint64_t includers_hash() const;
+
+    std::mutex m_mutex;
+    Workspace m_workspace;
+    AnalysisCache m_cache;
+    std::map<AnalysisKey, int> m_references;
+
+    // Analyses restored from a snapshot that no open document uses yet. A
+    // document opened with the same content takes its analysis over into
+    // m_cache. Dropped when the next snapshot is written, as that only holds
+    // open documents.
+    AnalysisCache m_restored;
+
+    // The last analysis of each open document that glslang accepted. Its
+    // scope tree is the base the next one reuses functions from.
+    std::map<std::string, std::shared_ptr<const Analysis>> m_last_parsed;
+
+    // Bumped whenever folders change, as they decide where includes are
+    // found.
+    uint64_t m_folders_generation = 0;
+
+    struct HeaderMemo {
+        // The combined hash of the header's text and contexts, and the
+        // includers_hash() they were last found with.
+        uint64_t key = 0;
+        uint64_t includers = 0;
+        std::shared_ptr<const Analysis> analysis;
+    };
+
+    // Header results by (header hash, context hash), and the last analysis
+    // of each header. While no shader that could include it and no folder
+    // changed, a header's memo is returned without looking for its includers
+    // again.
+    std::map<std::pair<uint64_t, uint64_t>, std::shared_ptr<const HeaderContextResult>> m_header_contexts;
+    std::map<std::string, HeaderMemo> m_header_analyses;
+
+    // Has a lock of its own: queries don't wait for indexing.
+    WorkspaceIndex m_index;
+    std::mutex m_index_cache_mutex;
+    std::set<std::string> m_loaded_index_caches;
+    Scheduler m_scheduler;
+};
+
+#endif /* CORE_H */
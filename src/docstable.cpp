@@ -0,0 +1,124 @@
+#include "docstable.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+static const size_t min_match = 3;
+static const size_t max_match = 0x7f + min_match;
+static const size_t max_literals = 0x80;
+static const size_t max_distance = 0xffff;
+
+// Candidates tried per position, most recent first. Plenty for texts of a
+// few hundred bytes.
+static const size_t max_candidates = 256;
+
+std::string lz_compress(std::string_view text, std::string_view dictionary)
+{
+    if (dictionary.size() > max_distance) {
+        dictionary = dictionary.substr(dictionary.size() - max_distance);
+    }
+    // The window is the dictionary followed by the text, positions in the
+    // text being offset by the size of the dictionary.
+    std::string window(dictionary);
+    window += text;
+    const size_t start = dictionary.size();
+
+    auto key = [&](size_t i) {
+        return static_cast<uint32_t>(static_cast<unsigned char>(window[i]))
+            | static_cast<uint32_t>(static_cast<unsigned char>(window[i + 1])) << 8
+            | static_cast<uint32_t>(static_cast<unsigned char>(window[i + 2])) << 16;
+    };
+    std::unordered_map<uint32_t, std::vector<size_t>> positions;
+    auto index_to = [&, next = size_t(0)](size_t end) mutable {
+        for (; next < end && next + min_match <= window.size(); ++next) {
+            positions[key(next)].push_back(next);
+        }
+    };
+
+    std::string out;
+    std::string literals;
+    auto flush_literals = [&]() {
+        for (size_t i = 0; i < literals.size(); i += max_literals) {
+            size_t count = std::min(max_literals, literals.size() - i);
+            out += static_cast<char>(count - 1);
+            out.append(literals, i, count);
+        }
+        literals.clear();
+    };
+
+    size_t i = start;
+    while (i < window.size()) {
+        index_to(i);
+        size_t best_size = 0;
+        size_t best_distance = 0;
+        if (i + min_match <= window.size()) {
+            auto it = positions.find(key(i));
+            if (it != positions.end()) {
+                const auto& candidates = it->second;
+                size_t tried = 0;
+                for (auto c = candidates.rbegin(); c != candidates.rend() && tried < max_candidates; ++c, ++tried) {
+                    if (i - *c > max_distance) {
+                        break;
+                    }
+                    size_t size = 0;
+                    while (size < max_match && i + size < window.size() && window[*c + size] == window[i + size]) {
+                        ++size;
+                    }
+                    if (size > best_size) {
+                        best_size = size;
+                        best_distance = i - *c;
+                    }
+                }
+            }
+        }
+        if (best_size >= min_match) {
+            flush_literals();
+            out += static_cast<char>(0x80 | (best_size - min_match));
+            out += static_cast<char>(best_distance & 0xff);
+            out += static_cast<char>(best_distance >> 8);
+            i += best_size;
+        } else {
+            literals += window[i];
+            ++i;
+        }
+    }
+    flush_literals();
+    return out;
+}
+
+bool lz_decompress(const uint8_t* data, size_t data_size, std::string_view dictionary, size_t size,
+    std::string& text)
+{
+    text.clear();
+    text.reserve(size);
+    size_t i = 0;
+    while (i < data_size) {
+        uint8_t token = data[i++];
+        if (token < 0x80) {
+            size_t count = token + 1;
+            if (i + count > data_size || text.size() + count > size) {
+                return false;
+            }
+            text.append(reinterpret_cast<const char*>(data + i), count);
+            i += count;
+            continue;
+        }
+        if (i + 2 > data_size) {
+            return false;
+        }
+        size_t count = (token & 0x7f) + min_match;
+        size_t distance = data[i] | static_cast<size_t>(data[i + 1]) << 8;
+        i += 2;
+        if (distance == 0 || distance > text.size() + dictionary.size() || text.size() + count > size) {
+            return false;
+        }
+        // Byte by byte: a match may overlap the bytes it produces.
+        for (size_t k = 0; k < count; ++k) {
+            size_t position = text.size();
+            text += distance > position ? dictionary[dictionary.size() - (distance - position)]
+                                        : text[position - distance];
+        }
+    }
+    return text.size() == size;
+}
@@ -0,0 +1,76 @@
+#ifndef DOCSTABLE_H
+#define DOCSTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// The format of the builtin documentation table, shared by tools/docgen.cpp,
+// which writes it as C++ at build time, and builtindocs.cpp, which reads it.
+//
+// Entries are found by a minimal perfect hash (hash and displace): a name's
+// bucket is docs_hash(name, 0) % bucket_count, and its entry is
+// docs_hash(name, displacements[bucket]) % entry_count. The name stored in the
+// entry tells whether the name looked up is documented at all.
+//
+// The text of each entry is compressed on its own, so that looking one up
+// decompresses nothing else. Matches may reach back into a dictionary of
+// fragments common to all entries, which is what makes short texts compress.
+
+struct DocsEntry {
+    // Offsets into DocsTable::names and DocsTable::data.
+    uint32_t name;
+    uint32_t data;
+    uint16_t name_size;
+    uint16_t data_size;
+
+    // The decompressed text is the signatures, one per line, followed by the
+    // description.
+    uint16_t text_size;
+    uint16_t signatures_size;
+};
+
+struct DocsTable {
+    const DocsEntry* entries;
+    uint32_t entry_count;
+    const uint16_t* displacements;
+    uint32_t bucket_count;
+    const char* names;
+    const uint8_t* data;
+    const uint8_t* dictionary;
+    uint32_t dictionary_size;
+};
+
+// Defined by the file tools/docgen.cpp generates.
+extern const DocsTable builtin_docs_table;
+
+// 32-bit FNV-1a, seeded, with a final avalanche so that its low bits can be
+// taken modulo the table size.
+inline uint32_t docs_hash(std::string_view name, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (unsigned char c : name) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// A byte-oriented LZ77. Each token starts with a byte t: below 0x80, t + 1
+// literal bytes follow; otherwise the token is a match of (t & 0x7f) + 3
+// bytes at a distance given by the next two bytes, little endian, from the
+// current position. Distances reaching before the start of the text continue
+// into the end of the dictionary.
+std::string lz_compress(std::string_view text, std::string_view dictionary);
+
+// Fails on corrupt input or if the result isn't `size` bytes long.
+bool lz_decompress(const uint8_t* data, size_t data_size, std::string_view dictionary, size_t size,
+    std::string& text);
+
+#endif /* DOCSTABLE_H */
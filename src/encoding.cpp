@@ -0,0 +1,72 @@
+#include "encoding.hpp"
+#include "text.hpp"
+
+BodyEncoding encoding_from_content_type(const std::string& content_type)
+{
+    // Parameters such as "; charset=utf-8" don't matter here.
+    std::string_view value = content_type;
+    auto mime_type = trim(value.substr(0, value.find(';')), " \t");
+
+    if (equals_ignore_case(mime_type, "application/msgpack") || equals_ignore_case(mime_type, "application/x-msgpack")
+            || equals_ignore_case(mime_type, "application/vnd.msgpack")) {
+        return BodyEncoding::MessagePack;
+    } else if (equals_ignore_case(mime_type, "application/cbor")) {
+        return BodyEncoding::Cbor;
+    }
+    return BodyEncoding::Json;
+}
+
+const char* content_type_of(BodyEncoding encoding)
+{
+    switch (encoding) {
+    case BodyEncoding::MessagePack:
+        return "application/msgpack";
+    case BodyEncoding::Cbor:
+        return "application/cbor";
+    case BodyEncoding::Json:
+        break;
+    }
+    return "application/vscode-jsonrpc;charset=utf-8";
+}
+
+Expected<json> decode_body(const std::string& bytes, BodyEncoding encoding)
+{
+    // Parse without exceptions: malformed bodies come back discarded.
+    json body;
+    switch (encoding) {
+    case BodyEncoding::MessagePack:
+        body = json::from_msgpack(bytes, true, false);
+        break;
+    case BodyEncoding::Cbor:
+        body = json::from_cbor(bytes, true, false);
+        break;
+    case BodyEncoding::Json:
+        body = json::parse(bytes, nullptr, false);
+        break;
+    }
+    if (body.is_discarded()) {
+        return Error{ ErrorCode::ParseError, std::string("Couldn't parse message as ") + content_type_of(encoding) };
+    }
+    return body;
+}
+
+std::string encode_body(const json& body, BodyEncoding encoding)
+{
+    std::string bytes;
+    switch (encoding) {
+    case BodyEncoding::MessagePack:
+        json::to_msgpack(body, bytes);
+        return bytes;
+    case BodyEncoding::Cbor:
+        json::to_cbor(body, bytes);
+        return bytes;
+    case BodyEncoding::Json:
+        break;
+    }
+    return dump_json(body, 4);
+}
+
+std::string dump_json(const json& value, int indent)
+{
+    return value.dump(indent, ' ', false, json::error_handler_t::replace);
+}
@@ -0,0 +1,34 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include "expected.hpp"
+
+#include "nlohmann/json.hpp"
+
+#include <string>
+
+using json = nlohmann::json;
+
+// How the body of a message is serialized. Framing is the same for all of
+// them; the encoding is selected per message by its Content-Type header and
+// responses use the encoding of the request they answer.
+enum class BodyEncoding {
+    Json,
+    MessagePack,
+    Cbor,
+};
+
+// Unknown or missing content types fall back to JSON.
+BodyEncoding encoding_from_content_type(const std::string& content_type);
+
+const char* content_type_of(BodyEncoding encoding);
+
+Expected<json> decode_body(const std::string& bytes, BodyEncoding encoding);
+
+std::string encode_body(const json& body, BodyEncoding encoding);
+
+// Serializes as JSON, replacing invalid UTF-8, which binary encodings let
+// into strings, instead of throwing.
+std::string dump_json(const json& value, int indent = -1);
+
+#endif /* ENCODING_H */
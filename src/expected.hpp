@@ -0,0 +1,64 @@
+#ifndef EXPECTED_H
+#define EXPECTED_H
+
+#include <string>
+#include <utility>
+#include <variant>
+
+// Error codes of replies. Those below -32600 are JSON-RPC's, -32002 and
+// those from -32899 to -32800 are the LSP's; the others are glslls's own,
+// from the range JSON-RPC leaves to servers.
+enum class ErrorCode {
+    ParseError = -32700,
+    InvalidRequest = -32600,
+    MethodNotFound = -32601,
+    InvalidParams = -32602,
+    InternalError = -32603,
+    ServerNotInitialized = -32002,
+    ContentModified = -32801,
+    ServerCancelled = -32802,
+    RequestFailed = -32803,
+    UnknownDocument = -32010,
+    UnsupportedLanguage = -32011,
+};
+
+struct Error {
+    ErrorCode code = ErrorCode::InternalError;
+    std::string message;
+};
+
+// A value or the Error that prevented it, for the request path, which
+// reports failures by return value rather than by throwing. Accessing the
+// value of an Expected holding an error, or the reverse, is undefined.
+template <typename T>
+class Expected
+{
+
+public:
+    Expected(T value)
+        : m_state(std::in_place_index<0>, std::move(value))
+    {
+    }
+
+    Expected(Error error)
+        : m_state(std::in_place_index<1>, std::move(error))
+    {
+    }
+
+    bool has_value() const { return m_state.index() == 0; }
+    explicit operator bool() const { return has_value(); }
+
+    T& value() { return *std::get_if<0>(&m_state); }
+    const T& value() const { return *std::get_if<0>(&m_state); }
+    T& operator*() { return value(); }
+    const T& operator*() const { return value(); }
+    T* operator->() { return &value(); }
+    const T* operator->() const { return &value(); }
+
+    const Error& error() const { return *std::get_if<1>(&m_state); }
+
+private:
+    std::variant<T, Error> m_state;
+};
+
+#endif /* EXPECTED_H */
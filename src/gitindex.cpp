@@ -0,0 +1,321 @@
+#include "gitindex.hpp"
+#include "text.hpp"
+
+#include <experimental/filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::experimental::filesystem;
+
+namespace {
+
+// Big-endian fields of the index, bounds checked: reading past the end
+// fails the reader instead.
+class IndexReader
+{
+
+public:
+    IndexReader(const std::vector<uint8_t>& bytes, size_t end)
+        : m_bytes(bytes)
+        , m_end(end)
+    {
+    }
+
+    bool failed() const { return m_failed; }
+    size_t offset() const { return m_offset; }
+    const uint8_t* at(size_t offset) const { return m_bytes.data() + offset; }
+
+    uint32_t u32()
+    {
+        if (!ensure(4)) {
+            return 0;
+        }
+        const uint8_t* p = at(m_offset);
+        m_offset += 4;
+        return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16
+            | static_cast<uint32_t>(p[2]) << 8 | p[3];
+    }
+
+    uint16_t u16()
+    {
+        if (!ensure(2)) {
+            return 0;
+        }
+        const uint8_t* p = at(m_offset);
+        m_offset += 2;
+        return static_cast<uint16_t>(p[0] << 8 | p[1]);
+    }
+
+    void bytes(uint8_t* out, size_t size)
+    {
+        if (ensure(size)) {
+            std::copy(at(m_offset), at(m_offset + size), out);
+            m_offset += size;
+        }
+    }
+
+    // The offset encoding of version 4 path prefixes.
+    uint64_t varint()
+    {
+        if (!ensure(1)) {
+            return 0;
+        }
+        uint8_t c = m_bytes[m_offset++];
+        uint64_t value = c & 0x7f;
+        while (c & 0x80) {
+            if (!ensure(1)) {
+                return 0;
+            }
+            c = m_bytes[m_offset++];
+            value = ((value + 1) << 7) | (c & 0x7f);
+        }
+        return value;
+    }
+
+    // Up to the next NUL, which is consumed.
+    std::string_view string()
+    {
+        size_t nul = m_offset;
+        while (nul < m_end && m_bytes[nul] != 0) {
+            ++nul;
+        }
+        if (nul == m_end) {
+            m_failed = true;
+            return {};
+        }
+        std::string_view value(reinterpret_cast<const char*>(at(m_offset)), nul - m_offset);
+        m_offset = nul + 1;
+        return value;
+    }
+
+    void seek(size_t offset)
+    {
+        if (offset > m_end) {
+            m_failed = true;
+        } else {
+            m_offset = offset;
+        }
+    }
+
+private:
+    bool ensure(size_t size)
+    {
+        if (m_failed || m_end - m_offset < size) {
+            m_failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    const std::vector<uint8_t>& m_bytes;
+    size_t m_end;
+    size_t m_offset = 0;
+    bool m_failed = false;
+};
+
+}
+
+static std::string read_file(const fs::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+}
+
+// The git directory of the work tree containing `directory`: .git itself, or
+// where a .git file points, as in linked work trees and submodules.
+static bool find_git_directory(const std::string& directory, fs::path& work_tree, fs::path& git_directory)
+{
+    std::error_code ec;
+    fs::path current = fs::canonical(directory, ec);
+    if (ec) {
+        return false;
+    }
+    for (; !current.empty(); current = current.parent_path()) {
+        fs::path dot_git = current / ".git";
+        if (fs::is_directory(dot_git, ec)) {
+            work_tree = current;
+            git_directory = dot_git;
+            return true;
+        }
+        if (fs::is_regular_file(dot_git, ec)) {
+            std::string contents = read_file(dot_git);
+            std::string_view line = trim(line_at(contents, 0));
+            if (line.substr(0, 7) != "gitdir:") {
+                return false;
+            }
+            fs::path target(std::string(trim(line.substr(7))));
+            work_tree = current;
+            git_directory = target.is_absolute() ? target : current / target;
+            return true;
+        }
+        if (current == current.root_path()) {
+            break;
+        }
+    }
+    return false;
+}
+
+// Ids of SHA-256 repositories are of no use to us; their format is set in
+// the config of the common git directory.
+static bool uses_sha256(const fs::path& git_directory)
+{
+    fs::path common = git_directory;
+    std::string commondir = read_file(git_directory / "commondir");
+    if (!commondir.empty()) {
+        fs::path target(std::string(trim(commondir)));
+        common = target.is_absolute() ? target : git_directory / target;
+    }
+    std::string config = read_file(common / "config");
+    for (std::string_view line : split(config, "\n")) {
+        std::string_view setting = trim(line);
+        size_t equals = setting.find('=');
+        if (equals != std::string_view::npos && equals_ignore_case(trim(setting.substr(0, equals)), "objectformat")) {
+            return equals_ignore_case(trim(setting.substr(equals + 1)), "sha256");
+        }
+    }
+    return false;
+}
+
+static bool stat_times(const std::string& path, uint32_t& mtime_seconds, uint32_t& mtime_nanoseconds,
+    uint32_t& ctime_seconds, uint32_t& ctime_nanoseconds, uint32_t& inode, uint64_t& size)
+{
+#ifndef _WIN32
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    mtime_seconds = static_cast<uint32_t>(st.st_mtim.tv_sec);
+    mtime_nanoseconds = static_cast<uint32_t>(st.st_mtim.tv_nsec);
+    ctime_seconds = static_cast<uint32_t>(st.st_ctim.tv_sec);
+    ctime_nanoseconds = static_cast<uint32_t>(st.st_ctim.tv_nsec);
+    inode = static_cast<uint32_t>(st.st_ino);
+    size = static_cast<uint64_t>(st.st_size);
+    return true;
+#else
+    // Git for Windows fills the stat data differently; always hash there.
+    (void)path, (void)mtime_seconds, (void)mtime_nanoseconds, (void)ctime_seconds, (void)ctime_nanoseconds;
+    (void)inode, (void)size;
+    return false;
+#endif
+}
+
+bool git_index_mtime(const std::string& path, uint32_t& mtime_seconds, uint32_t& mtime_nanoseconds)
+{
+    uint32_t ctime_seconds, ctime_nanoseconds, inode;
+    uint64_t size;
+    return stat_times(path, mtime_seconds, mtime_nanoseconds, ctime_seconds, ctime_nanoseconds, inode, size);
+}
+
+std::optional<GitIndex> read_git_index(const std::string& directory)
+{
+    fs::path work_tree;
+    fs::path git_directory;
+    if (!find_git_directory(directory, work_tree, git_directory) || uses_sha256(git_directory)) {
+        return std::nullopt;
+    }
+
+    GitIndex index;
+    index.work_tree = work_tree.string();
+    index.path = (git_directory / "index").string();
+    const std::string& index_path = index.path;
+    uint32_t ctime_seconds, ctime_nanoseconds, inode;
+    uint64_t index_size;
+    if (!stat_times(index_path, index.mtime_seconds, index.mtime_nanoseconds, ctime_seconds, ctime_nanoseconds,
+            inode, index_size)) {
+        return std::nullopt;
+    }
+
+    std::string contents = read_file(index_path);
+    std::vector<uint8_t> bytes(contents.begin(), contents.end());
+    const size_t checksum_size = 20;
+    if (bytes.size() < 12 + checksum_size) {
+        return std::nullopt;
+    }
+    IndexReader reader(bytes, bytes.size() - checksum_size);
+    uint8_t signature[4];
+    reader.bytes(signature, 4);
+    uint32_t version = reader.u32();
+    uint32_t count = reader.u32();
+    if (std::string_view(reinterpret_cast<const char*>(signature), 4) != "DIRC" || version < 2 || version > 4) {
+        return std::nullopt;
+    }
+
+    std::string path;
+    for (uint32_t i = 0; i < count && !reader.failed(); ++i) {
+        size_t start = reader.offset();
+        GitIndexEntry entry;
+        entry.ctime_seconds = reader.u32();
+        entry.ctime_nanoseconds = reader.u32();
+        entry.mtime_seconds = reader.u32();
+        entry.mtime_nanoseconds = reader.u32();
+        reader.u32(); // dev
+        entry.inode = reader.u32();
+        uint32_t mode = reader.u32();
+        reader.u32(); // uid
+        reader.u32(); // gid
+        entry.size = reader.u32();
+        reader.bytes(entry.id.data(), entry.id.size());
+        uint16_t flags = reader.u16();
+        uint16_t extended_flags = 0;
+        if (version >= 3 && (flags & 0x4000)) {
+            extended_flags = reader.u16();
+        }
+
+        if (version == 4) {
+            uint64_t strip = reader.varint();
+            if (strip > path.size()) {
+                return std::nullopt;
+            }
+            path.resize(path.size() - strip);
+            path += reader.string();
+        } else {
+            path = std::string(reader.string());
+            // Entries are padded with NULs to a multiple of eight bytes.
+            size_t length = reader.offset() - start;
+            reader.seek(start + ((length + 7) & ~size_t(7)));
+        }
+
+        bool regular_file = (mode >> 12) == 0b1000;
+        int stage = (flags >> 12) & 3;
+        bool skip_worktree = extended_flags & 0x4000;
+        bool intent_to_add = extended_flags & 0x2000;
+        if (regular_file && stage == 0 && !skip_worktree && !intent_to_add) {
+            index.entries[path] = entry;
+        }
+    }
+    if (reader.failed()) {
+        return std::nullopt;
+    }
+
+    // With a split index, most entries live in a shared index this one only
+    // amends.
+    while (!reader.failed() && reader.offset() + 8 <= bytes.size() - checksum_size) {
+        uint8_t extension[4];
+        reader.bytes(extension, 4);
+        uint32_t size = reader.u32();
+        if (std::string_view(reinterpret_cast<const char*>(extension), 4) == "link") {
+            return std::nullopt;
+        }
+        reader.seek(reader.offset() + size);
+    }
+    return index;
+}
+
+bool git_entry_matches(const GitIndex& index, const GitIndexEntry& entry, const std::string& path)
+{
+    uint32_t mtime_seconds, mtime_nanoseconds, ctime_seconds, ctime_nanoseconds, inode;
+    uint64_t size;
+    if (!stat_times(path, mtime_seconds, mtime_nanoseconds, ctime_seconds, ctime_nanoseconds, inode, size)) {
+        return false;
+    }
+    bool racy = index.mtime_seconds < entry.mtime_seconds
+        || (index.mtime_seconds == entry.mtime_seconds && index.mtime_nanoseconds <= entry.mtime_nanoseconds);
+    return !racy && mtime_seconds == entry.mtime_seconds && mtime_nanoseconds == entry.mtime_nanoseconds
+        && ctime_seconds == entry.ctime_seconds && ctime_nanoseconds == entry.ctime_nanoseconds
+        && inode == entry.inode && static_cast<uint32_t>(size) == entry.size;
+}
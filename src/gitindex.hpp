@@ -0,0 +1,57 @@
+#ifndef GITINDEX_H
+#define GITINDEX_H
+
+#include "sha1.hpp"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+
+// Reads git's index file (.git/index) directly, so that the blob ids of
+// tracked files are known without running git or reading the files.
+
+struct GitIndexEntry {
+    // The file's stat data when git last hashed it, truncated to 32 bits as
+    // git stores them.
+    uint32_t ctime_seconds = 0;
+    uint32_t ctime_nanoseconds = 0;
+    uint32_t mtime_seconds = 0;
+    uint32_t mtime_nanoseconds = 0;
+    uint32_t inode = 0;
+    uint32_t size = 0;
+
+    Sha1Digest id{};
+};
+
+struct GitIndex {
+    // The absolute path of the work tree the entry paths are relative to.
+    std::string work_tree;
+    // The index file itself.
+    std::string path;
+
+    // Regular files at stage 0 by '/' separated path. Conflicted, symlinked,
+    // skip-worktree and intent-to-add entries aren't included.
+    std::map<std::string, GitIndexEntry> entries;
+
+    // When the index was written. Entries not older than that are "racily
+    // clean": the file may have changed within the same timestamp.
+    uint32_t mtime_seconds = 0;
+    uint32_t mtime_nanoseconds = 0;
+};
+
+// Finds the work tree containing `directory` and reads its index, of
+// version 2, 3 or 4. Returns std::nullopt outside of a work tree, for
+// repositories of SHA-256 objects, split indexes, and anything that doesn't
+// parse.
+std::optional<GitIndex> read_git_index(const std::string& directory);
+
+// The mtime of the index file at `path`, as GitIndex records it, to notice
+// when it is rewritten, as by a checkout or a commit. False if it is gone.
+bool git_index_mtime(const std::string& path, uint32_t& mtime_seconds, uint32_t& mtime_nanoseconds);
+
+// Whether the file at `path` is unchanged since git recorded `entry`,
+// judging, like git, by its stat data only. False for racily clean entries.
+bool git_entry_matches(const GitIndex& index, const GitIndexEntry& entry, const std::string& path);
+
+#endif /* GITINDEX_H */
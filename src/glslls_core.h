@@ -0,0 +1,125 @@
+#ifndef GLSLLS_CORE_H
+#define GLSLLS_CORE_H
+
+/*
+ * In-process C API of the GLSL language server.
+ *
+ * Input buffers are only read during the call. Results are returned as
+ * borrowed views into memory owned by the core: they stay valid until the
+ * next call returning the same kind of result for the same document, or until
+ * the document is updated or closed. Nothing is JSON encoded.
+ *
+ * All positions are 0-based, as in the LSP specification.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct glslls_core glslls_core;
+
+enum {
+    GLSLLS_OK = 0,
+    GLSLLS_ERROR_UNKNOWN_DOCUMENT = -1,
+    GLSLLS_ERROR_UNSUPPORTED_LANGUAGE = -2,
+    GLSLLS_ERROR_NOT_FOUND = -3,
+    GLSLLS_ERROR_INTERNAL = -4,
+};
+
+enum {
+    GLSLLS_SEVERITY_ERROR = 1,
+    GLSLLS_SEVERITY_WARNING = 2,
+};
+
+enum {
+    GLSLLS_KIND_VARIABLE = 0,
+    GLSLLS_KIND_FUNCTION = 1,
+    GLSLLS_KIND_KEYWORD = 2,
+    GLSLLS_KIND_STRUCT = 3,
+};
+
+/* Not NUL terminated. */
+typedef struct {
+    const char* data;
+    size_t size;
+} glslls_string;
+
+typedef struct {
+    int line;
+    int start_character;
+    int end_character;
+    int severity;
+    glslls_string message;
+} glslls_diagnostic;
+
+typedef struct {
+    glslls_string name;
+    glslls_string type;
+    int kind;
+    int line;
+    int character;
+} glslls_symbol;
+
+typedef struct {
+    glslls_string label;
+    glslls_string detail;
+    int kind;
+} glslls_completion_item;
+
+typedef struct {
+    /* NUL terminated. Its extension gives the stage, as for documents. */
+    const char* uri;
+    const char* text;
+    size_t text_size;
+} glslls_source;
+
+typedef struct {
+    /* GLSLLS_OK, or why the shader couldn't be analyzed. */
+    int status;
+    int parsed;
+    const glslls_diagnostic* diagnostics;
+    size_t diagnostic_count;
+    const glslls_symbol* globals;
+    size_t global_count;
+} glslls_validation;
+
+/* 0 threads means one worker per hardware thread. */
+glslls_core* glslls_core_create(unsigned num_threads);
+void glslls_core_destroy(glslls_core* core);
+
+int glslls_open_document(glslls_core* core, const char* uri,
+        const char* text, size_t text_size, int version);
+int glslls_update_document(glslls_core* core, const char* uri,
+        const char* text, size_t text_size, int version);
+int glslls_close_document(glslls_core* core, const char* uri);
+
+int glslls_get_diagnostics(glslls_core* core, const char* uri,
+        const glslls_diagnostic** diagnostics, size_t* count);
+int glslls_query_position(glslls_core* core, const char* uri,
+        int line, int character, glslls_symbol* symbol);
+int glslls_complete(glslls_core* core, const char* uri,
+        int line, int character, const glslls_completion_item** items, size_t* count);
+
+/* The declarations at global scope: functions, structs, uniforms, inputs,
+ * outputs and other globals, with glslang's types. */
+int glslls_get_globals(glslls_core* core, const char* uri,
+        const glslls_symbol** globals, size_t* count);
+
+/* Where glslang spends its time on the document: the total, and a report of
+ * phases, includes and functions. Runs on the calling thread. */
+int glslls_profile(glslls_core* core, const char* uri,
+        double* total_milliseconds, glslls_string* report);
+
+/* Analyzes `count` shaders in parallel on the worker pool, without opening
+ * them, and returns one result per source. Results stay valid until the next
+ * call to glslls_validate on the same core. */
+int glslls_validate(glslls_core* core, const glslls_source* sources, size_t count,
+        const glslls_validation** results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GLSLLS_CORE_H */
@@ -0,0 +1,242 @@
+#include "headers.hpp"
+#include "includer.hpp"
+#include "parsepool.hpp"
+#include "text.hpp"
+
+#include "ResourceLimits.h"
+
+#include <experimental/filesystem>
+#include <set>
+#include <tuple>
+
+namespace fs = std::experimental::filesystem;
+
+bool is_header(const std::string& uri)
+{
+    return fs::path(uri).extension() == ".glsl";
+}
+
+static std::string path_of(const std::string& uri)
+{
+    std::string path = uri_to_path(uri);
+    return path.empty() ? uri : path;
+}
+
+// Resolves "." and ".." without touching the file system, so that paths of
+// files that were never saved compare too.
+static std::string normalize_path(std::string_view path)
+{
+    std::vector<std::string_view> segments;
+    for (std::string_view segment : split(path, "/")) {
+        if (segment == "." || (segment.empty() && !segments.empty())) {
+            continue;
+        }
+        if (segment == ".." && !segments.empty() && segments.back() != "..") {
+            segments.pop_back();
+            continue;
+        }
+        segments.push_back(segment);
+    }
+    std::string normalized;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        normalized += i == 0 ? "" : "/";
+        normalized += segments[i];
+    }
+    return normalized;
+}
+
+// Where an include of `name` resolves to, as FileIncluder resolves it:
+// "local" includes next to the includer first, then, like <system>
+// includes, in each include path in order. The first candidate that exists
+// wins; `header_path` counts as existing even if it was never saved.
+static std::string resolve_include(const std::string& name, bool local, const std::string& directory,
+    const std::vector<std::string>& include_paths, const std::string& header_path)
+{
+    std::vector<std::string> candidates;
+    if (local) {
+        candidates.push_back(normalize_path(directory + "/" + name));
+    }
+    for (const auto& include_path : include_paths) {
+        candidates.push_back(normalize_path(include_path + "/" + name));
+    }
+    for (const auto& candidate : candidates) {
+        std::error_code ec;
+        if (candidate == header_path || fs::exists(candidate, ec)) {
+            return candidate;
+        }
+    }
+    return {};
+}
+
+// The offset of the line of the first #include in `text` that resolves to
+// `header_path`, from `includer_path` and the includer's `include_paths`, or
+// npos.
+static size_t find_include(std::string_view text, const std::string& includer_path,
+    const std::vector<std::string>& include_paths, const std::string& header_path)
+{
+    const std::string directory = fs::path(includer_path).parent_path().string();
+    const std::string header_name = fs::path(header_path).filename().string();
+    size_t offset = 0;
+    for (std::string_view line : split(text, "\n")) {
+        size_t line_offset = offset;
+        offset += line.size() + 1;
+
+        std::string_view rest = trim_left(line);
+        if (rest.substr(0, 1) != "#") {
+            continue;
+        }
+        rest = trim_left(rest.substr(1));
+        if (rest.substr(0, 7) != "include") {
+            continue;
+        }
+        rest = trim_left(rest.substr(7));
+        if (rest.empty() || (rest[0] != '"' && rest[0] != '<')) {
+            continue;
+        }
+        size_t end = rest.find(rest[0] == '"' ? '"' : '>', 1);
+        if (end == std::string_view::npos) {
+            continue;
+        }
+        // Only includes of a file of the header's name can resolve to it;
+        // the others aren't looked up on disk.
+        std::string name(rest.substr(1, end - 1));
+        if (fs::path(name).filename().string() != header_name) {
+            continue;
+        }
+        if (resolve_include(name, rest[0] == '"', directory, include_paths, header_path) == header_path) {
+            return line_offset;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// Includers in the same directory resolve the includes of their prologues
+// the same way, so only the directory is part of the hash.
+static uint64_t context_hash(const HeaderContext& context)
+{
+    std::string directory = fs::path(context.includer_path).parent_path().string();
+    std::string key = std::to_string(context.stage) + "\n" + directory + "\n";
+    for (const auto& include_path : context.include_paths) {
+        key += include_path + "\n";
+    }
+    return hash_string(key + "\n" + context.prologue);
+}
+
+static std::vector<std::string> include_paths_of(const Workspace& workspace, const std::string& uri)
+{
+    const WorkspaceFolder* folder = workspace.folder_of(uri);
+    return folder ? folder->include_paths : std::vector<std::string>();
+}
+
+std::vector<HeaderContext> choose_header_contexts(const std::string& header_uri,
+    const Workspace& workspace, size_t max_contexts)
+{
+    const std::string header_path = normalize_path(path_of(header_uri));
+
+    std::vector<HeaderContext> candidates;
+    for (const auto& [uri, document] : workspace.documents()) {
+        auto stage = find_language(uri);
+        if (!stage) {
+            continue;
+        }
+        std::string includer_path = normalize_path(path_of(uri));
+        std::vector<std::string> include_paths = include_paths_of(workspace, uri);
+        size_t include = find_include(document.text, includer_path, include_paths, header_path);
+        if (include == std::string_view::npos) {
+            continue;
+        }
+        HeaderContext context;
+        context.name = fs::path(includer_path).filename().string();
+        context.stage = *stage;
+        context.prologue = document.text.substr(0, include);
+        context.includer_path = includer_path;
+        context.include_paths = std::move(include_paths);
+        context.hash = context_hash(context);
+        candidates.push_back(std::move(context));
+    }
+
+    if (candidates.empty()) {
+        for (auto [stage, name] : { std::make_pair(EShLangVertex, "vertex"), std::make_pair(EShLangFragment, "fragment"),
+                 std::make_pair(EShLangCompute, "compute") }) {
+            HeaderContext context;
+            context.name = std::string(name) + " shader";
+            context.stage = stage;
+            context.prologue = "#version 450\n";
+            context.include_paths = include_paths_of(workspace, header_uri);
+            context.hash = context_hash(context);
+            candidates.push_back(std::move(context));
+        }
+    }
+
+    // A first includer of each stage, then includers with prologues not seen
+    // yet, in URI order.
+    std::vector<HeaderContext> chosen;
+    std::set<EShLanguage> stages;
+    std::set<uint64_t> hashes;
+    std::vector<bool> taken(candidates.size());
+    for (bool new_stages_only : { true, false }) {
+        for (size_t i = 0; i < candidates.size() && chosen.size() < max_contexts; ++i) {
+            const auto& context = candidates[i];
+            if (taken[i] || hashes.count(context.hash) || (new_stages_only && stages.count(context.stage))) {
+                continue;
+            }
+            taken[i] = true;
+            stages.insert(context.stage);
+            hashes.insert(context.hash);
+            chosen.push_back(context);
+        }
+    }
+    return chosen;
+}
+
+HeaderContextResult analyze_header_context(const std::string& header_uri, const std::string& header_text,
+    const HeaderContext& context)
+{
+    // The prologue is source string 0 and the header string 1, so that
+    // glslang reports positions in the header in its own lines.
+    const char* strings[] = { context.prologue.c_str(), header_text.c_str() };
+    const int lengths[] = { static_cast<int>(context.prologue.size()), static_cast<int>(header_text.size()) };
+
+    std::vector<std::string> search_paths = { fs::path(path_of(header_uri)).parent_path().string() };
+    if (!context.includer_path.empty()) {
+        search_paths.push_back(fs::path(context.includer_path).parent_path().string());
+    }
+    search_paths.insert(search_paths.end(), context.include_paths.begin(), context.include_paths.end());
+
+    HeaderContextResult result;
+    ensure_glslang_initialized();
+    {
+        PooledShader shader(context.stage, context.prologue.size() + header_text.size());
+        shader.setStringsWithLengths(strings, lengths, 2);
+        shader.setPreamble(include_preamble);
+        FileIncluder includer(search_paths);
+        TBuiltInResource resources = glslang::DefaultTBuiltInResource;
+        result.parsed = shader.parse(&resources, 110, false, EShMsgCascadingErrors, includer);
+        result.diagnostics = parse_info_log(shader.getInfoLog(), header_text, 1);
+    }
+    return result;
+}
+
+std::vector<Diagnostic> merge_context_diagnostics(
+    const std::vector<std::pair<std::string, const HeaderContextResult*>>& results)
+{
+    std::vector<Diagnostic> merged;
+    std::map<std::tuple<int, int, int, int, std::string>, size_t> seen;
+    for (const auto& [name, result] : results) {
+        for (const auto& diagnostic : result->diagnostics) {
+            auto key = std::make_tuple(diagnostic.line, diagnostic.start_character, diagnostic.end_character,
+                diagnostic.severity, diagnostic.message);
+            auto it = seen.find(key);
+            if (it == seen.end()) {
+                it = seen.emplace(key, merged.size()).first;
+                merged.push_back(diagnostic);
+                merged.back().contexts.clear();
+            }
+            auto& contexts = merged[it->second].contexts;
+            if (contexts.empty() || contexts.back() != name) {
+                contexts.push_back(name);
+            }
+        }
+    }
+    return merged;
+}
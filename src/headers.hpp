@@ -0,0 +1,60 @@
+#ifndef HEADERS_H
+#define HEADERS_H
+
+#include "analysis.hpp"
+#include "workspace.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Headers have no stage of their own and mean nothing outside of the shaders
+// including them, so they are analyzed in the context of includers instead:
+// the header is compiled after the text its includer has before the
+// #include, as the includer's stage.
+
+struct HeaderContext {
+    // Shown with the diagnostics reported in this context.
+    std::string name;
+    EShLanguage stage = EShLangVertex;
+
+    // The includer up to the line of its #include, and the includer's path,
+    // which includes in the prologue are resolved against.
+    std::string prologue;
+    std::string includer_path;
+
+    // Of the workspace folder of the includer, or of the header without one.
+    std::vector<std::string> include_paths;
+
+    // Of the stage, the prologue and where includes are searched: contexts
+    // with the same hash give the same results for a given header.
+    uint64_t hash = 0;
+};
+
+struct HeaderContextResult {
+    bool parsed = false;
+    std::vector<Diagnostic> diagnostics;
+};
+
+// Whether `uri` is a header (.glsl) rather than a shader of some stage.
+bool is_header(const std::string& uri);
+
+// Picks at most `max_contexts` representative contexts for the header among
+// the open documents of `workspace` including it: one per stage first, then
+// other distinct prologues. With no includer open, the header is analyzed as
+// a vertex, fragment and compute shader of version 450.
+std::vector<HeaderContext> choose_header_contexts(const std::string& header_uri,
+    const Workspace& workspace, size_t max_contexts = 4);
+
+// Compiles `header_text` in one context, on the calling thread. The
+// diagnostics are those in the header itself, in its coordinates.
+HeaderContextResult analyze_header_context(const std::string& header_uri, const std::string& header_text,
+    const HeaderContext& context);
+
+// Diagnostics equal in several contexts are reported once, with `contexts`
+// listing where they appear. `results` are paired with their context names.
+std::vector<Diagnostic> merge_context_diagnostics(
+    const std::vector<std::pair<std::string, const HeaderContextResult*>>& results);
+
+#endif /* HEADERS_H */
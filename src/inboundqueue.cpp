@@ -0,0 +1,178 @@
+#include "inboundqueue.hpp"
+#include "jsonfields.hpp"
+
+#include <initializer_list>
+
+// Handling anything costs about as much as analyzing this many bytes.
+static constexpr size_t base_cost = 1024;
+
+static const json* find_string(const json& object, std::initializer_list<const char*> path)
+{
+    const json* field = find_field(object, path);
+    return field && field->is_string() ? field : nullptr;
+}
+
+static bool is_query(const std::string& method)
+{
+    return method == "textDocument/completion" || method == "textDocument/hover"
+        || method == "textDocument/selectionRange" || method == "glslls/profileDocument";
+}
+
+static const char* admission_name(Admission admission)
+{
+    switch (admission) {
+    case Admission::Coalesce:
+        return "coalesced";
+    case Admission::ContentModified:
+        return "contentModified";
+    case Admission::ServerCancelled:
+        return "serverCancelled";
+    default:
+        return "handled";
+    }
+}
+
+InboundQueue::InboundQueue(size_t max_depth, size_t max_work, std::chrono::milliseconds max_wait)
+    : m_max_depth(max_depth)
+    , m_max_work(max_work)
+    , m_max_wait(max_wait)
+{
+}
+
+InboundQueue::~InboundQueue() {}
+
+void InboundQueue::set_overload_callback(std::function<void(bool)> callback)
+{
+    m_overload_callback = std::move(callback);
+}
+
+void InboundQueue::push(MessageBuffer message)
+{
+    Queued queued;
+    queued.received = std::chrono::steady_clock::now();
+    queued.cost = base_cost;
+    if (!message.error() && message.body().is_object()) {
+        const json& body = message.body();
+        if (const json* method = find_string(body, { "method" })) {
+            queued.method = method->get<std::string>();
+        }
+        if (const json* uri = find_string(body, { "params", "textDocument", "uri" })) {
+            queued.uri = uri->get<std::string>();
+        }
+        bool has_id = body.find("id") != body.end();
+        queued.is_change = !has_id && !queued.uri.empty()
+            && (queued.method == "textDocument/didOpen" || queued.method == "textDocument/didChange"
+                || queued.method == "textDocument/didClose");
+        queued.is_query = has_id && !queued.uri.empty() && is_query(queued.method);
+
+        // Full sync: a change holds the whole text.
+        const json* text = find_string(body, { "params", "textDocument", "text" });
+        const json* changes = find_field(body, { "params", "contentChanges" });
+        if (!text && changes && changes->is_array() && !changes->empty()) {
+            text = find_string((*changes)[0], { "text" });
+        }
+        if (text) {
+            queued.cost += text->get_ref<const std::string&>().size();
+        }
+    }
+    queued.message = std::move(message);
+
+    if (queued.is_change) {
+        ++m_changes[queued.uri];
+    }
+    if (queued.is_query) {
+        ++m_queries[queued.method + " " + queued.uri];
+    }
+    m_work += queued.cost;
+    m_messages.push_back(std::move(queued));
+    update_overload();
+}
+
+std::optional<InboundMessage> InboundQueue::pop()
+{
+    if (m_messages.empty()) {
+        return std::nullopt;
+    }
+    Queued queued = std::move(m_messages.front());
+    m_messages.pop_front();
+    m_work -= queued.cost;
+    if (queued.is_change && --m_changes[queued.uri] == 0) {
+        m_changes.erase(queued.uri);
+    }
+    std::string query_key = queued.method + " " + queued.uri;
+    if (queued.is_query && --m_queries[query_key] == 0) {
+        m_queries.erase(query_key);
+    }
+
+    // Decided on what is still queued behind the message, before the
+    // overload state is updated for its removal.
+    Admission admission = admit(queued);
+    if (admission != Admission::Handle) {
+        ++m_shed[queued.method][admission_name(admission)];
+    }
+    update_overload();
+    return InboundMessage{ std::move(queued.message), admission };
+}
+
+Admission InboundQueue::admit(const Queued& queued) const
+{
+    if (!m_overloaded) {
+        return Admission::Handle;
+    }
+    bool changes_later = m_changes.count(queued.uri) != 0;
+    if (queued.is_change && queued.method != "textDocument/didClose" && changes_later) {
+        return Admission::Coalesce;
+    }
+    if (!queued.is_query) {
+        return Admission::Handle;
+    }
+    if (changes_later) {
+        return Admission::ContentModified;
+    }
+    if (m_queries.count(queued.method + " " + queued.uri)
+        || std::chrono::steady_clock::now() - queued.received > m_max_wait) {
+        return Admission::ServerCancelled;
+    }
+    return Admission::Handle;
+}
+
+void InboundQueue::update_overload()
+{
+    bool overloaded = m_overloaded;
+    if (m_messages.size() > m_max_depth || m_work > m_max_work) {
+        overloaded = true;
+    } else if (m_messages.size() <= m_max_depth / 2 && m_work <= m_max_work / 2) {
+        overloaded = false;
+    }
+    if (overloaded != m_overloaded) {
+        m_overloaded = overloaded;
+        if (m_overload_callback) {
+            m_overload_callback(overloaded);
+        }
+    }
+}
+
+bool InboundQueue::empty() const
+{
+    return m_messages.empty();
+}
+
+size_t InboundQueue::size() const
+{
+    return m_messages.size();
+}
+
+size_t InboundQueue::queued_work() const
+{
+    return m_work;
+}
+
+bool InboundQueue::overloaded() const
+{
+    return m_overloaded;
+}
+
+const std::map<std::string, std::map<std::string, size_t>>& InboundQueue::shed_counts() const
+{
+    return m_shed;
+}
@@ -0,0 +1,98 @@
+#ifndef INBOUNDQUEUE_H
+#define INBOUNDQUEUE_H
+
+#include "messagebuffer.hpp"
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+
+// What to do with a message taken off the InboundQueue.
+enum class Admission {
+    Handle,
+    // A document change superseded by a later one for the same document:
+    // apply it, but leave the diagnostics to the later one.
+    Coalesce,
+    // A request about a document changed since: reply ContentModified.
+    ContentModified,
+    // A request superseded by a later one of the same kind, or that waited
+    // too long: reply ServerCancelled.
+    ServerCancelled,
+};
+
+struct InboundMessage {
+    MessageBuffer message;
+    Admission admission = Admission::Handle;
+};
+
+// Messages read from the client but not handled yet, and admission control
+// over them.
+//
+// Every message has an estimated cost: the size of the text to analyze for
+// document changes, a fixed amount for everything else. The queue is
+// overloaded while it holds more than `max_depth` messages or more than
+// `max_work` of cost, and stays so until both fall to half of that. While
+// overloaded, pop() sheds work: document changes followed by another change
+// to the same document are coalesced, and queries (completion, hover,
+// selection ranges, profiles) are cancelled when the document changes later
+// in the queue, when the same query for the same document follows, or when
+// they waited longer than `max_wait`.
+class InboundQueue
+{
+
+public:
+    InboundQueue(size_t max_depth = 32, size_t max_work = 2 << 20,
+        std::chrono::milliseconds max_wait = std::chrono::milliseconds(1000));
+    virtual ~InboundQueue();
+
+    // Called with true when the queue becomes overloaded and with false once
+    // it isn't anymore.
+    void set_overload_callback(std::function<void(bool)> callback);
+
+    void push(MessageBuffer message);
+    std::optional<InboundMessage> pop();
+
+    bool empty() const;
+    size_t size() const;
+    size_t queued_work() const;
+    bool overloaded() const;
+
+    // Shed messages by method, then by Admission ("coalesced",
+    // "contentModified" or "serverCancelled").
+    const std::map<std::string, std::map<std::string, size_t>>& shed_counts() const;
+
+private:
+    struct Queued {
+        MessageBuffer message;
+        std::string method;
+        std::string uri;
+        bool is_change = false;
+        bool is_query = false;
+        size_t cost = 0;
+        std::chrono::steady_clock::time_point received;
+    };
+
+    Admission admit(const Queued& queued) const;
+    void update_overload();
+
+    size_t m_max_depth;
+    size_t m_max_work;
+    std::chrono::milliseconds m_max_wait;
+    std::function<void(bool)> m_overload_callback;
+    bool m_overloaded = false;
+
+    std::deque<Queued> m_messages;
+    size_t m_work = 0;
+
+    // Of the queued messages: changes by document, and queries by method
+    // and document.
+    std::map<std::string, size_t> m_changes;
+    std::map<std::string, size_t> m_queries;
+
+    std::map<std::string, std::map<std::string, size_t>> m_shed;
+};
+
+#endif /* INBOUNDQUEUE_H */
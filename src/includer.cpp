@@ -0,0 +1,53 @@
+#include "includer.hpp"
+
+#include <experimental/filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace fs = std::experimental::filesystem;
+
+FileIncluder::FileIncluder(std::vector<std::string> search_paths)
+    : m_search_paths(std::move(search_paths))
+{
+}
+
+FileIncluder::~FileIncluder() {}
+
+glslang::TShader::Includer::IncludeResult* FileIncluder::includeLocal(
+    const char* header_name, const char* includer_name, size_t depth)
+{
+    auto path = fs::path(includer_name).parent_path() / header_name;
+    if (auto result = open(path.string())) {
+        return result;
+    }
+    return includeSystem(header_name, includer_name, depth);
+}
+
+glslang::TShader::Includer::IncludeResult* FileIncluder::includeSystem(
+    const char* header_name, const char*, size_t)
+{
+    for (const auto& search_path : m_search_paths) {
+        if (auto result = open((fs::path(search_path) / header_name).string())) {
+            return result;
+        }
+    }
+    return nullptr;
+}
+
+void FileIncluder::releaseInclude(IncludeResult* result)
+{
+    if (result) {
+        delete static_cast<std::string*>(result->userData);
+        delete result;
+    }
+}
+
+glslang::TShader::Includer::IncludeResult* FileIncluder::open(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return nullptr;
+    }
+    auto content = new std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return new IncludeResult(path, content->data(), content->size(), content);
+}
@@ -0,0 +1,34 @@
+#ifndef INCLUDER_H
+#define INCLUDER_H
+
+#include "ShaderLang.h"
+
+#include <string>
+#include <vector>
+
+// glslang only processes includes with the extension enabled, whether or not
+// the document enables it. Used as the preamble of shaders parsed with an
+// includer.
+constexpr const char* include_preamble = "#extension GL_GOOGLE_include_directive : enable\n";
+
+// Resolves #include directives (GL_GOOGLE_include_directive) from the file
+// system: "local" includes relative to the including file first, then, like
+// <system> includes, in each search path in order.
+class FileIncluder : public glslang::TShader::Includer
+{
+
+public:
+    explicit FileIncluder(std::vector<std::string> search_paths = {});
+    ~FileIncluder() override;
+
+    IncludeResult* includeLocal(const char* header_name, const char* includer_name, size_t depth) override;
+    IncludeResult* includeSystem(const char* header_name, const char* includer_name, size_t depth) override;
+    void releaseInclude(IncludeResult* result) override;
+
+private:
+    IncludeResult* open(const std::string& path);
+
+    std::vector<std::string> m_search_paths;
+};
+
+#endif /* INCLUDER_H */
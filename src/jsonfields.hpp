@@ -0,0 +1,79 @@
+#ifndef JSONFIELDS_H
+#define JSONFIELDS_H
+
+#include "expected.hpp"
+
+#include "nlohmann/json.hpp"
+
+#include <initializer_list>
+#include <limits>
+#include <string>
+
+using json = nlohmann::json;
+
+// Message fields are looked up without exceptions: a missing field or one
+// of the wrong type is an error, reported to the client.
+
+// Whether `value` is an integer that fits an int. get<int>() would silently
+// truncate larger ones, and wrap unsigned ones.
+inline bool is_int(const json& value)
+{
+    if (value.is_number_unsigned()) {
+        return value.get<uint64_t>() <= uint64_t(std::numeric_limits<int>::max());
+    }
+    return value.is_number_integer() && value.get<int64_t>() >= std::numeric_limits<int>::min()
+        && value.get<int64_t>() <= std::numeric_limits<int>::max();
+}
+
+// The field at `path`, a key per level of nested objects, or nullptr.
+inline const json* find_field(const json& object, std::initializer_list<const char*> path)
+{
+    const json* current = &object;
+    for (const char* key : path) {
+        if (!current->is_object()) {
+            return nullptr;
+        }
+        auto it = current->find(key);
+        if (it == current->end()) {
+            return nullptr;
+        }
+        current = &*it;
+    }
+    return current;
+}
+
+// The path as written in error messages: "params.textDocument.uri".
+inline std::string field_name(std::initializer_list<const char*> path)
+{
+    std::string name;
+    for (const char* key : path) {
+        name += name.empty() ? key : std::string(".") + key;
+    }
+    return name;
+}
+
+inline Expected<std::string> string_field(const json& object, std::initializer_list<const char*> path)
+{
+    const json* field = find_field(object, path);
+    if (!field || !field->is_string()) {
+        return Error{ ErrorCode::InvalidParams, "Expected a string as " + field_name(path) };
+    }
+    return field->get_ref<const std::string&>();
+}
+
+inline Expected<int> int_field(const json& object, std::initializer_list<const char*> path)
+{
+    const json* field = find_field(object, path);
+    if (!field || !is_int(*field)) {
+        return Error{ ErrorCode::InvalidParams, "Expected an integer as " + field_name(path) };
+    }
+    return field->get<int>();
+}
+
+inline int int_field_or(const json& object, std::initializer_list<const char*> path, int fallback)
+{
+    auto value = int_field(object, path);
+    return value ? *value : fallback;
+}
+
+#endif /* JSONFIELDS_H */
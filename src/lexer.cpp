@@ -0,0 +1,348 @@
+#include "lexer.hpp"
+#include "scheduler.hpp"
+#include "text.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+
+// Documents smaller than this are lexed serially; below it, handing chunks
+// to other threads costs more than it saves.
+static const size_t parallel_threshold = 1 << 20;
+static const size_t min_chunk_size = 256 << 10;
+
+static const char* const punctuators[] = {
+    "<<=", ">>=",
+    "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||", "^^",
+    "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "##",
+};
+
+namespace {
+
+// What the lexer is in the middle of at the start of a line.
+enum class LexState : uint8_t {
+    Normal,
+    BlockComment,
+    // A // comment whose previous line ended with a backslash.
+    LineComment,
+};
+
+// Backslashes count as whitespace: outside of comments, all they can do is
+// continue a line.
+bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v' || c == '\\';
+}
+
+class Scanner
+{
+
+public:
+    Scanner(std::string_view text, size_t begin, LexState state, std::vector<Token>& tokens)
+        : m_text(text)
+        , m_pos(begin)
+        , m_line_start(begin)
+        , m_state(state)
+        , m_tokens(tokens)
+    {
+    }
+
+    size_t pos() const { return m_pos; }
+    uint32_t line() const { return m_line; }
+    LexState state() const { return m_state; }
+
+    // Lexes up to and including the next newline.
+    void lex_line(size_t end)
+    {
+        size_t line_end = m_text.find('\n', m_pos);
+        if (line_end == std::string_view::npos || line_end >= end) {
+            line_end = end;
+        }
+
+        while (m_pos < line_end) {
+            if (m_state == LexState::BlockComment) {
+                size_t close = line_view(line_end).find("*/");
+                if (close == std::string_view::npos) {
+                    m_pos = line_end;
+                    break;
+                }
+                m_pos += close + 2;
+                m_state = LexState::Normal;
+            } else if (m_state == LexState::LineComment) {
+                m_state = continues(line_end) ? LexState::LineComment : LexState::Normal;
+                m_pos = line_end;
+            } else {
+                lex_token(line_end);
+            }
+        }
+
+        if (m_pos < end) {
+            // Skip the newline itself.
+            ++m_pos;
+            ++m_line;
+            m_line_start = m_pos;
+        }
+    }
+
+private:
+    // The rest of the current line, so searches never run past it.
+    std::string_view line_view(size_t line_end) const
+    {
+        return m_text.substr(m_pos, line_end - m_pos);
+    }
+
+    // Whether the line ending at `line_end` ends with a backslash.
+    bool continues(size_t line_end) const
+    {
+        size_t last = line_end;
+        while (last > m_line_start && m_text[last - 1] == '\r') {
+            --last;
+        }
+        return last > m_line_start && m_text[last - 1] == '\\';
+    }
+
+    void lex_token(size_t line_end)
+    {
+        char c = m_text[m_pos];
+        char next = m_pos + 1 < line_end ? m_text[m_pos + 1] : '\0';
+
+        if (is_space(c)) {
+            // A stray backslash can only be a line continuation, which is
+            // whitespace between tokens.
+            while (m_pos < line_end && is_space(m_text[m_pos])) {
+                ++m_pos;
+            }
+        } else if (c == '/' && next == '*') {
+            m_state = LexState::BlockComment;
+            m_pos += 2;
+        } else if (c == '/' && next == '/') {
+            m_state = continues(line_end) ? LexState::LineComment : LexState::Normal;
+            m_pos = line_end;
+        } else if (is_identifier_start(c)) {
+            size_t end = m_pos + 1;
+            while (end < line_end && is_identifier_char(m_text[end])) {
+                ++end;
+            }
+            push(TokenKind::Identifier, end);
+        } else if (is_digit(c) || (c == '.' && is_digit(next))) {
+            size_t end = m_pos + 1;
+            bool hex = c == '0' && (next == 'x' || next == 'X');
+            while (end < line_end) {
+                char d = m_text[end];
+                char prev = m_text[end - 1];
+                if (is_identifier_char(d) || d == '.'
+                    || (!hex && (d == '+' || d == '-') && (prev == 'e' || prev == 'E'))) {
+                    ++end;
+                } else {
+                    break;
+                }
+            }
+            push(TokenKind::Number, end);
+        } else if (c == '"') {
+            size_t end = line_view(line_end).find('"', 1);
+            end = end == std::string_view::npos ? line_end : m_pos + end + 1;
+            push(TokenKind::String, end);
+        } else {
+            size_t length = 1;
+            for (const char* punctuator : punctuators) {
+                size_t n = std::char_traits<char>::length(punctuator);
+                if (n > length && m_pos + n <= line_end && m_text.compare(m_pos, n, punctuator) == 0) {
+                    length = n;
+                    break;
+                }
+            }
+            push(TokenKind::Punctuation, m_pos + length);
+        }
+    }
+
+    void push(TokenKind kind, size_t end)
+    {
+        Token token;
+        token.kind = kind;
+        token.offset = static_cast<uint32_t>(m_pos);
+        token.length = static_cast<uint32_t>(end - m_pos);
+        token.line = m_line;
+        token.character = static_cast<uint32_t>(m_pos - m_line_start);
+        m_tokens.push_back(token);
+        m_pos = end;
+    }
+
+    std::string_view m_text;
+    size_t m_pos;
+    size_t m_line_start;
+    uint32_t m_line = 0;
+    LexState m_state;
+    std::vector<Token>& m_tokens;
+};
+
+struct Chunk {
+    size_t begin = 0;
+    size_t end = 0;
+
+    // Token lines are relative to the start of the chunk until merged.
+    std::vector<Token> tokens;
+    uint32_t lines = 0;
+    LexState exit_state = LexState::Normal;
+
+    // Offsets of the line starts the speculative lexing entered in something
+    // other than LexState::Normal, in order.
+    std::vector<uint32_t> unsettled_lines;
+
+    // Filled in by the reconciliation.
+    size_t output_offset = 0;
+    uint32_t base_line = 0;
+};
+
+void lex_speculatively(std::string_view text, Chunk& chunk)
+{
+    Scanner scanner(text, chunk.begin, LexState::Normal, chunk.tokens);
+    while (scanner.pos() < chunk.end) {
+        scanner.lex_line(chunk.end);
+        if (scanner.state() != LexState::Normal && scanner.pos() < chunk.end) {
+            chunk.unsettled_lines.push_back(static_cast<uint32_t>(scanner.pos()));
+        }
+    }
+    chunk.lines = scanner.line();
+    chunk.exit_state = scanner.state();
+}
+
+// Relexes a chunk that really starts in `state` until it reaches a line both
+// lexings start in LexState::Normal; from there on the speculative tokens
+// are right. Returns the state the chunk really ends in.
+LexState reconcile(std::string_view text, Chunk& chunk, LexState state)
+{
+    std::vector<Token> relexed;
+    Scanner scanner(text, chunk.begin, state, relexed);
+    while (scanner.pos() < chunk.end) {
+        scanner.lex_line(chunk.end);
+        size_t line_start = scanner.pos();
+        if (line_start < chunk.end && scanner.state() == LexState::Normal
+            && !std::binary_search(chunk.unsettled_lines.begin(), chunk.unsettled_lines.end(), line_start)) {
+            auto synced = std::lower_bound(chunk.tokens.begin(), chunk.tokens.end(), line_start,
+                [](const Token& token, size_t offset) { return token.offset < offset; });
+            chunk.tokens.erase(chunk.tokens.begin(), synced);
+            chunk.tokens.insert(chunk.tokens.begin(), relexed.begin(), relexed.end());
+            return chunk.exit_state;
+        }
+    }
+    chunk.tokens = std::move(relexed);
+    return scanner.state();
+}
+
+// Chunks run on a pool shared by all callers: documents are lexed on
+// scheduler workers, and a thread per chunk on each of them would oversubscribe
+// the machine.
+Scheduler& helper_pool()
+{
+    static Scheduler pool;
+    return pool;
+}
+
+// A chunk runs on whichever thread claims it first: a helper, or the caller,
+// which runs those still queued itself. So waiting never deadlocks, and a busy
+// pool only means the caller does more of the work.
+struct ChunkJob {
+    std::atomic<bool> claimed{ false };
+    std::promise<void> done;
+};
+
+template <typename F>
+void for_each_parallel(size_t count, F f)
+{
+    std::vector<std::shared_ptr<ChunkJob>> jobs;
+    for (size_t i = 1; i < count; ++i) {
+        auto job = std::make_shared<ChunkJob>();
+        jobs.push_back(job);
+        helper_pool().submit(Scheduler::Priority::Interactive, [job, &f, i]() {
+            if (!job->claimed.exchange(true)) {
+                f(i);
+                job->done.set_value();
+            }
+        });
+    }
+    if (count > 0) {
+        f(0);
+    }
+    for (size_t i = 1; i < count; ++i) {
+        auto& job = jobs[i - 1];
+        if (!job->claimed.exchange(true)) {
+            f(i);
+        } else {
+            job->done.get_future().wait();
+        }
+    }
+}
+
+}
+
+std::vector<Token> lex(std::string_view text)
+{
+    std::vector<Token> tokens;
+    tokens.reserve(text.size() / 8);
+    Scanner scanner(text, 0, LexState::Normal, tokens);
+    while (scanner.pos() < text.size()) {
+        scanner.lex_line(text.size());
+    }
+    return tokens;
+}
+
+std::vector<Token> lex_parallel(std::string_view text, unsigned num_chunks)
+{
+    if (num_chunks <= 1 || text.empty()) {
+        return lex(text);
+    }
+
+    std::vector<Chunk> chunks;
+    size_t begin = 0;
+    for (unsigned i = 1; i <= num_chunks && begin < text.size(); ++i) {
+        size_t end = text.size();
+        if (i < num_chunks) {
+            end = text.find('\n', std::max(begin, text.size() / num_chunks * i));
+            end = end == std::string_view::npos ? text.size() : end + 1;
+        }
+        Chunk chunk;
+        chunk.begin = begin;
+        chunk.end = end;
+        chunks.push_back(std::move(chunk));
+        begin = end;
+    }
+
+    for_each_parallel(chunks.size(), [&](size_t i) {
+        chunks[i].tokens.reserve((chunks[i].end - chunks[i].begin) / 8);
+        lex_speculatively(text, chunks[i]);
+    });
+
+    LexState state = LexState::Normal;
+    size_t total_tokens = 0;
+    uint32_t total_lines = 0;
+    for (auto& chunk : chunks) {
+        state = state == LexState::Normal ? chunk.exit_state : reconcile(text, chunk, state);
+        chunk.output_offset = total_tokens;
+        chunk.base_line = total_lines;
+        total_tokens += chunk.tokens.size();
+        total_lines += chunk.lines;
+    }
+
+    std::vector<Token> tokens(total_tokens);
+    for_each_parallel(chunks.size(), [&](size_t i) {
+        const Chunk& chunk = chunks[i];
+        auto out = tokens.begin() + chunk.output_offset;
+        for (Token token : chunk.tokens) {
+            token.line += chunk.base_line;
+            *out++ = token;
+        }
+    });
+    return tokens;
+}
+
+std::vector<Token> lex_document(std::string_view text)
+{
+    if (text.size() < parallel_threshold) {
+        return lex(text);
+    }
+    size_t max_chunks = text.size() / min_chunk_size;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    return lex_parallel(text, static_cast<unsigned>(std::min<size_t>(threads, max_chunks)));
+}
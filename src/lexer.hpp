@@ -0,0 +1,50 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A lexer for GLSL source that is cheap enough to run on every document,
+// independently of glslang. Comments and whitespace are dropped; preprocessor
+// directives are lexed like any other line, starting with a "#" token.
+//
+// All positions are 0-based, as in the LSP specification.
+
+enum class TokenKind : uint8_t {
+    Identifier,
+    Number,
+    Punctuation,
+    String,
+};
+
+struct Token {
+    TokenKind kind = TokenKind::Identifier;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+    uint32_t line = 0;
+    uint32_t character = 0;
+};
+
+inline std::string_view token_text(std::string_view text, const Token& token)
+{
+    return text.substr(token.offset, token.length);
+}
+
+std::vector<Token> lex(std::string_view text);
+
+// Splits the text at line boundaries into `num_chunks` chunks and lexes them
+// in parallel on a helper pool shared by all callers, each as if it started
+// outside of any comment. Chunks that
+// actually start inside a block comment or a continued line comment are then
+// relexed up to the first line where both lexings agree. The result is
+// identical to lex().
+std::vector<Token> lex_parallel(std::string_view text, unsigned num_chunks);
+
+// lex() for small documents, lex_parallel() with one chunk per hardware
+// thread for large ones.
+std::vector<Token> lex_document(std::string_view text);
+
+#endif /* LEXER_H */
@@ -0,0 +1,111 @@
+#include "logger.hpp"
+
+AsyncLogger::Buffer::Buffer(AsyncLogger& logger)
+    : m_logger(logger)
+{
+}
+
+int AsyncLogger::Buffer::sync()
+{
+    if (pbase() != pptr()) {
+        m_logger.post(str());
+        str(std::string());
+    }
+    return 0;
+}
+
+AsyncLogger::AsyncLogger(size_t max_queued_bytes)
+    : std::ostream(nullptr)
+    , m_buffer(*this)
+    , m_max_queued_bytes(max_queued_bytes)
+{
+    rdbuf(&m_buffer);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_queued.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool AsyncLogger::open(const std::string& path)
+{
+    if (m_thread.joinable()) {
+        return false;
+    }
+    m_file.open(path);
+    if (!m_file) {
+        return false;
+    }
+    m_thread = std::thread([this]() { run(); });
+    return true;
+}
+
+bool AsyncLogger::is_open() const
+{
+    return m_thread.joinable();
+}
+
+void AsyncLogger::post(std::string text)
+{
+    if (text.empty() || !is_open()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queued_bytes + text.size() > m_max_queued_bytes) {
+            m_dropped_bytes += text.size();
+            return;
+        }
+        m_queued_bytes += text.size();
+        m_queue.push_back(std::move(text));
+    }
+    m_queued.notify_one();
+}
+
+void AsyncLogger::drain()
+{
+    flush();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_written.wait(lock, [this]() { return m_queue.empty() && !m_writing; });
+}
+
+size_t AsyncLogger::dropped_bytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped_bytes;
+}
+
+// Takes the whole queue at a time, writing it without the lock held.
+void AsyncLogger::run()
+{
+    std::vector<std::string> batch;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_queued.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+        if (m_queue.empty()) {
+            return;
+        }
+        batch.swap(m_queue);
+        m_queued_bytes = 0;
+        m_writing = true;
+        lock.unlock();
+
+        for (const auto& text : batch) {
+            m_file << text;
+        }
+        m_file.flush();
+        batch.clear();
+
+        lock.lock();
+        m_writing = false;
+        m_written.notify_all();
+    }
+}
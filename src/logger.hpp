@@ -0,0 +1,74 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The log file, written by a thread of its own so that logging never blocks
+// the I/O loop on the disk.
+//
+// As an ostream it is meant for one thread, the I/O loop: what is written
+// collects in memory until flush() hands it to the writer. Other threads use
+// post(). The writer drops text instead of queueing more than
+// `max_queued_bytes`, so a slow disk costs log lines and not memory.
+class AsyncLogger : public std::ostream
+{
+
+public:
+    explicit AsyncLogger(size_t max_queued_bytes = 8 << 20);
+    ~AsyncLogger() override;
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    // Until a file is opened, everything logged is discarded.
+    bool open(const std::string& path);
+    bool is_open() const;
+
+    // Queues `text` for writing. Thread safe.
+    void post(std::string text);
+
+    // Blocks until everything queued so far is written.
+    void drain();
+
+    size_t dropped_bytes() const;
+
+private:
+    class Buffer : public std::stringbuf
+    {
+
+    public:
+        explicit Buffer(AsyncLogger& logger);
+
+    protected:
+        int sync() override;
+
+    private:
+        AsyncLogger& m_logger;
+    };
+
+    void run();
+
+    Buffer m_buffer;
+    std::ofstream m_file;
+    std::thread m_thread;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_queued;
+    std::condition_variable m_written;
+    std::vector<std::string> m_queue;
+    size_t m_queued_bytes = 0;
+    size_t m_max_queued_bytes;
+    size_t m_dropped_bytes = 0;
+    bool m_writing = false;
+    bool m_stopping = false;
+};
+
+#endif /* LOGGER_H */
@@ -3,348 +3,28 @@
 #include "fmt/format.h"
 #include "fmt/ostream.h"
 
-#include "nlohmann/json.hpp"
-
 #include "mongoose.h"
 
-#include "ResourceLimits.h"
-#include "ShaderLang.h"
-#include "glslang/MachineIndependent/localintermediate.h"
-#include "glslang/Include/intermediate.h"
-
+#include <cerrno>
 #include <cstdint>
-#include <experimental/filesystem>
+#include <cstdio>
 #include <fstream>
-#include <optional>
-#include <regex>
+#include <iostream>
+#include <iterator>
 #include <string>
-#include <vector>
-
-#include "messagebuffer.hpp"
-#include "workspace.hpp"
-#include "utils.hpp"
-
-using json = nlohmann::json;
-namespace fs = std::experimental::filesystem;
-
-struct AppState {
-    Workspace workspace;
-    bool verbose;
-    bool use_logfile;
-    std::ofstream logfile_stream;
-};
-
-std::string make_response(const json& response)
-{
-    json content = response;
-    content["jsonrpc"] = "2.0";
-
-    std::string header;
-    header.append("Content-Length: " + std::to_string(content.dump(4).size()) + "\r\n");
-    header.append("Content-Type: application/vscode-jsonrpc;charset=utf-8\r\n");
-    header.append("\r\n");
-    return header + content.dump(4);
-}
-
-EShLanguage find_language(const std::string& name)
-{
-    auto ext = fs::path(name).extension();
-    if (ext == ".vert")
-        return EShLangVertex;
-    else if (ext == ".tesc")
-        return EShLangTessControl;
-    else if (ext == ".tese")
-        return EShLangTessEvaluation;
-    else if (ext == ".geom")
-        return EShLangGeometry;
-    else if (ext == ".frag")
-        return EShLangFragment;
-    else if (ext == ".comp")
-        return EShLangCompute;
-    throw std::invalid_argument("Unknown file extension!");
-}
-
-json get_diagnostics(std::string uri, std::string content,
-        AppState& appstate)
-{
-    FILE fp_old = *stdout;
-    *stdout = *fopen("/dev/null","w");
-    auto document = uri;
-    auto shader_cstring = content.c_str();
-    auto lang = find_language(document);
-    glslang::InitializeProcess();
-    glslang::TShader shader(lang);
-    shader.setStrings(&shader_cstring, 1);
-    TBuiltInResource Resources = glslang::DefaultTBuiltInResource;
-    EShMessages messages = EShMsgCascadingErrors;
-    shader.parse(&Resources, 110, false, messages);
-    std::string debug_log = shader.getInfoLog();
-
-    // ACA SE PUEDE IMPLEMENTAR LA AYUDA CONTEXTUAL!!
-    // shader.getIntermediate()->getTreeRoot()
-
-    glslang::FinalizeProcess();
-    *stdout = fp_old;
-
-    if (appstate.use_logfile && appstate.verbose) {
-        fmt::print(appstate.logfile_stream, "Diagnostics raw output: {}\n" , debug_log);
-    }
-
-    std::regex re("(.*): 0:(\\d*): (.*)");
-    std::smatch matches;
-    auto error_lines = split_string(debug_log, "\n");
-    auto content_lines = split_string(content, "\n");
-
-    json diagnostics;
-    for (auto error_line : error_lines) {
-        std::regex_search(error_line, matches, re);
-        if (matches.size() == 4) {
-            json diagnostic;
-            std::string severity = matches[1];
-            int severity_no = -1;
-            if (severity == "ERROR") {
-                severity_no = 1;
-            } else if (severity == "WARNING") {
-                severity_no = 2;
-            }
-            if (severity_no == -1) {
-                if (appstate.use_logfile) {
-                    fmt::print(appstate.logfile_stream, "Error: Unknown severity '{}'\n", severity);
-                }
-            }
-            std::string message = trim(matches[3], " ");
-
-            // -1 because lines are 0-indexed as per LSP specification.
-            int line_no = std::stoi(matches[2]) - 1;
-            std::string source_line = content_lines[line_no];
-
-            int start_char = -1;
-            int end_char = -1;
-
-            // If this is an undeclared identifier, we can find the exact
-            // position of the broken identifier.
-            std::smatch message_matches;
-            std::regex re("'(.*)' : (.*)");
-            std::regex_search(message, message_matches, re);
-            if (message_matches.size() == 3) {
-                std::string identifier = message_matches[1];
-                int identifier_length = message_matches[1].length();
-                auto source_pos = source_line.find(identifier);
-                start_char = source_pos;
-                end_char = source_pos + identifier_length - 1;
-            } else {
-                // If we can't find a precise position, we'll just use the whole line.
-                start_char = 0;
-                end_char = source_line.length();
-            }
-
-            json range{
-                {"start", {
-                    { "line", line_no },
-                    { "character", start_char },
-                }},
-                { "end", {
-                    { "line", line_no },
-                    { "character", end_char },
-                }},
-            };
-            diagnostic["range"] = range;
-            diagnostic["severity"] = severity_no;
-            diagnostic["source"] = "glslang";
-            diagnostic["message"] = message;
-            diagnostics.push_back(diagnostic);
-        }
-    }
-    if (appstate.use_logfile && appstate.verbose) {
-        fmt::print(appstate.logfile_stream, "Sending diagnostics: {}\n" , diagnostics);
-    }
-    appstate.logfile_stream.flush();
-    return diagnostics;
-}
 
-std::optional<std::string> handle_message(const MessageBuffer& message_buffer, AppState& appstate)
-{
-    json body = message_buffer.body();
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 
-    if (body["method"] == "initialized") {
-        return std::nullopt;
-    }
-
-    if (body["method"] == "initialize") {
-        appstate.workspace.set_initialized(true);
-
-        json text_document_sync{
-            { "openClose", true },
-            { "change", 1 }, // Full sync
-            { "willSave", false },
-            { "willSaveWaitUntil", false },
-            { "save", { { "includeText", false } } },
-        };
-
-        json completion_provider{
-            { "resolveProvider", false },
-            { "triggerCharacters", {} },
-        };
-        json signature_help_provider{
-            { "triggerCharacters", "" }
-        };
-        json code_lens_provider{
-            { "resolveProvider", false }
-        };
-        json document_on_type_formatting_provider{
-            { "firstTriggerCharacter", "" },
-            { "moreTriggerCharacter", "" },
-        };
-        json document_link_provider{
-            { "resolveProvider", false }
-        };
-        json execute_command_provider{
-            { "commands", {} }
-        };
-        json result{
-            {
-                "capabilities",
-                {
-                { "textDocumentSync", text_document_sync },
-                { "hoverProvider", false },
-                { "completionProvider", completion_provider },
-                { "signatureHelpProvider", signature_help_provider },
-                { "definitionProvider", false },
-                { "referencesProvider", false },
-                { "documentHighlightProvider", false },
-                { "documentSymbolProvider", false },
-                { "workspaceSymbolProvider", false },
-                { "codeActionProvider", false },
-                { "codeLensProvider", code_lens_provider },
-                { "documentFormattingProvider", false },
-                { "documentRangeFormattingProvider", false },
-                { "documentOnTypeFormattingProvider", document_on_type_formatting_provider },
-                { "renameProvider", false },
-                { "documentLinkProvider", document_link_provider },
-                { "executeCommandProvider", execute_command_provider },
-                { "experimental", {} }, }
-            }
-        };
-
-        json result_body{
-            { "id", body["id"] },
-            { "result", result }
-        };
-        return make_response(result_body);
-    } else if (body["method"] == "textDocument/didOpen") {
-        auto uri = body["params"]["textDocument"]["uri"];
-        auto text = body["params"]["textDocument"]["text"];
-        appstate.workspace.add_document(uri, text);
-
-        json diagnostics = get_diagnostics(uri, text, appstate);
-        if (diagnostics.empty()) {
-            diagnostics = json::array();
-        }
-        json result_body{
-            { "method", "textDocument/publishDiagnostics" },
-            { "params", {
-                            { "uri", uri },
-                            { "diagnostics", diagnostics },
-                        } }
-        };
-        return make_response(result_body);
-    } else if (body["method"] == "textDocument/didChange") {
-        auto uri = body["params"]["textDocument"]["uri"];
-        auto change = body["params"]["contentChanges"][0]["text"];
-        appstate.workspace.change_document(uri, change);
-
-        std::string document = appstate.workspace.documents()[uri];
-        json diagnostics = get_diagnostics(uri, document, appstate);
-        if (diagnostics.empty()) {
-            diagnostics = json::array();
-        }
-        json result_body{
-            { "method", "textDocument/publishDiagnostics" },
-            { "params", {
-                            { "uri", uri },
-                            { "diagnostics", diagnostics },
-                        } }
-        };
-        return make_response(result_body);
-    }
-
-    // If the workspace has not yet been initialized but the client sends a
-    // message that doesn't have method "initialize" then we'll return an error
-    // as per LSP spec.
-    if (body["method"] != "initialize" && !appstate.workspace.is_initialized()) {
-        json error{
-            { "code", -32002 },
-            { "message", "Server not yet initialized." },
-        };
-        json result_body{
-            { "error", error }
-        };
-        return make_response(result_body);
-    }
-
-    // If we don't know the method requested, we end up here.
-    if (body.count("method") == 1) {
-        json error{
-            { "code", -32601 },
-            { "message", fmt::format("Method '{}' not supported.", body["method"].get<std::string>()) },
-        };
-        json result_body{
-            { "error", error }
-        };
-        return make_response(result_body);
-    }
-
-    // If we couldn't parse anything we end up here.
-    json error{
-        { "code", -32700 },
-        { "message", "Couldn't parse message." },
-    };
-    json result_body{
-        { "error", error }
-    };
-    return make_response(result_body);
-}
-
-void ev_handler(struct mg_connection* c, int ev, void* p) {
-    AppState& appstate = *static_cast<AppState*>(c->mgr->user_data);
-
-    if (ev == MG_EV_HTTP_REQUEST) {
-        struct http_message* hm = (struct http_message*)p;
-
-        std::string content = hm->message.p;
-
-        MessageBuffer message_buffer;
-        message_buffer.handle_string(content);
-
-        if (message_buffer.message_completed()) {
-            json body = message_buffer.body();
-            if (appstate.use_logfile) {
-                fmt::print(appstate.logfile_stream, ">>> Received message of type '{}'\n", body["method"].get<std::string>());
-                if (appstate.verbose) {
-                    fmt::print(appstate.logfile_stream, "Headers:\n");
-                    for (auto elem : message_buffer.headers()) {
-                        auto pretty_header = fmt::format("{}: {}\n", elem.first, elem.second);
-                        appstate.logfile_stream << pretty_header;
-                    }
-                    fmt::print(appstate.logfile_stream, "Body: \n{}\n\n", body.dump(4));
-                    fmt::print(appstate.logfile_stream, "Raw: \n{}\n\n", message_buffer.raw());
-                }
-            }
-
-            auto message = handle_message(message_buffer, appstate);
-            if (message.has_value()) {
-                std::string response = message.value();
-                mg_send_head(c, 200, response.length(), "Content-Type: text/plain");
-                mg_printf(c, "%.*s", static_cast<int>(response.length()), response.c_str());
-                if (appstate.use_logfile && appstate.verbose) {
-                    fmt::print(appstate.logfile_stream, "<<< Sending message: \n{}\n\n", message.value());
-                }
-            }
-            appstate.logfile_stream.flush();
-            message_buffer.clear();
-        }
-    }
-}
+#include "allocator.hpp"
+#include "core.hpp"
+#include "messagebuffer.hpp"
+#include "profiler.hpp"
+#include "server.hpp"
+#ifdef GLSLLS_HAS_SHM
+#include "shmtransport.hpp"
+#endif
 
 const std::string document = "shader.vert";
 const std::string content = R"(
@@ -373,110 +53,276 @@ void main() {
 }
 )";
 
+// Looks up the symbol at a fixed position of the sample shader above.
+int run_demo()
+{
+    Core core(1);
+    core.open_document(document, content);
 
-class FindSymbolTraverser : public glslang::TIntermTraverser {
-public:
-    FindSymbolTraverser(const int line, const int column) {
-        this->line = line;
-        this->column = column;
+    const auto symbol = core.symbol_at(document, 18, 12);
+    if (symbol) {
+        std::cout
+            << symbol->line + 1 << ":" << symbol->character + 1 << " -> "
+            << symbol->name << ":" << symbol->type
+            << std::endl;
+    } else {
+        std::cout << "no symbol located!";
     }
+    return 0;
+}
 
-    glslang::TIntermSymbol* getSymbol() const {
-        return symbol;
+// Prints where glslang spends its time on `path`, and writes a trace of it
+// if `trace_path` is set.
+int run_profile(const std::string& path, const std::string& trace_path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        fmt::print(stderr, "Can't read {}\n", path);
+        return 1;
     }
+    std::string text{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
 
-private:
-    int line, column;
-    glslang::TIntermSymbol* symbol = nullptr;
-
-private:
-    void visitSymbol(glslang::TIntermSymbol* interm) override {
-        std::cout << "visitSymbol " << interm->getLoc().line << ":" << interm->getLoc().column << ", " << interm->getName() << std::endl;
-
-        const auto loc = interm->getLoc();
-        const auto name = interm->getName();
-
-        if (line == loc.line) {
-            const auto start = loc.column;
-            const auto end = loc.column + name.size();
-
-            if (column >= start && column <= end) {
-                symbol = interm;
-            }
+    auto profile = profile_document(path, text);
+    if (!profile) {
+        fmt::print(stderr, "{}\n", profile.error().message);
+        return 1;
+    }
+    std::cout << profile_report(*profile);
+
+    if (!trace_path.empty()) {
+        std::ofstream trace(trace_path);
+        trace << profile_trace(*profile).dump();
+        if (!trace) {
+            fmt::print(stderr, "Can't write {}\n", trace_path);
+            return 1;
         }
     }
+    return 0;
+}
 
-    virtual void visitConstantUnion(glslang::TIntermConstantUnion* interm) {
-        std::cout << "visitConstantUnion " << interm->getLoc().line << ":" << interm->getLoc().column << std::endl;
-    }
+int run_http(AppState& appstate, uint16_t port)
+{
+    struct mg_mgr mgr;
+    struct mg_connection* nc;
+    mg_mgr_init(&mgr, &appstate);
 
-    virtual bool visitBinary(glslang::TVisit visit, glslang::TIntermBinary* interm)       { 
-        std::cout << "visitBinary " << interm->getLoc().line << ":" << interm->getLoc().column << std::endl;
-        return true; 
-    }
+    std::string port_str = std::to_string(port);
+    nc = mg_bind(&mgr, port_str.c_str(), ev_handler);
+    mg_set_protocol_http_websocket(nc);
 
-    virtual bool visitUnary(glslang::TVisit, glslang::TIntermUnary* interm)         { 
-        std::cout << "visitUnary " << interm->getLoc().line << ":" << interm->getLoc().column << std::endl;
-        return true; 
+    fmt::print("Starting web server on port {}\n", port);
+    for (;;) {
+        mg_mgr_poll(&mgr, 1000);
     }
 
-    virtual bool visitSelection(glslang::TVisit, glslang::TIntermSelection* interm) { 
-        std::cout << "visitSelection " << interm->getLoc().line << ":" << interm->getLoc().column << std::endl;
-        return true; 
-    }
+    mg_mgr_free(&mgr);
+    return 0;
+}
 
-    virtual bool visitAggregate(glslang::TVisit, glslang::TIntermAggregate* interm) { 
-        std::cout << "visitAggregate " << interm->getLoc().line << ":" << interm->getLoc().column << std::endl;
-        return true; 
+// Writes as much of the pending output as stdout accepts without blocking.
+// Returns false once stdout is gone.
+static bool flush_stdout(AppState& appstate, std::string& pending)
+{
+    for (;;) {
+        if (pending.empty()) {
+            auto frame = next_frame(appstate);
+            if (!frame.has_value()) {
+                return true;
+            }
+            pending = std::move(frame.value());
+        }
+        appstate.watchdog.set_phase("write");
+        ssize_t written = write(STDOUT_FILENO, pending.data(), pending.size());
+        if (written < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        pending.erase(0, written);
     }
+}
 
-    virtual bool visitLoop(glslang::TVisit, glslang::TIntermLoop* interm)           { 
-        std::cout << "visitLoop " << interm->getLoc().line << ":" << interm->getLoc().column << std::endl;
-        return true; 
-    }
+// Reads what the client sent so far, up to a bound, and queues the completed
+// messages, so that admission control sees all of them before any is
+// handled. Returns false once stdin is closed.
+static bool read_stdin(AppState& appstate, MessageBuffer& message_buffer)
+{
+    constexpr size_t max_read = 1 << 20;
+    char buffer[4096];
+    for (size_t total = 0; total < max_read;) {
+        ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (n <= 0) {
+            return n < 0 && errno == EINTR;
+        }
+        total += n;
+        for (ssize_t i = 0; i < n; ++i) {
+            message_buffer.handle_char(buffer[i]);
+            if (message_buffer.message_completed()) {
+                appstate.inbound.push(std::move(message_buffer));
+                message_buffer.clear();
+            }
+        }
 
-    virtual bool visitBranch(glslang::TVisit, glslang::TIntermBranch* interm) { 
-        std::cout << "visitBranch " << interm->getLoc().line << ":" << interm->getLoc().column << std::endl;
-        return true; 
+        struct pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+        if (poll(&fd, 1, 0) <= 0 || !(fd.revents & POLLIN)) {
+            break;
+        }
     }
+    return true;
+}
 
-    virtual bool visitSwitch(glslang::TVisit, glslang::TIntermSwitch* interm) {
-        std::cout << "visitSwitch " << interm->getLoc().line << ":" << interm->getLoc().column << std::endl;
-        return true; 
-    }
-};
+// Responses are queued and written whenever stdout is writable, so a client
+// that reads slowly delays neither reading its requests nor handling them.
+int run_stdio(AppState& appstate)
+{
+    appstate.push_notifications = true;
+    int stdout_flags = fcntl(STDOUT_FILENO, F_GETFL);
+    fcntl(STDOUT_FILENO, F_SETFL, stdout_flags | O_NONBLOCK);
+
+    MessageBuffer message_buffer;
+    std::string pending;
+    bool input_open = true;
+    while (input_open && !appstate.exit_requested) {
+        struct pollfd fds[2];
+        fds[0] = { STDIN_FILENO, POLLIN, 0 };
+        fds[1] = { STDOUT_FILENO, static_cast<short>(pending.empty() && appstate.outbound.empty() ? 0 : POLLOUT), 0 };
+        if (poll(fds, 2, 1000) < 0 && errno != EINTR) {
+            break;
+        }
+        WatchedIteration iteration(appstate.watchdog, "read");
 
-int main(int argc, char* argv[]) {
-    auto shader_cstring = content.c_str();
-    auto lang = find_language(document);
-    glslang::InitializeProcess();
-    glslang::TShader shader(lang);
-    shader.setStrings(&shader_cstring, 1);
-    TBuiltInResource Resources = glslang::DefaultTBuiltInResource;
-    EShMessages messages = EShMsgCascadingErrors;
-    shader.parse(&Resources, 110, false, messages);
-    std::string debug_log = shader.getInfoLog();
+        if (fds[1].revents & (POLLOUT | POLLERR | POLLHUP)) {
+            if (!flush_stdout(appstate, pending)) {
+                break;
+            }
+        }
 
-    // ACA SE PUEDE IMPLEMENTAR LA AYUDA CONTEXTUAL!!
-    const auto intermediate = shader.getIntermediate();
-    const auto root = intermediate->getTreeRoot();
+        if (fds[0].revents & (POLLIN | POLLHUP)) {
+            appstate.watchdog.set_phase("read");
+            input_open = read_stdin(appstate, message_buffer);
+            process_inbound(appstate);
+        }
+        maybe_save_snapshot(appstate);
+        maybe_reindex(appstate);
+    }
 
-    FindSymbolTraverser traverser{19, 13};
+    // Hand over whatever is left before going away.
+    fcntl(STDOUT_FILENO, F_SETFL, stdout_flags);
+    flush_stdout(appstate, pending);
+    return 0;
+}
 
-    root->traverse(&traverser);
+#ifdef GLSLLS_HAS_SHM
+// How long the ring to the client may stay full before the server gives up
+// on the client.
+static const int shm_send_timeout_ms = 30000;
+#endif
 
-    const auto symbol = traverser.getSymbol();
+int run_shm(AppState& appstate, const std::string& shm_name, uint32_t shm_capacity)
+{
+#ifdef GLSLLS_HAS_SHM
+    // Every ring frame holds exactly one complete LSP message.
+    auto transport = ShmTransport::create(shm_name, shm_capacity);
+    if (!transport) {
+        fmt::print(stderr, "Couldn't create shared memory segment '{}'\n", shm_name);
+        return 1;
+    }
 
-    if (symbol) {
-        std::cout 
-            << symbol->getLoc().line << ":" << symbol->getLoc().column << " -> " 
-            << symbol->getName() << ":" << symbol->getWritableType().getBasicTypeString() 
-            << std::endl;
-    } else {
-        std::cout << "no symbol located!";
+    // Frames already in the ring are queued together, up to a bound, for
+    // admission control.
+    constexpr int max_frames = 256;
+    appstate.push_notifications = true;
+    MessageBuffer message_buffer;
+    std::string frame;
+    while (!appstate.exit_requested) {
+        bool received = transport->receive(frame, 1000);
+        WatchedIteration iteration(appstate.watchdog, "read");
+        for (int frames = 0; received && frames < max_frames; ++frames) {
+            message_buffer.handle_string(frame);
+            if (message_buffer.message_completed()) {
+                appstate.inbound.push(std::move(message_buffer));
+            }
+            message_buffer.clear();
+            received = transport->receive(frame, 0);
+        }
+        if (transport->broken()) {
+            fmt::print(stderr, "Malformed frame in shared memory segment '{}', closing it\n", shm_name);
+            return 1;
+        }
+        process_inbound(appstate);
+        // The ring itself is bounded and blocks us while the client is
+        // behind, so the queue only ever holds what one message produced. A
+        // client that stops reading for good is given up on.
+        while (auto response = next_frame(appstate, transport->max_frame_size())) {
+            appstate.watchdog.set_phase("write");
+            if (!transport->send(response.value(), shm_send_timeout_ms)) {
+                fmt::print(stderr, "Client stopped reading shared memory segment '{}', closing it\n", shm_name);
+                return 1;
+            }
+        }
+        maybe_save_snapshot(appstate);
+        maybe_reindex(appstate);
     }
+    return 0;
+#else
+    fmt::print(stderr, "Shared memory transport is not supported on this platform\n");
+    return 1;
+#endif
+}
 
-    glslang::FinalizeProcess();
+int main(int argc, char* argv[])
+{
+    CLI::App app{ "GLSL Language Server" };
+
+    bool use_stdin = false;
+    bool verbose = false;
+    bool demo = false;
+    uint16_t port = 61313;
+    std::string logfile;
+    std::string snapshot;
+    std::string shm_name;
+    uint32_t shm_capacity = 1 << 20;
+    std::string profile;
+    std::string trace;
+    unsigned stall_threshold = 250;
+
+    app.add_flag("--stdin", use_stdin, "Don't launch an HTTP server and instead accept input on stdin");
+    app.add_flag("-v,--verbose", verbose, "Enable verbose logging");
+    app.add_flag("--demo", demo, "Look up a symbol in a built-in sample shader and exit");
+    app.add_option("-l,--log", logfile, "Log file");
+    app.add_option("-p,--port", port, "Port", true);
+    app.add_option("--snapshot", snapshot, "Snapshot file used for fast restarts");
+    app.add_option("--shm", shm_name, "Exchange messages with a co-located client through the named shared memory segment");
+    app.add_option("--shm-capacity", shm_capacity, "Size in bytes of each shared memory ring", true);
+    app.add_option("--profile", profile, "Report where glslang spends its time on a shader file and exit");
+    app.add_option("--trace", trace, "With --profile, also write a trace event file (chrome://tracing)");
+    app.add_option("--stall-threshold", stall_threshold, "Report I/O loop iterations taking longer than this many milliseconds (0 disables)", true);
+
+    CLI11_PARSE(app, argc, argv);
+
+    if (demo) {
+        return run_demo();
+    }
+    if (!profile.empty()) {
+        return run_profile(profile, trace);
+    }
 
-    return 0;
+    AppState appstate;
+    appstate.verbose = verbose;
+    appstate.use_logfile = !logfile.empty();
+    appstate.snapshot_path = snapshot;
+#ifdef GLSLLS_SLAB_ALLOCATOR
+    appstate.allocator_stats = allocator_stats;
+#endif
+    if (appstate.use_logfile) {
+        appstate.logfile_stream.open(logfile);
+    }
+    appstate.watchdog.start(std::chrono::milliseconds(stall_threshold), [&appstate](std::string report) {
+        appstate.logfile_stream.post(std::move(report));
+    });
+
+    if (!shm_name.empty()) {
+        return run_shm(appstate, shm_name, shm_capacity);
+    } else if (!use_stdin) {
+        return run_http(appstate, port);
+    }
+    return run_stdio(appstate);
 }
@@ -1,4 +1,7 @@
 #include "messagebuffer.hpp"
+#include "text.hpp"
+
+#include <charconv>
 
 MessageBuffer::MessageBuffer() {}
 MessageBuffer::~MessageBuffer() {}
@@ -7,30 +10,30 @@ void MessageBuffer::handle_char(char c)
 {
     m_raw_message += c;
 
-    auto new_header = try_parse_header(m_raw_message);
-    // Check whether we were actually able to parse a header.
-    // If so, add it to our known headers.
-    // We'll also reset our string then.
-    if (!std::get<0>(new_header).empty()) {
-        m_headers[std::get<0>(new_header)] = std::get<1>(new_header);
-        m_raw_message.clear();
-    }
-
-    // A sole \r\n is the separator between the header block and the body block
-    // but we don't need it.
-    if (m_raw_message == "\r\n") {
-        m_raw_message.clear();
-        m_is_header_done = true;
+    // Bodies may be binary, so headers are only looked for before the
+    // separator, and only once a whole line is there.
+    if (!m_is_header_done) {
+        size_t size = m_raw_message.size();
+        if (c != '\n' || size < 2 || m_raw_message[size - 2] != '\r') {
+            return;
+        }
+        // A sole \r\n is the separator between the header block and the body
+        // block but we don't need it.
+        if (size == 2) {
+            m_raw_message.clear();
+            end_headers();
+        } else {
+            parse_header_line(std::string_view(m_raw_message).substr(0, size - 2));
+            m_raw_message.clear();
+            return;
+        }
     }
 
-    if (m_is_header_done) {
-        // Now that we know that we're in the body, we just have to count until
-        // we reach the length of the body as provided in the Content-Length
-        // header.
-        auto content_length = std::stoi(m_headers["Content-Length"]);
-        if (m_raw_message.length() == content_length) {
-            m_body = json::parse(m_raw_message);
-        }
+    // Now that we know that we're in the body, we just have to count until
+    // we reach the length of the body as provided in the Content-Length
+    // header.
+    if (!m_is_body_done && m_raw_message.length() >= m_content_length) {
+        end_body();
     }
 }
 
@@ -38,74 +41,121 @@ void MessageBuffer::handle_string(std::string s)
 {
     m_raw_message += s;
 
-    auto new_header = try_parse_header(m_raw_message);
-    // Check whether we were actually able to parse a header.
-    // If so, add it to our known headers.
-    // We'll also reset our string then.
-    if (!std::get<0>(new_header).empty()) {
-        m_headers[std::get<0>(new_header)] = std::get<1>(new_header);
-        m_raw_message.clear();
+    // Unlike handle_char(), the string may hold any number of header lines,
+    // the separator and the body all at once, so consume line by line.
+    while (!m_is_header_done) {
+        auto eol_pos = m_raw_message.find("\r\n");
+        if (eol_pos == std::string::npos) {
+            return;
+        }
+
+        // A sole \r\n is the separator between the header block and the body
+        // block but we don't need it.
+        if (eol_pos == 0) {
+            m_raw_message.erase(0, 2);
+            end_headers();
+            break;
+        }
+
+        parse_header_line(std::string_view(m_raw_message).substr(0, eol_pos));
+        m_raw_message.erase(0, eol_pos + 2);
     }
 
-    // A sole \r\n is the separator between the header block and the body block
-    // but we don't need it.
-    if (m_raw_message == "\r\n") {
-        m_raw_message.clear();
-        m_is_header_done = true;
+    if (!m_is_body_done && m_raw_message.length() >= m_content_length) {
+        end_body();
     }
+}
 
-    if (m_is_header_done) {
-        // Now that we know that we're in the body, we just have to count until
-        // we reach the length of the body as provided in the Content-Length
-        // header.
-        auto content_length = std::stoi(m_headers["Content-Length"]);
-        if (m_raw_message.length() == content_length) {
-            m_body = json::parse(m_raw_message);
-        }
+void MessageBuffer::parse_header_line(std::string_view line)
+{
+    // Lines that aren't headers, like an HTTP request line, are skipped.
+    auto delim_pos = line.find(':');
+    if (delim_pos != std::string_view::npos) {
+        m_headers[std::string(line.substr(0, delim_pos))] = trim(line.substr(delim_pos + 1));
+    }
+}
+
+void MessageBuffer::end_headers()
+{
+    m_is_header_done = true;
+
+    const std::string* length = find_header("Content-Length");
+    if (!length) {
+        m_error = Error{ ErrorCode::InvalidRequest, "Missing Content-Length header" };
+        m_is_body_done = true;
+        return;
+    }
+    const char* begin = length->data();
+    const char* end = begin + length->size();
+    auto [parsed_end, ec] = std::from_chars(begin, end, m_content_length);
+    if (ec != std::errc() || parsed_end != end) {
+        m_error = Error{ ErrorCode::InvalidRequest, "Invalid Content-Length header: " + *length };
+        m_is_body_done = true;
     }
 }
 
+void MessageBuffer::end_body()
+{
+    m_raw_message.resize(m_content_length);
+    auto body = decode_body(m_raw_message, encoding());
+    if (body) {
+        m_body = std::move(*body);
+    } else {
+        m_error = body.error();
+    }
+    m_is_body_done = true;
+}
+
 const std::map<std::string, std::string>& MessageBuffer::headers() const
 {
     return m_headers;
 }
 
+BodyEncoding MessageBuffer::encoding() const
+{
+    const std::string* content_type = find_header("Content-Type");
+    if (!content_type) {
+        return BodyEncoding::Json;
+    }
+    return encoding_from_content_type(*content_type);
+}
+
+const std::string* MessageBuffer::find_header(std::string_view name) const
+{
+    for (const auto& [key, value] : m_headers) {
+        if (equals_ignore_case(key, name)) {
+            return &value;
+        }
+    }
+    return nullptr;
+}
+
 const json& MessageBuffer::body() const
 {
     return m_body;
 }
 
-const std::string& MessageBuffer::raw() const
+const std::optional<Error>& MessageBuffer::error() const
 {
-    return m_raw_message;
+    return m_error;
 }
 
-bool MessageBuffer::message_completed()
+const std::string& MessageBuffer::raw() const
 {
-    if (m_is_header_done && !m_body.empty()) {
-        return true;
-    }
-    return false;
+    return m_raw_message;
 }
 
-std::tuple<std::string, std::string> MessageBuffer::try_parse_header(std::string& message) const
+bool MessageBuffer::message_completed()
 {
-    auto eol_pos = m_raw_message.find("\r\n");
-    if (eol_pos != std::string::npos) {
-        std::string header_string = m_raw_message.substr(0, eol_pos);
-        auto delim_pos = header_string.find(":");
-        if (delim_pos != std::string::npos) {
-            std::string header_name = header_string.substr(0, delim_pos);
-            std::string header_value = header_string.substr(delim_pos + 1);
-            return std::make_tuple(header_name, header_value);
-        }
-    }
-    return std::make_tuple(std::string{}, std::string{});
+    return m_is_body_done;
 }
 
 void MessageBuffer::clear() {
     m_raw_message.clear();
     m_headers.clear();
     m_body.clear();
+    m_error.reset();
+    m_content_length = 0;
     m_is_header_done = false;
+    m_is_body_done = false;
 }
@@ -3,33 +3,54 @@
 
 #include "nlohmann/json.hpp"
 
+#include "encoding.hpp"
+#include "expected.hpp"
+
+#include <optional>
 #include <string>
-#include <tuple>
+#include <string_view>
 
 using json = nlohmann::json;
 
+// Assembles one framed message. Nothing here throws on malformed input: a
+// frame without a usable Content-Length or with a body that doesn't decode
+// completes with an error() instead of a body().
 class MessageBuffer {
 public:
     MessageBuffer();
     virtual ~MessageBuffer();
+    MessageBuffer(const MessageBuffer&) = default;
+    MessageBuffer(MessageBuffer&&) = default;
+    MessageBuffer& operator=(const MessageBuffer&) = default;
+    MessageBuffer& operator=(MessageBuffer&&) = default;
     void handle_char(char c);
     void handle_string(std::string s);
     const std::map<std::string, std::string>& headers() const;
+    BodyEncoding encoding() const;
     const json& body() const;
+    const std::optional<Error>& error() const;
     const std::string& raw() const;
     bool message_completed();
     void clear();
 
 private:
-    std::tuple<std::string, std::string> try_parse_header(std::string &message) const;
+    void parse_header_line(std::string_view line);
+    // Header names are case-insensitive, as in HTTP. The names in headers()
+    // are as the client spelled them.
+    const std::string* find_header(std::string_view name) const;
+    void end_headers();
+    void end_body();
 
     std::string m_raw_message;
     std::map<std::string, std::string> m_headers;
     json m_body;
+    std::optional<Error> m_error;
+    size_t m_content_length = 0;
 
     // This is set once a sole \r\n is encountered because it denotes that the
     // header is done.
     bool m_is_header_done = false;
+    bool m_is_body_done = false;
 };
 
 #endif /* MESSAGEBUFFER_H */
@@ -0,0 +1,119 @@
+#include "outboundqueue.hpp"
+
+static std::string coalesce_key_of(const json& body)
+{
+    // Only notifications, which have no id, can be superseded.
+    if (body.count("id") || !body.count("method")) {
+        return {};
+    }
+
+    const json& method = body["method"];
+    const json& params = body.count("params") ? body["params"] : json();
+    if (method == "textDocument/publishDiagnostics" && params.count("uri")) {
+        return "textDocument/publishDiagnostics " + params["uri"].get<std::string>();
+    } else if (method == "$/progress" && params.count("token")) {
+        return "$/progress " + dump_json(params["token"]);
+    }
+    return {};
+}
+
+OutboundQueue::OutboundQueue(size_t capacity, size_t high_watermark, size_t low_watermark)
+    : m_capacity(capacity)
+    , m_high_watermark(high_watermark)
+    , m_low_watermark(low_watermark)
+{
+}
+
+OutboundQueue::~OutboundQueue() {}
+
+void OutboundQueue::set_pressure_callback(std::function<void(bool)> callback)
+{
+    m_pressure_callback = std::move(callback);
+}
+
+bool OutboundQueue::push(json body, BodyEncoding encoding)
+{
+    bool is_notification = body.count("id") == 0;
+    std::string key = coalesce_key_of(body);
+
+    if (!key.empty()) {
+        auto it = m_by_key.find(key);
+        if (it != m_by_key.end()) {
+            // Keep the position of the superseded message, so that the
+            // client doesn't starve on a frequently updated one.
+            it->second->body = std::move(body);
+            it->second->encoding = encoding;
+            ++m_coalesced;
+            return true;
+        }
+    }
+
+    // Keyed notifications are bounded by their keys already, and dropping
+    // one would leave the client with a stale state for good.
+    if (is_notification && key.empty() && m_messages.size() >= m_capacity) {
+        ++m_dropped;
+        return false;
+    }
+
+    m_messages.push_back({ std::move(body), encoding, key });
+    if (!key.empty()) {
+        m_by_key[key] = std::prev(m_messages.end());
+    }
+    update_pressure();
+    return true;
+}
+
+std::optional<OutboundMessage> OutboundQueue::pop()
+{
+    if (m_messages.empty()) {
+        return std::nullopt;
+    }
+    OutboundMessage message = std::move(m_messages.front());
+    m_messages.pop_front();
+    if (!message.coalesce_key.empty()) {
+        m_by_key.erase(message.coalesce_key);
+    }
+    update_pressure();
+    return message;
+}
+
+bool OutboundQueue::empty() const
+{
+    return m_messages.empty();
+}
+
+size_t OutboundQueue::size() const
+{
+    return m_messages.size();
+}
+
+bool OutboundQueue::under_pressure() const
+{
+    return m_under_pressure;
+}
+
+size_t OutboundQueue::coalesced_count() const
+{
+    return m_coalesced;
+}
+
+size_t OutboundQueue::dropped_count() const
+{
+    return m_dropped;
+}
+
+void OutboundQueue::update_pressure()
+{
+    bool pressure = m_under_pressure;
+    if (m_messages.size() > m_high_watermark) {
+        pressure = true;
+    } else if (m_messages.size() < m_low_watermark) {
+        pressure = false;
+    }
+    if (pressure != m_under_pressure) {
+        m_under_pressure = pressure;
+        if (m_pressure_callback) {
+            m_pressure_callback(pressure);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef OUTBOUNDQUEUE_H
+#define OUTBOUNDQUEUE_H
+
+#include "nlohmann/json.hpp"
+
+#include "encoding.hpp"
+
+#include <functional>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+using json = nlohmann::json;
+
+struct OutboundMessage {
+    json body;
+    BodyEncoding encoding = BodyEncoding::Json;
+
+    // Notifications a later one makes obsolete, like the diagnostics of a
+    // document, share a key. Empty for everything else.
+    std::string coalesce_key;
+};
+
+// Messages waiting for the client to read them. Messages are kept as JSON
+// and only encoded when they are written, so superseded notifications are
+// never serialized.
+//
+// Responses are always queued, since the client waits for them and their
+// number is bounded by the requests it has in flight. So are notifications
+// with a coalescing key, bounded by the number of keys: one replaces a
+// queued one with the same key in place. Other notifications are dropped
+// while the queue holds `capacity` messages.
+class OutboundQueue
+{
+
+public:
+    OutboundQueue(size_t capacity = 256, size_t high_watermark = 64, size_t low_watermark = 16);
+    virtual ~OutboundQueue();
+
+    // Called with true when the queue grows above the high watermark and with
+    // false once it drained below the low watermark again.
+    void set_pressure_callback(std::function<void(bool)> callback);
+
+    // Returns false if the message was dropped.
+    bool push(json body, BodyEncoding encoding);
+    std::optional<OutboundMessage> pop();
+
+    bool empty() const;
+    size_t size() const;
+    bool under_pressure() const;
+
+    size_t coalesced_count() const;
+    size_t dropped_count() const;
+
+private:
+    void update_pressure();
+
+    size_t m_capacity;
+    size_t m_high_watermark;
+    size_t m_low_watermark;
+    std::function<void(bool)> m_pressure_callback;
+    bool m_under_pressure = false;
+
+    std::list<OutboundMessage> m_messages;
+    std::unordered_map<std::string, std::list<OutboundMessage>::iterator> m_by_key;
+
+    size_t m_coalesced = 0;
+    size_t m_dropped = 0;
+};
+
+#endif /* OUTBOUNDQUEUE_H */
@@ -0,0 +1,121 @@
+#include "parsepool.hpp"
+
+#include "glslang/Include/PoolAlloc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+// Every `trim_interval` parses, a pool whose high-water mark is more than
+// `trim_ratio` times what those parses needed is recreated.
+static const size_t trim_interval = 256;
+static const size_t trim_ratio = 4;
+
+static std::atomic<size_t> total_parses{ 0 };
+static std::atomic<size_t> total_reuses{ 0 };
+static std::atomic<size_t> total_trims{ 0 };
+static std::atomic<size_t> total_high_water{ 0 };
+
+namespace {
+
+struct GlslangRuntime {
+    GlslangRuntime()
+    {
+        glslang::InitializeProcess();
+    }
+
+    ~GlslangRuntime()
+    {
+        glslang::FinalizeProcess();
+    }
+};
+
+}
+
+void ensure_glslang_initialized()
+{
+    static GlslangRuntime runtime;
+}
+
+ParsePool::ParsePool()
+    : m_pool(std::make_unique<glslang::TPoolAllocator>())
+{
+}
+
+ParsePool::~ParsePool() {}
+
+ParsePool& ParsePool::this_thread()
+{
+    thread_local ParsePool pool;
+    return pool;
+}
+
+glslang::TPoolAllocator* ParsePool::acquire(size_t source_size)
+{
+    // The previous parse is fully destroyed by now, so its allocations can be
+    // released. popAll() keeps single pages on the free list for reuse.
+    if (m_used) {
+        m_pool->popAll();
+        ++total_reuses;
+    }
+    trim_if_oversized();
+
+    m_used = true;
+    ++m_parses_since_trim;
+    m_high_water = std::max(m_high_water, source_size);
+    m_recent_high_water = std::max(m_recent_high_water, source_size);
+    ++total_parses;
+    size_t high_water = total_high_water.load(std::memory_order_relaxed);
+    while (high_water < source_size
+            && !total_high_water.compare_exchange_weak(high_water, source_size, std::memory_order_relaxed)) {
+    }
+
+    // Everything the parse allocates lives above this mark.
+    m_pool->push();
+    glslang::SetThreadPoolAllocator(m_pool.get());
+    return m_pool.get();
+}
+
+void ParsePool::trim_if_oversized()
+{
+    if (m_parses_since_trim < trim_interval) {
+        return;
+    }
+    if (m_high_water > trim_ratio * m_recent_high_water) {
+        m_pool = std::make_unique<glslang::TPoolAllocator>();
+        m_used = false;
+        m_high_water = m_recent_high_water;
+        ++total_trims;
+    }
+    m_parses_since_trim = 0;
+    m_recent_high_water = 0;
+}
+
+ParsePoolStats parse_pool_stats()
+{
+    ParsePoolStats stats;
+    stats.parses = total_parses.load(std::memory_order_relaxed);
+    stats.reuses = total_reuses.load(std::memory_order_relaxed);
+    stats.trims = total_trims.load(std::memory_order_relaxed);
+    stats.high_water = total_high_water.load(std::memory_order_relaxed);
+    return stats;
+}
+
+AcquiredParsePool::AcquiredParsePool(size_t source_size)
+    : acquired_pool(ParsePool::this_thread().acquire(source_size))
+{
+}
+
+PooledShader::PooledShader(EShLanguage stage, size_t source_size)
+    : AcquiredParsePool(source_size)
+    , glslang::TShader(stage)
+{
+    delete pool;
+    pool = acquired_pool;
+}
+
+PooledShader::~PooledShader()
+{
+    // The pool belongs to the thread; keep ~TShader from deleting it.
+    pool = nullptr;
+}
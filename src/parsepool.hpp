@@ -0,0 +1,81 @@
+#ifndef PARSEPOOL_H
+#define PARSEPOOL_H
+
+#include "ShaderLang.h"
+
+#include <cstddef>
+#include <memory>
+
+namespace glslang {
+class TPoolAllocator;
+}
+
+// Initializes glslang once for the lifetime of the process. Tearing it down
+// after every parse, as FinalizeProcess() does, also throws away the builtin
+// symbol tables and the per-process pool.
+void ensure_glslang_initialized();
+
+// A glslang pool allocator owned by one worker thread and reused by all the
+// parses running on it. Between parses the pool is reset but keeps its pages,
+// which takes malloc/free out of the parse path.
+//
+// glslang doesn't report how much of a pool is in use, so the high-water
+// mark is tracked in source bytes parsed. When it is far above what recent
+// parses needed, the pool is recreated to give back the pages a single huge
+// shader left behind.
+class ParsePool
+{
+
+public:
+    ParsePool();
+    virtual ~ParsePool();
+
+    ParsePool(const ParsePool&) = delete;
+    ParsePool& operator=(const ParsePool&) = delete;
+
+    static ParsePool& this_thread();
+
+    // Resets the pool for a parse of `source_size` bytes and returns it.
+    glslang::TPoolAllocator* acquire(size_t source_size);
+
+private:
+    void trim_if_oversized();
+
+    std::unique_ptr<glslang::TPoolAllocator> m_pool;
+    bool m_used = false;
+    size_t m_parses_since_trim = 0;
+    size_t m_high_water = 0;
+    size_t m_recent_high_water = 0;
+};
+
+struct ParsePoolStats {
+    size_t parses = 0;
+    size_t reuses = 0;
+    size_t trims = 0;
+
+    // Largest source, in bytes, parsed through any pool.
+    size_t high_water = 0;
+};
+
+ParsePoolStats parse_pool_stats();
+
+// The calling thread's ParsePool, acquired for one parse. A base of
+// PooledShader, constructed before TShader: TShader's constructor allocates
+// from the thread's pool, which must not be reset under it.
+struct AcquiredParsePool {
+    explicit AcquiredParsePool(size_t source_size);
+
+    glslang::TPoolAllocator* acquired_pool;
+};
+
+// A TShader that parses into the calling thread's ParsePool instead of a
+// pool of its own.
+class PooledShader : private AcquiredParsePool, public glslang::TShader
+{
+
+public:
+    PooledShader(EShLanguage stage, size_t source_size);
+    ~PooledShader() override;
+};
+
+#endif /* PARSEPOOL_H */
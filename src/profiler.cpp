@@ -0,0 +1,378 @@
+#include "profiler.hpp"
+#include "analysis.hpp"
+#include "includer.hpp"
+#include "lexer.hpp"
+#include "parsepool.hpp"
+#include "scopetree.hpp"
+#include "text.hpp"
+
+#include "ResourceLimits.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <tuple>
+
+using Clock = std::chrono::steady_clock;
+
+static double milliseconds(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+namespace {
+
+// Times every include from glslang opening it to glslang releasing it once
+// it has consumed all of its tokens. Includes nest strictly, so a stack of
+// the open ones is enough to tell their self time.
+class ProfilingIncluder : public FileIncluder
+{
+
+public:
+    struct Include {
+        ProfileEvent event;
+        std::string text;
+    };
+
+    ProfilingIncluder(Clock::time_point origin, std::vector<std::string> search_paths)
+        : FileIncluder(std::move(search_paths))
+        , m_origin(origin)
+    {
+    }
+
+    IncludeResult* includeLocal(const char* header_name, const char* includer_name, size_t depth) override
+    {
+        return opened(FileIncluder::includeLocal(header_name, includer_name, depth));
+    }
+
+    IncludeResult* includeSystem(const char* header_name, const char* includer_name, size_t depth) override
+    {
+        return opened(FileIncluder::includeSystem(header_name, includer_name, depth));
+    }
+
+    void releaseInclude(IncludeResult* result) override
+    {
+        auto now = Clock::now();
+        if (result && !m_open.empty() && m_open.back().first == result) {
+            auto& include = m_includes[m_open.back().second];
+            include.event.duration = milliseconds(m_origin, now) - include.event.start;
+            include.event.self += include.event.duration;
+            m_open.pop_back();
+            if (!m_open.empty()) {
+                m_includes[m_open.back().second].event.self -= include.event.duration;
+            }
+        }
+        FileIncluder::releaseInclude(result);
+    }
+
+    const std::vector<Include>& includes() const
+    {
+        return m_includes;
+    }
+
+private:
+    IncludeResult* opened(IncludeResult* result)
+    {
+        if (result) {
+            Include include;
+            include.event.name = result->headerName;
+            include.event.depth = static_cast<int>(m_open.size()) + 1;
+            include.text.assign(result->headerData, result->headerLength);
+            include.event.start = milliseconds(m_origin, Clock::now());
+            m_open.emplace_back(result, m_includes.size());
+            m_includes.push_back(std::move(include));
+        }
+        return result;
+    }
+
+    Clock::time_point m_origin;
+    std::vector<Include> m_includes;
+    std::vector<std::pair<IncludeResult*, size_t>> m_open;
+};
+
+}
+
+// The #version line of the document, so that the builtins measured are those
+// the document gets. As for glslang, only comments and whitespace may come
+// before it.
+static std::string version_directive(std::string_view text)
+{
+    auto tokens = lex(text);
+    if (tokens.size() < 2 || token_text(text, tokens[0]) != "#" || tokens[1].line != tokens[0].line
+        || token_text(text, tokens[1]) != "version") {
+        return "";
+    }
+    // Up to its last token, leaving out comments that may not end on the line.
+    size_t last = 1;
+    while (last + 1 < tokens.size() && tokens[last + 1].line == tokens[0].line) {
+        ++last;
+    }
+    size_t end = tokens[last].offset + tokens[last].length;
+    return std::string(text.substr(tokens[0].offset, end - tokens[0].offset)) + "\n";
+}
+
+// Splits `self`, the time spent on the tokens of `text` itself, between the
+// functions defined in it by token share.
+static void attribute_functions(const std::string& name, const std::string& text, double self,
+    std::vector<ProfileEvent>& functions)
+{
+    auto tokens = lex(text);
+    if (tokens.empty()) {
+        return;
+    }
+    auto tree = build_scope_tree(text, tokens);
+    const auto& globals = tree.scopes[0].declarations;
+
+    auto token_at = [&](int line, int character) {
+        return std::lower_bound(tokens.begin(), tokens.end(), std::make_pair(line, character),
+            [](const Token& token, const std::pair<int, int>& position) {
+                return std::make_pair(static_cast<int>(token.line), static_cast<int>(token.character)) < position;
+            });
+    };
+
+    for (int child : tree.scopes[0].children) {
+        const Scope& scope = tree.scopes[child];
+        if (scope.kind != ScopeKind::Function) {
+            continue;
+        }
+        // The function is the last one declared before its parameter list.
+        auto declaration = std::find_if(globals.rbegin(), globals.rend(), [&](const SymbolOccurrence& symbol) {
+            return symbol.kind == SymbolKind::Function
+                && std::tie(symbol.line, symbol.character) < std::tie(scope.start_line, scope.start_character);
+        });
+        if (declaration == globals.rend()) {
+            continue;
+        }
+        auto begin = token_at(declaration->line, declaration->character);
+        auto end = token_at(scope.end_line, scope.end_character);
+        ProfileEvent event;
+        event.name = declaration->name + " (" + name + ":" + std::to_string(declaration->line + 1) + ")";
+        event.duration = self * (end - begin) / tokens.size();
+        event.self = event.duration;
+        functions.push_back(std::move(event));
+    }
+}
+
+Expected<ShaderProfile> profile_document(const std::string& uri, const std::string& text,
+    const std::vector<std::string>& include_paths)
+{
+    auto lang = find_language(uri);
+    if (!lang) {
+        return lang.error();
+    }
+
+    ShaderProfile profile;
+    profile.uri = uri;
+
+    ensure_glslang_initialized();
+    TBuiltInResource resources = glslang::DefaultTBuiltInResource;
+    EShMessages messages = EShMsgCascadingErrors;
+
+    std::string name = uri_to_path(uri);
+    if (name.empty()) {
+        name = uri;
+    }
+    const char* source = text.c_str();
+    const int length = static_cast<int>(text.size());
+    const char* source_name = name.c_str();
+
+    auto origin = Clock::now();
+    auto add = [](std::vector<ProfileEvent>& events, const char* name, double start, double duration) {
+        ProfileEvent event;
+        event.name = name;
+        event.start = start;
+        event.duration = duration;
+        event.self = duration;
+        events.push_back(event);
+    };
+    auto run = [&](const char* name, Clock::time_point start) {
+        add(profile.runs, name, milliseconds(origin, start), milliseconds(start, Clock::now()));
+        return profile.runs.back();
+    };
+
+    // The first parse of a stage and version builds glslang's builtin symbol
+    // tables; every later one only copies them.
+    std::string minimal = version_directive(text) + "void main() {}\n";
+    const char* minimal_source = minimal.c_str();
+    auto parse_minimal = [&]() {
+        PooledShader shader(*lang, minimal.size());
+        shader.setStrings(&minimal_source, 1);
+        shader.parse(&resources, 110, false, messages);
+    };
+    auto start = Clock::now();
+    parse_minimal();
+    auto cold = run("builtins (cold)", start);
+    start = Clock::now();
+    parse_minimal();
+    auto builtins = run("builtins", start);
+    if (cold.duration > 2 * builtins.duration) {
+        add(profile.phases, "builtins (first use)", cold.start, cold.duration - builtins.duration);
+    }
+    add(profile.phases, "builtins", builtins.start, builtins.duration);
+
+    start = Clock::now();
+    {
+        PooledShader shader(*lang, text.size());
+        shader.setStringsWithLengthsAndNames(&source, &length, &source_name, 1);
+        shader.setPreamble(include_preamble);
+        FileIncluder includer(include_paths);
+        std::string output;
+        shader.preprocess(&resources, 110, ENoProfile, false, false, messages, &output, includer);
+    }
+    auto preprocess = run("preprocess", start);
+    add(profile.phases, "preprocess", preprocess.start, preprocess.duration);
+
+    std::vector<ProfilingIncluder::Include> includes;
+    start = Clock::now();
+    {
+        PooledShader shader(*lang, text.size());
+        shader.setStringsWithLengthsAndNames(&source, &length, &source_name, 1);
+        shader.setPreamble(include_preamble);
+        ProfilingIncluder includer(origin, include_paths);
+        profile.parsed = shader.parse(&resources, 110, false, messages, includer);
+        includes = includer.includes();
+    }
+    auto compile = run("compile", start);
+    add(profile.phases, "parse", compile.start,
+        std::max(0.0, compile.duration - builtins.duration - preprocess.duration));
+
+    // What the document itself costs, builtins aside.
+    double main_self = compile.duration - builtins.duration;
+    for (const auto& include : includes) {
+        if (include.event.depth == 1) {
+            main_self -= include.event.duration;
+        }
+    }
+
+    for (const auto& phase : profile.phases) {
+        profile.total += phase.duration;
+    }
+
+    attribute_functions(name, text, std::max(0.0, main_self), profile.functions);
+    for (const auto& include : includes) {
+        profile.includes.push_back(include.event);
+        attribute_functions(include.event.name, include.text, std::max(0.0, include.event.self), profile.functions);
+    }
+
+    // Function times are estimates without a place in time; lay them out one
+    // after the other from the start of the compile.
+    double position = compile.start;
+    for (auto& function : profile.functions) {
+        function.start = position;
+        position += function.duration;
+    }
+    return profile;
+}
+
+static std::string format_line(double duration, double total, const std::string& name, double self = -1)
+{
+    char buffer[64];
+    if (self >= 0) {
+        std::snprintf(buffer, sizeof(buffer), "%10.2f ms %10.2f ms %6.1f%%  ", duration, self,
+            total > 0 ? 100 * duration / total : 0.0);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%10.2f ms %6.1f%%  ", duration,
+            total > 0 ? 100 * duration / total : 0.0);
+    }
+    return buffer + name + "\n";
+}
+
+std::string profile_report(const ShaderProfile& profile)
+{
+    char total[32];
+    std::snprintf(total, sizeof(total), "%.2f ms", profile.total);
+    std::string report = "Profile of " + profile.uri + (profile.parsed ? "" : " (does not parse)")
+        + ": " + total + "\n";
+
+    auto by_duration = [](std::vector<ProfileEvent> events) {
+        std::stable_sort(events.begin(), events.end(),
+            [](const ProfileEvent& a, const ProfileEvent& b) { return a.duration > b.duration; });
+        return events;
+    };
+
+    report += "\nPhases:\n";
+    for (const auto& phase : profile.phases) {
+        report += format_line(phase.duration, profile.total, phase.name);
+    }
+    if (!profile.includes.empty()) {
+        report += "\nIncludes (total, self):\n";
+        for (const auto& include : by_duration(profile.includes)) {
+            report += format_line(include.duration, profile.total, include.name, include.self);
+        }
+    }
+    if (!profile.functions.empty()) {
+        report += "\nFunctions (estimated from their share of tokens):\n";
+        for (const auto& function : by_duration(profile.functions)) {
+            report += format_line(function.duration, profile.total, function.name);
+        }
+    }
+    return report;
+}
+
+json profile_trace(const ShaderProfile& profile)
+{
+    // The glslang runs and the includes on one track, the estimated
+    // functions on another.
+    json events = json::array();
+    auto add = [&](const ProfileEvent& event, const char* category, int track) {
+        events.push_back({
+            { "name", event.name },
+            { "cat", category },
+            { "ph", "X" },
+            { "ts", event.start * 1000 },
+            { "dur", event.duration * 1000 },
+            { "pid", 1 },
+            { "tid", track },
+        });
+    };
+    for (const auto& run : profile.runs) {
+        add(run, "run", 1);
+    }
+    for (const auto& include : profile.includes) {
+        add(include, "include", 1);
+    }
+    for (const auto& function : profile.functions) {
+        add(function, "function", 2);
+    }
+    for (const auto& [track, name] : { std::make_pair(1, "glslang"), std::make_pair(2, "functions (estimated)") }) {
+        events.push_back({
+            { "name", "thread_name" },
+            { "ph", "M" },
+            { "pid", 1 },
+            { "tid", track },
+            { "args", { { "name", name } } },
+        });
+    }
+    return {
+        { "traceEvents", events },
+        { "displayTimeUnit", "ms" },
+    };
+}
+
+static json events_to_json(const std::vector<ProfileEvent>& events)
+{
+    json result = json::array();
+    for (const auto& event : events) {
+        result.push_back({
+            { "name", event.name },
+            { "start", event.start },
+            { "duration", event.duration },
+            { "self", event.self },
+            { "depth", event.depth },
+        });
+    }
+    return result;
+}
+
+json profile_to_json(const ShaderProfile& profile)
+{
+    return {
+        { "uri", profile.uri },
+        { "parsed", profile.parsed },
+        { "total", profile.total },
+        { "runs", events_to_json(profile.runs) },
+        { "phases", events_to_json(profile.phases) },
+        { "includes", events_to_json(profile.includes) },
+        { "functions", events_to_json(profile.functions) },
+    };
+}
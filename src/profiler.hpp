@@ -0,0 +1,59 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "expected.hpp"
+
+#include "nlohmann/json.hpp"
+
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+// Times are in milliseconds from the start of the profile.
+struct ProfileEvent {
+    std::string name;
+    double start = 0;
+    double duration = 0;
+
+    // For includes, the duration minus that of the includes nested in them.
+    double self = 0;
+    int depth = 0;
+};
+
+// Where glslang spends its time compiling a document.
+//
+// glslang is run several times: an empty shader of the same stage and
+// version, twice, to time the builtins, a preprocessor-only run, and the
+// full compile. The parse phase is what remains of the full compile once
+// builtins and preprocessing are taken out. Includes are timed during the
+// full compile, from glslang opening each one to it releasing it. Function
+// bodies can't be timed from outside glslang, so each file's own parse time
+// is split between its functions by their share of its tokens.
+struct ShaderProfile {
+    std::string uri;
+    bool parsed = false;
+    double total = 0;
+
+    // The glslang runs as they happened, and the phases derived from them.
+    std::vector<ProfileEvent> runs;
+    std::vector<ProfileEvent> phases;
+    std::vector<ProfileEvent> includes;
+    std::vector<ProfileEvent> functions;
+};
+
+// Includes not found next to the including file are searched in
+// `include_paths`.
+Expected<ShaderProfile> profile_document(const std::string& uri, const std::string& text,
+    const std::vector<std::string>& include_paths = {});
+
+// Phases, then includes and functions from the most to the least expensive.
+std::string profile_report(const ShaderProfile& profile);
+
+// A trace in the Trace Event Format, as written by clang's -ftime-trace, for
+// chrome://tracing or Perfetto.
+json profile_trace(const ShaderProfile& profile);
+
+json profile_to_json(const ShaderProfile& profile);
+
+#endif /* PROFILER_H */
@@ -0,0 +1,110 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+
+Scheduler::Scheduler(unsigned num_threads)
+{
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < num_threads; ++i) {
+        m_threads.emplace_back([this]() { run(); });
+    }
+}
+
+Scheduler::~Scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_work_available.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void Scheduler::submit(Priority priority, std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (priority == Priority::Interactive) {
+            m_interactive.push_back(std::move(task));
+        } else {
+            m_background.push_back(std::move(task));
+        }
+    }
+    m_work_available.notify_one();
+}
+
+void Scheduler::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() {
+        return m_interactive.empty() && m_background.empty() && m_busy == 0;
+    });
+}
+
+void Scheduler::set_background_throttled(bool throttled)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_background_throttled = throttled;
+    }
+    m_work_available.notify_all();
+}
+
+bool Scheduler::background_throttled()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_background_throttled;
+}
+
+unsigned Scheduler::num_threads() const
+{
+    return m_threads.size();
+}
+
+void Scheduler::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_work_available.wait(lock, [this]() {
+            return m_stopping || !m_interactive.empty() || can_run_background();
+        });
+        if (m_stopping && m_interactive.empty() && m_background.empty()) {
+            return;
+        }
+
+        bool background = m_interactive.empty();
+        auto& queue = background ? m_background : m_interactive;
+        auto task = std::move(queue.front());
+        queue.pop_front();
+        ++m_busy;
+        if (background) {
+            ++m_background_running;
+        }
+
+        lock.unlock();
+        task();
+        lock.lock();
+
+        --m_busy;
+        if (background) {
+            --m_background_running;
+            m_work_available.notify_one();
+        }
+        if (m_busy == 0 && m_interactive.empty() && m_background.empty()) {
+            m_idle.notify_all();
+        }
+    }
+}
+
+bool Scheduler::can_run_background() const
+{
+    if (m_background.empty()) {
+        return false;
+    }
+    // Remaining work is drained at full speed on shutdown.
+    return m_stopping || !m_background_throttled || m_background_running == 0;
+}
@@ -0,0 +1,72 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// A fixed pool of worker threads. Interactive work (anything a client is
+// waiting on) always runs before background work.
+class Scheduler
+{
+
+public:
+    enum class Priority {
+        Interactive,
+        Background,
+    };
+
+    // 0 threads means one per hardware thread.
+    explicit Scheduler(unsigned num_threads = 0);
+    virtual ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    void submit(Priority priority, std::function<void()> task);
+
+    template <typename F>
+    auto async(Priority priority, F&& f) -> std::future<std::invoke_result_t<F>>
+    {
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(f));
+        auto future = task->get_future();
+        submit(priority, [task]() { (*task)(); });
+        return future;
+    }
+
+    // Blocks until both queues are empty and no task is running.
+    void wait_idle();
+
+    // While throttled, at most one background task runs at a time, leaving
+    // the other workers to interactive work. Used for backpressure when the
+    // client can't keep up with what we send.
+    void set_background_throttled(bool throttled);
+    bool background_throttled();
+
+    unsigned num_threads() const;
+
+private:
+    void run();
+
+    // Must be called with m_mutex held.
+    bool can_run_background() const;
+
+    std::mutex m_mutex;
+    std::condition_variable m_work_available;
+    std::condition_variable m_idle;
+    std::deque<std::function<void()>> m_interactive;
+    std::deque<std::function<void()>> m_background;
+    std::vector<std::thread> m_threads;
+    unsigned m_busy = 0;
+    unsigned m_background_running = 0;
+    bool m_background_throttled = false;
+    bool m_stopping = false;
+};
+
+#endif /* SCHEDULER_H */
@@ -0,0 +1,540 @@
+#include "scopetree.hpp"
+#include "text.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+
+// Scopes left open at the end of the document extend to its end.
+static const int open_end = std::numeric_limits<int>::max();
+
+static const std::set<std::string_view> qualifiers = {
+    "attribute", "buffer", "centroid", "coherent", "const", "flat", "highp",
+    "in", "inout", "invariant", "layout", "lowp", "mediump", "noperspective",
+    "out", "patch", "precise", "readonly", "restrict", "sample", "shared",
+    "smooth", "subroutine", "uniform", "varying", "volatile", "writeonly",
+};
+
+// Identifiers that start a statement that is not a declaration.
+static const std::set<std::string_view> statement_keywords = {
+    "break", "case", "continue", "default", "discard", "do", "else", "for",
+    "if", "precision", "return", "struct", "switch", "while",
+};
+
+namespace {
+
+// An open scope, or an open struct or interface block, whose members are
+// collected separately since they aren't visible by themselves.
+struct Frame {
+    int scope = -1;
+    bool interface_block = false;
+
+    // A loop whose body is a single statement that opened a scope of its
+    // own; the loop ends with it.
+    bool braceless_loop = false;
+    std::string name;
+    std::vector<SymbolOccurrence> members;
+};
+
+// Builds the tree in a single pass over the tokens, tolerating anything a
+// half-typed shader can contain: unbalanced braces close or leave open
+// scopes rather than failing, and statements that don't look like
+// declarations are skipped.
+class ScopeTreeBuilder
+{
+
+public:
+    ScopeTreeBuilder(std::string_view text, const std::vector<Token>& tokens, const ScopeTree* previous)
+        : m_text(text)
+        , m_tokens(tokens)
+        , m_previous(previous)
+    {
+        Scope global;
+        global.end_line = open_end;
+        global.end_character = open_end;
+        m_tree.scopes.push_back(std::move(global));
+        m_frames.push_back({ 0 });
+
+        if (previous) {
+            for (size_t i = 0; i < previous->scopes.size(); ++i) {
+                if (previous->scopes[i].kind == ScopeKind::Function) {
+                    m_previous_functions.emplace(previous->scopes[i].hash, static_cast<int>(i));
+                }
+            }
+        }
+    }
+
+    ScopeTree run()
+    {
+        size_t i = 0;
+        while (i < m_tokens.size()) {
+            i = statement(i);
+        }
+        return std::move(m_tree);
+    }
+
+private:
+    std::string_view text(size_t i) const
+    {
+        return i < m_tokens.size() ? token_text(m_text, m_tokens[i]) : std::string_view();
+    }
+
+    bool is(size_t i, std::string_view s) const
+    {
+        return i < m_tokens.size() && text(i) == s;
+    }
+
+    bool is_identifier(size_t i) const
+    {
+        return i < m_tokens.size() && m_tokens[i].kind == TokenKind::Identifier;
+    }
+
+    // Skips from an opening bracket to just past its matching closing one.
+    size_t skip_balanced(size_t i) const
+    {
+        int depth = 0;
+        for (; i < m_tokens.size(); ++i) {
+            auto t = text(i);
+            if (t == "(" || t == "[" || t == "{") {
+                ++depth;
+            } else if (t == ")" || t == "]" || t == "}") {
+                if (--depth <= 0) {
+                    return i + 1;
+                }
+            }
+        }
+        return i;
+    }
+
+    // Returns the brace closing the one at `open`, or the end of the tokens.
+    size_t matching_brace(size_t open) const
+    {
+        int depth = 0;
+        for (size_t i = open; i < m_tokens.size(); ++i) {
+            if (is(i, "{")) {
+                ++depth;
+            } else if (is(i, "}") && --depth == 0) {
+                return i;
+            }
+        }
+        return m_tokens.size();
+    }
+
+    // Skips an initializer up to the "," or ";" ending it, without crossing
+    // a closing brace of the enclosing block.
+    size_t skip_expression(size_t i) const
+    {
+        while (i < m_tokens.size() && !is(i, ",") && !is(i, ";") && !is(i, "}") && !is(i, ")")) {
+            i = is(i, "(") || is(i, "[") || is(i, "{") ? skip_balanced(i) : i + 1;
+        }
+        return i;
+    }
+
+    int current_scope() const
+    {
+        for (auto it = m_frames.rbegin(); it != m_frames.rend(); ++it) {
+            if (it->scope >= 0) {
+                return it->scope;
+            }
+        }
+        return 0;
+    }
+
+    bool in_global_scope() const
+    {
+        return m_frames.size() == 1;
+    }
+
+    SymbolOccurrence make_symbol(size_t name, const std::string& type, SymbolKind kind) const
+    {
+        SymbolOccurrence symbol;
+        symbol.name = std::string(text(name));
+        symbol.type = type;
+        symbol.kind = kind;
+        symbol.line = m_tokens[name].line;
+        symbol.character = m_tokens[name].character;
+        return symbol;
+    }
+
+    void declare(size_t name, const std::string& type, SymbolKind kind)
+    {
+        auto& frame = m_frames.back();
+        auto symbol = make_symbol(name, type, kind);
+        if (frame.scope >= 0) {
+            m_tree.scopes[frame.scope].declarations.push_back(std::move(symbol));
+        } else {
+            frame.members.push_back(std::move(symbol));
+        }
+    }
+
+    void open_scope(ScopeKind kind, size_t start)
+    {
+        int parent = current_scope();
+        Scope scope;
+        scope.kind = kind;
+        scope.parent = parent;
+        scope.start_line = m_tokens[start].line;
+        scope.start_character = m_tokens[start].character;
+        scope.end_line = open_end;
+        scope.end_character = open_end;
+
+        int index = static_cast<int>(m_tree.scopes.size());
+        m_tree.scopes.push_back(std::move(scope));
+        m_tree.scopes[parent].children.push_back(index);
+        m_frames.push_back({ index });
+    }
+
+    // Closes the innermost frame at the token `end`, which is included.
+    void close_frame(size_t end)
+    {
+        // Never close the global scope, however many braces are unbalanced.
+        if (m_frames.size() == 1) {
+            return;
+        }
+        Frame frame = std::move(m_frames.back());
+        m_frames.pop_back();
+        if (frame.scope >= 0) {
+            auto& scope = m_tree.scopes[frame.scope];
+            scope.end_line = m_tokens[end].line;
+            scope.end_character = m_tokens[end].character + m_tokens[end].length;
+            if (m_frames.back().braceless_loop) {
+                close_frame(end);
+            }
+            return;
+        }
+        m_closed_aggregate = true;
+        m_closed_name = frame.name;
+        if (frame.interface_block) {
+            m_pending_members = std::move(frame.members);
+        }
+    }
+
+    // Handles one statement starting at `i` and returns where the next one
+    // starts.
+    size_t statement(size_t i)
+    {
+        bool after_aggregate = m_closed_aggregate;
+        m_closed_aggregate = false;
+
+        if (is(i, "}")) {
+            close_frame(i);
+            return i + 1;
+        }
+        if (after_aggregate) {
+            // An interface block without an instance name makes its members
+            // visible by themselves; "} name;" declares variables of the
+            // struct or block.
+            bool named = false;
+            while (is_identifier(i)) {
+                named = true;
+                declare(i, m_closed_name, SymbolKind::Variable);
+                i = is(i + 1, "[") ? skip_balanced(i + 1) : i + 1;
+                if (!is(i, ",")) {
+                    break;
+                }
+                ++i;
+            }
+            if (!named) {
+                for (auto& member : m_pending_members) {
+                    m_tree.scopes[current_scope()].declarations.push_back(std::move(member));
+                }
+            }
+            m_pending_members.clear();
+        }
+        if (is(i, "{")) {
+            open_scope(ScopeKind::Block, i);
+            return i + 1;
+        }
+        if (is(i, ";")) {
+            return i + 1;
+        }
+        if (is(i, "#")) {
+            uint32_t line = m_tokens[i].line;
+            while (i < m_tokens.size() && m_tokens[i].line == line) {
+                ++i;
+            }
+            return i;
+        }
+        if ((is(i, "for") || is(i, "while")) && is(i + 1, "(")) {
+            size_t close = skip_balanced(i + 1);
+            if (is(i, "while") && is(close, ";")) {
+                // The end of a do-while loop.
+                return close + 1;
+            }
+            open_scope(ScopeKind::Loop, i);
+            if (is(i, "for")) {
+                declaration(i + 2);
+            }
+            return loop_body(close);
+        }
+        if (is(i, "do")) {
+            open_scope(ScopeKind::Loop, i);
+            return loop_body(i + 1);
+        }
+
+        size_t next = declaration(i);
+        if (next != i) {
+            return next;
+        }
+
+        // Not a declaration: skip to the end of the statement.
+        while (i < m_tokens.size() && !is(i, ";") && !is(i, "{") && !is(i, "}")) {
+            i = is(i, "(") || is(i, "[") ? skip_balanced(i) : i + 1;
+        }
+        return is(i, ";") ? i + 1 : i;
+    }
+
+    // A braced loop body is closed by its "}" like any other scope, a
+    // single statement body closes the loop right away.
+    size_t loop_body(size_t i)
+    {
+        if (is(i, "{")) {
+            return i + 1;
+        }
+        size_t depth = m_frames.size();
+        if (i < m_tokens.size() && !is(i, "}")) {
+            i = statement(i);
+        }
+        if (m_frames.size() > depth) {
+            m_frames[depth - 1].braceless_loop = true;
+        } else {
+            close_frame(std::min(i, m_tokens.size()) - 1);
+        }
+        return i;
+    }
+
+    // Recovers the declaration starting at `i`, if any, and returns where it
+    // ends, or `i` if there is none.
+    size_t declaration(size_t i)
+    {
+        size_t j = i;
+        bool qualified = false;
+        while (is_identifier(j) && qualifiers.count(text(j))) {
+            qualified = true;
+            j = is(j, "layout") && is(j + 1, "(") ? skip_balanced(j + 1) : j + 1;
+        }
+
+        if (is(j, "struct")) {
+            ++j;
+            std::string name;
+            if (is_identifier(j)) {
+                name = std::string(text(j));
+                declare(j, "struct", SymbolKind::Struct);
+                ++j;
+            }
+            if (!is(j, "{")) {
+                return i;
+            }
+            Frame frame;
+            frame.name = name;
+            m_frames.push_back(std::move(frame));
+            return j + 1;
+        }
+        if (qualified && is_identifier(j) && is(j + 1, "{")) {
+            Frame frame;
+            frame.interface_block = true;
+            frame.name = std::string(text(j));
+            m_frames.push_back(std::move(frame));
+            return j + 2;
+        }
+
+        if (!is_identifier(j) || statement_keywords.count(text(j))) {
+            return i;
+        }
+        size_t type_begin = j;
+        ++j;
+        if (is(j, "[")) {
+            j = skip_balanced(j);
+        }
+        std::string type(m_text, m_tokens[type_begin].offset,
+            m_tokens[j - 1].offset + m_tokens[j - 1].length - m_tokens[type_begin].offset);
+        if (!is_identifier(j) || statement_keywords.count(text(j)) || qualifiers.count(text(j))) {
+            return i;
+        }
+
+        if (is(j + 1, "(")) {
+            if (!in_global_scope()) {
+                return i;
+            }
+            declare(j, type, SymbolKind::Function);
+            return function(type_begin, j + 1);
+        }
+
+        while (is_identifier(j)) {
+            declare(j, type, SymbolKind::Variable);
+            ++j;
+            if (is(j, "[")) {
+                j = skip_balanced(j);
+            }
+            if (is(j, "=")) {
+                j = skip_expression(j + 1);
+            }
+            if (!is(j, ",")) {
+                break;
+            }
+            ++j;
+        }
+        return is(j, ";") ? j + 1 : j;
+    }
+
+    // Handles the function whose declaration starts at `begin` and whose
+    // parameter list starts at `open`, entering its body if it has one.
+    size_t function(size_t begin, size_t open)
+    {
+        size_t close = skip_balanced(open);
+        if (!is(close, "{")) {
+            return is(close, ";") ? close + 1 : close;
+        }
+
+        size_t body_end = matching_brace(close);
+        uint64_t hash = 0;
+        if (body_end < m_tokens.size()) {
+            size_t end = m_tokens[body_end].offset + m_tokens[body_end].length;
+            hash = hash_string(m_text.substr(m_tokens[begin].offset, end - m_tokens[begin].offset));
+            if (reuse_function(hash, open)) {
+                return body_end + 1;
+            }
+        }
+
+        open_scope(ScopeKind::Function, open);
+        m_tree.scopes[current_scope()].hash = hash;
+
+        // Parameters are "[qualifiers] type name [array]", separated by commas.
+        size_t params_end = is(close - 1, ")") ? close - 1 : close;
+        size_t param = open + 1;
+        while (param < params_end) {
+            size_t k = param;
+            while (k < params_end && !is(k, ",")) {
+                k = is(k, "(") || is(k, "[") ? skip_balanced(k) : k + 1;
+            }
+            size_t name = k;
+            while (name > param && !is_identifier(name - 1)) {
+                --name;
+            }
+            if (name > param + 1 && is_identifier(name - 2) && !qualifiers.count(text(name - 2))) {
+                declare(name - 1, std::string(text(name - 2)), SymbolKind::Variable);
+            }
+            param = k + 1;
+        }
+        return close + 1;
+    }
+
+    // Copies the subtree of an unchanged function from the previous tree,
+    // shifted to where the function is now.
+    bool reuse_function(uint64_t hash, size_t open)
+    {
+        auto found = m_previous_functions.find(hash);
+        if (found == m_previous_functions.end()) {
+            return false;
+        }
+        const Scope& old = m_previous->scopes[found->second];
+        if (old.start_character != static_cast<int>(m_tokens[open].character)) {
+            return false;
+        }
+        int delta = static_cast<int>(m_tokens[open].line) - old.start_line;
+        copy_subtree(found->second, 0, delta);
+        return true;
+    }
+
+    void copy_subtree(int old_index, int parent, int delta)
+    {
+        auto shift = [delta](int line) { return line == open_end ? line : line + delta; };
+
+        Scope scope = m_previous->scopes[old_index];
+        scope.parent = parent;
+        scope.start_line = shift(scope.start_line);
+        scope.end_line = shift(scope.end_line);
+        scope.children.clear();
+        for (auto& declaration : scope.declarations) {
+            declaration.line += delta;
+        }
+
+        int index = static_cast<int>(m_tree.scopes.size());
+        m_tree.scopes.push_back(std::move(scope));
+        m_tree.scopes[parent].children.push_back(index);
+        for (int child : m_previous->scopes[old_index].children) {
+            copy_subtree(child, index, delta);
+        }
+    }
+
+    std::string_view m_text;
+    const std::vector<Token>& m_tokens;
+    const ScopeTree* m_previous;
+    std::unordered_map<uint64_t, int> m_previous_functions;
+
+    ScopeTree m_tree;
+    std::vector<Frame> m_frames;
+
+    // The aggregate the last statement closed, for the declarators that may
+    // follow it.
+    bool m_closed_aggregate = false;
+    std::string m_closed_name;
+    std::vector<SymbolOccurrence> m_pending_members;
+};
+
+bool before(int line, int character, int other_line, int other_character)
+{
+    return std::tie(line, character) < std::tie(other_line, other_character);
+}
+
+}
+
+ScopeTree build_scope_tree(std::string_view text, const std::vector<Token>& tokens, const ScopeTree* previous)
+{
+    return ScopeTreeBuilder(text, tokens, previous).run();
+}
+
+std::vector<SymbolOccurrence> visible_symbols(const ScopeTree& tree, int line, int character)
+{
+    if (tree.scopes.empty()) {
+        return {};
+    }
+
+    // Children are sorted and don't overlap, so the only one that can contain
+    // the position is the last one starting before it.
+    std::vector<int> path{ 0 };
+    while (true) {
+        const auto& children = tree.scopes[path.back()].children;
+        auto it = std::upper_bound(children.begin(), children.end(), std::make_pair(line, character),
+            [&](const std::pair<int, int>& position, int child) {
+                const Scope& scope = tree.scopes[child];
+                return before(position.first, position.second, scope.start_line, scope.start_character);
+            });
+        if (it == children.begin()) {
+            break;
+        }
+        const Scope& candidate = tree.scopes[*(it - 1)];
+        if (!before(line, character, candidate.end_line, candidate.end_character)) {
+            break;
+        }
+        path.push_back(*(it - 1));
+    }
+
+    std::vector<SymbolOccurrence> symbols;
+    std::set<std::string> seen;
+    auto add = [&](const SymbolOccurrence& symbol) {
+        bool typing = symbol.line == line && symbol.character <= character
+            && character <= symbol.character + static_cast<int>(symbol.name.size());
+        if (!typing && seen.insert(symbol.name).second) {
+            symbols.push_back(symbol);
+        }
+    };
+    for (auto scope = path.rbegin(); scope != path.rend(); ++scope) {
+        const auto& declarations = tree.scopes[*scope].declarations;
+        if (*scope == 0) {
+            std::for_each(declarations.begin(), declarations.end(), add);
+            break;
+        }
+        // Locals are only visible after their declaration, and the latest
+        // one wins.
+        auto end = std::lower_bound(declarations.begin(), declarations.end(), std::make_pair(line, character),
+            [](const SymbolOccurrence& symbol, const std::pair<int, int>& position) {
+                return before(symbol.line, symbol.character, position.first, position.second);
+            });
+        std::for_each(std::make_reverse_iterator(end), declarations.rend(), add);
+    }
+    return symbols;
+}
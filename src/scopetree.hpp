@@ -0,0 +1,60 @@
+#ifndef SCOPETREE_H
+#define SCOPETREE_H
+
+#include "analysis.hpp"
+#include "lexer.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class ScopeKind {
+    Global,
+    Function,
+    Block,
+    Loop,
+};
+
+struct Scope {
+    ScopeKind kind = ScopeKind::Global;
+    int parent = -1;
+
+    // The scope covers [start, end). Function scopes start at the parameter
+    // list, loop scopes at the for/while/do keyword.
+    int start_line = 0;
+    int start_character = 0;
+    int end_line = 0;
+    int end_character = 0;
+
+    // For function scopes, the hash of the function's text, so the subtree
+    // can be reused when the function didn't change.
+    uint64_t hash = 0;
+
+    // Indexes into ScopeTree::scopes, sorted by position.
+    std::vector<int> children;
+
+    // Sorted by position.
+    std::vector<SymbolOccurrence> declarations;
+};
+
+// The scopes of a document and the declarations in each of them, built from
+// its tokens, so it is available whether the document parses or not. The
+// global scope is scopes[0]; struct and interface block members are not
+// scopes, but members of unnamed interface blocks are global declarations.
+struct ScopeTree {
+    std::vector<Scope> scopes;
+};
+
+// Builds the scope tree of `text`. Function subtrees of `previous` whose text
+// didn't change are copied over instead of being rebuilt.
+ScopeTree build_scope_tree(std::string_view text, const std::vector<Token>& tokens,
+    const ScopeTree* previous = nullptr);
+
+// Returns the declarations visible at a position, innermost first: locals
+// and parameters of the enclosing scopes declared before it, then every
+// global declaration. Shadowed declarations and the identifier being typed
+// at the position are left out.
+std::vector<SymbolOccurrence> visible_symbols(const ScopeTree& tree, int line, int character);
+
+#endif /* SCOPETREE_H */
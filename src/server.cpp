@@ -0,0 +1,902 @@
+#include "server.hpp"
+#include "jsonfields.hpp"
+#include "parsepool.hpp"
+#include "text.hpp"
+
+#include "fmt/format.h"
+#include "fmt/ostream.h"
+
+#include "mongoose.h"
+
+#include <initializer_list>
+#include <set>
+
+AppState::AppState()
+{
+    // Background work only produces more output and competes with the
+    // requests, so slow it down while the client is behind on reading and
+    // while we are behind on handling what it sent.
+    auto throttle = [this](bool) {
+        core.scheduler().set_background_throttled(outbound.under_pressure() || inbound.overloaded());
+    };
+    outbound.set_pressure_callback(throttle);
+    inbound.set_overload_callback(throttle);
+}
+
+std::string make_response(const json& response, BodyEncoding encoding)
+{
+    json content = response;
+    content["jsonrpc"] = "2.0";
+    std::string body = encode_body(content, encoding);
+
+    std::string header;
+    header.append("Content-Length: " + std::to_string(body.size()) + "\r\n");
+    header.append(std::string("Content-Type: ") + content_type_of(encoding) + "\r\n");
+    header.append("\r\n");
+    return header + body;
+}
+
+json diagnostics_to_json(const Analysis& analysis, AppState& appstate)
+{
+    json diagnostics = json::array();
+    for (const auto& diagnostic : analysis.diagnostics) {
+        if (diagnostic.severity == -1 && appstate.use_logfile) {
+            fmt::print(appstate.logfile_stream, "Error: Unknown severity '{}'\n", diagnostic.severity_name);
+        }
+        json range{
+            {"start", {
+                { "line", diagnostic.line },
+                { "character", diagnostic.start_character },
+            }},
+            { "end", {
+                { "line", diagnostic.line },
+                { "character", diagnostic.end_character },
+            }},
+        };
+        json entry{
+            { "range", range },
+            { "severity", diagnostic.severity },
+            { "source", "glslang" },
+            { "message", diagnostic.message },
+        };
+        // Diagnostics of headers tell which includers they come from.
+        if (!diagnostic.contexts.empty()) {
+            std::string contexts;
+            for (const auto& context : diagnostic.contexts) {
+                contexts += (contexts.empty() ? "" : ", ") + context;
+            }
+            entry["message"] = diagnostic.message + " (in " + contexts + ")";
+            entry["data"] = { { "contexts", diagnostic.contexts } };
+        }
+        diagnostics.push_back(std::move(entry));
+    }
+    return diagnostics;
+}
+
+json get_diagnostics(const std::string& uri, AppState& appstate)
+{
+    auto result = appstate.core.analysis(uri);
+    if (!result) {
+        if (appstate.use_logfile) {
+            fmt::print(appstate.logfile_stream, "No diagnostics: {}\n", result.error().message);
+        }
+        return json::array();
+    }
+    const auto& analysis = *result;
+    if (appstate.use_logfile && appstate.verbose) {
+        fmt::print(appstate.logfile_stream, "Diagnostics raw output: {}\n" , analysis->info_log);
+    }
+    json diagnostics = diagnostics_to_json(*analysis, appstate);
+    if (appstate.use_logfile && appstate.verbose) {
+        fmt::print(appstate.logfile_stream, "Sending diagnostics: {}\n" , dump_json(diagnostics));
+    }
+    appstate.logfile_stream.flush();
+    return diagnostics;
+}
+
+json get_stats(AppState& appstate)
+{
+    auto parse_pool = parse_pool_stats();
+    auto index = appstate.core.index_stats();
+    json folders = json::object();
+    for (const auto& [root, folder] : appstate.core.folder_index_stats()) {
+        folders[root] = {
+            { "files", folder.files },
+            { "fromGitIndex", folder.from_git_index },
+            { "hashed", folder.hashed },
+            { "cacheHits", folder.cache_hits },
+            { "summarized", folder.summarized },
+        };
+    }
+    json stats{
+        { "parsePool", {
+            { "parses", parse_pool.parses },
+            { "reuses", parse_pool.reuses },
+            { "trims", parse_pool.trims },
+            { "highWater", parse_pool.high_water },
+        } },
+        { "outboundQueue", {
+            { "size", appstate.outbound.size() },
+            { "coalesced", appstate.outbound.coalesced_count() },
+            { "dropped", appstate.outbound.dropped_count() },
+        } },
+        { "inboundQueue", {
+            { "size", appstate.inbound.size() },
+            { "queuedWork", appstate.inbound.queued_work() },
+            { "overloaded", appstate.inbound.overloaded() },
+            { "shed", appstate.inbound.shed_counts() },
+        } },
+        { "index", {
+            { "files", index.files },
+            { "fromGitIndex", index.from_git_index },
+            { "hashed", index.hashed },
+            { "cacheHits", index.cache_hits },
+            { "summarized", index.summarized },
+            { "summaries", index.summaries },
+            { "folders", folders },
+        } },
+        { "eventLoop", {
+            { "stalls", appstate.watchdog.stall_count() },
+            { "longestStallMs", appstate.watchdog.longest_stall().count() },
+            { "stallsByPhase", appstate.watchdog.stalls_by_phase() },
+        } },
+        { "log", {
+            { "droppedBytes", appstate.logfile_stream.dropped_bytes() },
+        } },
+    };
+
+    if (appstate.allocator_stats) {
+        auto allocator = appstate.allocator_stats();
+        json size_classes = json::array();
+        for (const auto& size_class : allocator.size_classes) {
+            size_classes.push_back({
+                { "size", size_class.size },
+                { "liveBytes", size_class.live_bytes },
+                { "allocations", size_class.allocations },
+                { "frees", size_class.frees },
+            });
+        }
+        stats["allocator"] = {
+            { "sizeClasses", size_classes },
+            { "crossThreadFrees", allocator.cross_thread_frees },
+            { "largeAllocations", allocator.large_allocations },
+            { "spans", allocator.spans },
+        };
+    }
+    return stats;
+}
+
+void save_snapshot(AppState& appstate)
+{
+    if (appstate.snapshot_path.empty()) {
+        return;
+    }
+    bool saved = appstate.core.save_snapshot(appstate.snapshot_path);
+    if (appstate.use_logfile) {
+        if (saved) {
+            fmt::print(appstate.logfile_stream, "Wrote snapshot to '{}'\n", appstate.snapshot_path);
+        } else {
+            fmt::print(appstate.logfile_stream, "Error: Couldn't write snapshot to '{}'\n", appstate.snapshot_path);
+        }
+    }
+    appstate.last_snapshot = std::chrono::steady_clock::now();
+    appstate.snapshot_dirty = false;
+}
+
+void maybe_save_snapshot(AppState& appstate)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (appstate.snapshot_dirty && now - appstate.last_snapshot >= appstate.snapshot_interval) {
+        appstate.watchdog.set_phase("snapshot");
+        save_snapshot(appstate);
+    }
+}
+
+void load_snapshot(AppState& appstate)
+{
+    if (appstate.snapshot_path.empty()) {
+        return;
+    }
+    auto restored = appstate.core.load_snapshot(appstate.snapshot_path);
+    if (restored.has_value() && appstate.use_logfile) {
+        fmt::print(appstate.logfile_stream, "Restored {} analyses from snapshot, reparsing {} documents\n",
+                restored->analyses.size(), restored->stale_documents.size());
+    }
+}
+
+static const std::string& method_of(const json& body)
+{
+    static const std::string none;
+    const json* method = find_field(body, { "method" });
+    return method && method->is_string() ? method->get_ref<const std::string&>() : none;
+}
+
+// The document a message is about, if any, for stall reports.
+static const std::string& uri_of(const json& body)
+{
+    static const std::string none;
+    const json* uri = find_field(body, { "params", "textDocument", "uri" });
+    return uri && uri->is_string() ? uri->get_ref<const std::string&>() : none;
+}
+
+static json error_reply(const json& id, const Error& error)
+{
+    return {
+        { "id", id },
+        { "error", {
+            { "code", static_cast<int>(error.code) },
+            { "message", error.message },
+        } },
+    };
+}
+
+// Notifications get no reply, not even an error.
+static std::optional<json> notification_error(AppState& appstate, const std::string& method, const Error& error)
+{
+    if (appstate.use_logfile) {
+        fmt::print(appstate.logfile_stream, "Error: Ignored '{}' notification: {}\n", method, error.message);
+    }
+    return std::nullopt;
+}
+
+static json diagnostics_notification(const std::string& uri, AppState& appstate)
+{
+    return {
+        { "method", "textDocument/publishDiagnostics" },
+        { "params", {
+            { "uri", uri },
+            { "diagnostics", get_diagnostics(uri, appstate) },
+        } },
+    };
+}
+
+// Indexes the workspace folder `uri` in the background, stopping a build of
+// it still running.
+static void index_workspace_folder(const std::string& uri, AppState& appstate)
+{
+    auto cache_path = string_field(appstate.config, { "indexCachePath" });
+    appstate.core.scheduler().submit(Scheduler::Priority::Background,
+        [&appstate, uri, cache_path = cache_path ? *cache_path : std::string()]() {
+            // Folders removed before their turn aren't indexed.
+            auto stats = appstate.core.index_folder(uri, cache_path);
+            if (!stats) {
+                return;
+            }
+            appstate.logfile_stream.post(fmt::format(
+                "Indexed {} files under '{}': {} from the git index, {} hashed, {} cached, {} summarized\n",
+                stats->files, uri, stats->from_git_index, stats->hashed, stats->cache_hits, stats->summarized));
+        });
+}
+
+void maybe_reindex(AppState& appstate)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - appstate.last_index_check < appstate.index_check_interval) {
+        return;
+    }
+    appstate.last_index_check = now;
+    for (const auto& uri : appstate.core.folders_to_reindex()) {
+        index_workspace_folder(uri, appstate);
+    }
+}
+
+// Adds the workspace folder `uri` with its settings: the
+// initializationOptions, overridden by those under folders.<uri>. Relative
+// includePaths are relative to the folder. The folder is then indexed in the
+// background unless its indexWorkspace is false; indexCachePath keeps the
+// summaries of all folders across sessions.
+static void add_workspace_folder(const std::string& uri, AppState& appstate)
+{
+    WorkspaceFolder folder;
+    folder.uri = uri;
+    folder.path = uri_to_path(uri);
+    if (folder.path.empty()) {
+        return;
+    }
+    json settings = appstate.config;
+    settings.erase("folders");
+    const json* overrides = find_field(appstate.config, { "folders", uri.c_str() });
+    if (overrides && overrides->is_object()) {
+        settings.merge_patch(*overrides);
+    }
+    const json* include_paths = find_field(settings, { "includePaths" });
+    if (include_paths && include_paths->is_array()) {
+        for (const auto& include_path : *include_paths) {
+            if (!include_path.is_string() || include_path.get_ref<const std::string&>().empty()) {
+                continue;
+            }
+            const std::string& path = include_path.get_ref<const std::string&>();
+            folder.include_paths.push_back(path[0] == '/' ? path : folder.path + "/" + path);
+        }
+    }
+    appstate.core.add_folder(folder);
+
+    const json* enabled = find_field(settings, { "indexWorkspace" });
+    if (enabled && enabled->is_boolean() && !enabled->get<bool>()) {
+        return;
+    }
+    index_workspace_folder(uri, appstate);
+}
+
+// The workspaceFolders of the client, or the root of clients without them.
+static void add_initial_folders(const json& body, AppState& appstate)
+{
+    const json* folders = find_field(body, { "params", "workspaceFolders" });
+    if (folders && folders->is_array()) {
+        for (const auto& folder : *folders) {
+            if (auto uri = string_field(folder, { "uri" })) {
+                add_workspace_folder(*uri, appstate);
+            }
+        }
+    } else if (auto root_uri = string_field(body, { "params", "rootUri" })) {
+        add_workspace_folder(*root_uri, appstate);
+    } else if (auto root_path = string_field(body, { "params", "rootPath" })) {
+        add_workspace_folder(path_to_uri(*root_path), appstate);
+    }
+}
+
+std::optional<json> handle_message(const MessageBuffer& message_buffer, AppState& appstate,
+    bool publish_diagnostics)
+{
+    if (message_buffer.error()) {
+        return error_reply(nullptr, *message_buffer.error());
+    }
+
+    const json& body = message_buffer.body();
+    if (!body.is_object()) {
+        return error_reply(nullptr, { ErrorCode::InvalidRequest, "Expected a JSON-RPC message object." });
+    }
+    const json* id_field = find_field(body, { "id" });
+    const json id = id_field ? *id_field : json(nullptr);
+    const std::string& method = method_of(body);
+
+    if (method == "initialized") {
+        return std::nullopt;
+    }
+
+    if (method == "exit") {
+        appstate.exit_requested = true;
+        return std::nullopt;
+    }
+
+    if (method == "initialize") {
+        appstate.core.set_initialized(true);
+
+        const json* options = find_field(body, { "params", "initializationOptions" });
+        if (options && options->is_object()) {
+            appstate.config = *options;
+            auto snapshot_path = string_field(appstate.config, { "snapshotPath" });
+            if (snapshot_path) {
+                appstate.snapshot_path = *snapshot_path;
+            }
+            appstate.snapshot_interval = std::chrono::seconds(
+                    int_field_or(appstate.config, { "snapshotInterval" }, 30));
+        }
+        add_initial_folders(body, appstate);
+        load_snapshot(appstate);
+
+        json text_document_sync{
+            { "openClose", true },
+            { "change", 1 }, // Full sync
+            { "willSave", false },
+            { "willSaveWaitUntil", false },
+            { "save", { { "includeText", false } } },
+        };
+
+        json completion_provider{
+            { "resolveProvider", false },
+            { "triggerCharacters", json::array() },
+        };
+        json signature_help_provider{
+            { "triggerCharacters", "" }
+        };
+        json code_lens_provider{
+            { "resolveProvider", false }
+        };
+        json document_on_type_formatting_provider{
+            { "firstTriggerCharacter", "" },
+            { "moreTriggerCharacter", "" },
+        };
+        json document_link_provider{
+            { "resolveProvider", false }
+        };
+        json execute_command_provider{
+            { "commands", {} }
+        };
+        json workspace{
+            { "workspaceFolders", {
+                { "supported", true },
+                { "changeNotifications", true },
+            } },
+        };
+        json result{
+            {
+                "capabilities",
+                {
+                { "textDocumentSync", text_document_sync },
+                { "hoverProvider", true },
+                { "selectionRangeProvider", true },
+                { "completionProvider", completion_provider },
+                { "signatureHelpProvider", signature_help_provider },
+                { "definitionProvider", false },
+                { "referencesProvider", false },
+                { "documentHighlightProvider", false },
+                { "documentSymbolProvider", false },
+                { "workspaceSymbolProvider", true },
+                { "codeActionProvider", false },
+                { "codeLensProvider", code_lens_provider },
+                { "documentFormattingProvider", false },
+                { "documentRangeFormattingProvider", false },
+                { "documentOnTypeFormattingProvider", document_on_type_formatting_provider },
+                { "renameProvider", false },
+                { "documentLinkProvider", document_link_provider },
+                { "executeCommandProvider", execute_command_provider },
+                { "workspace", workspace },
+                { "experimental", {} }, }
+            }
+        };
+
+        json result_body{
+            { "id", id },
+            { "result", result }
+        };
+        return result_body;
+    } else if (method == "textDocument/didOpen") {
+        auto uri = string_field(body, { "params", "textDocument", "uri" });
+        auto text = string_field(body, { "params", "textDocument", "text" });
+        if (!uri || !text) {
+            return notification_error(appstate, method, !uri ? uri.error() : text.error());
+        }
+        int version = int_field_or(body, { "params", "textDocument", "version" }, 0);
+        appstate.core.open_document(*uri, *text, version);
+        appstate.snapshot_dirty = true;
+        if (!publish_diagnostics) {
+            return std::nullopt;
+        }
+        return diagnostics_notification(*uri, appstate);
+    } else if (method == "textDocument/didChange") {
+        auto uri = string_field(body, { "params", "textDocument", "uri" });
+        if (!uri) {
+            return notification_error(appstate, method, uri.error());
+        }
+        // Full sync: the first change holds the whole text.
+        const json* changes = find_field(body, { "params", "contentChanges" });
+        if (!changes || !changes->is_array() || changes->empty()) {
+            return notification_error(appstate, method,
+                { ErrorCode::InvalidParams, "Expected an array as params.contentChanges" });
+        }
+        auto change = string_field((*changes)[0], { "text" });
+        if (!change) {
+            return notification_error(appstate, method, change.error());
+        }
+        int version = int_field_or(body, { "params", "textDocument", "version" }, 0);
+        appstate.core.update_document(*uri, *change, version);
+        appstate.snapshot_dirty = true;
+        if (!publish_diagnostics) {
+            return std::nullopt;
+        }
+        return diagnostics_notification(*uri, appstate);
+    } else if (method == "textDocument/didClose") {
+        auto uri = string_field(body, { "params", "textDocument", "uri" });
+        if (!uri) {
+            return notification_error(appstate, method, uri.error());
+        }
+        appstate.core.close_document(*uri);
+        appstate.snapshot_dirty = true;
+        return std::nullopt;
+    } else if (method == "textDocument/completion") {
+        auto uri = string_field(body, { "params", "textDocument", "uri" });
+        auto line = int_field(body, { "params", "position", "line" });
+        auto character = int_field(body, { "params", "position", "character" });
+        if (!uri || !line || !character) {
+            return error_reply(id, !uri ? uri.error() : !line ? line.error() : character.error());
+        }
+
+        auto completion = appstate.core.complete(*uri, *line, *character);
+        if (!completion) {
+            return error_reply(id, completion.error());
+        }
+        json items = json::array();
+        for (const auto& item : *completion) {
+            // LSP CompletionItemKind.
+            int kind = 6;
+            if (item.kind == CompletionKind::Function) {
+                kind = 3;
+            } else if (item.kind == CompletionKind::Keyword) {
+                kind = 14;
+            } else if (item.kind == CompletionKind::Struct) {
+                kind = 22;
+            }
+            json entry{
+                { "label", item.label },
+                { "kind", kind },
+            };
+            if (!item.detail.empty()) {
+                entry["detail"] = item.detail;
+            }
+            if (!item.documentation.empty()) {
+                entry["documentation"] = {
+                    { "kind", "markdown" },
+                    { "value", item.documentation },
+                };
+            }
+            items.push_back(entry);
+        }
+        json result_body{
+            { "id", id },
+            { "result", items }
+        };
+        return result_body;
+    } else if (method == "textDocument/hover") {
+        auto uri = string_field(body, { "params", "textDocument", "uri" });
+        auto line = int_field(body, { "params", "position", "line" });
+        auto character = int_field(body, { "params", "position", "character" });
+        if (!uri || !line || !character) {
+            return error_reply(id, !uri ? uri.error() : !line ? line.error() : character.error());
+        }
+
+        auto hover = appstate.core.hover(*uri, *line, *character);
+        if (!hover) {
+            return error_reply(id, hover.error());
+        }
+        json result = nullptr;
+        if (const auto& info = *hover) {
+            result = {
+                { "contents", {
+                    { "kind", "markdown" },
+                    { "value", info->contents },
+                } },
+                { "range", {
+                    { "start", { { "line", info->line }, { "character", info->start_character } } },
+                    { "end", { { "line", info->line }, { "character", info->end_character } } },
+                } },
+            };
+        }
+        json result_body{
+            { "id", id },
+            { "result", result }
+        };
+        return result_body;
+    } else if (method == "textDocument/selectionRange") {
+        auto uri = string_field(body, { "params", "textDocument", "uri" });
+        if (!uri) {
+            return error_reply(id, uri.error());
+        }
+        const json* positions_field = find_field(body, { "params", "positions" });
+        if (!positions_field || !positions_field->is_array()) {
+            return error_reply(id, { ErrorCode::InvalidParams, "Expected an array as params.positions" });
+        }
+        std::vector<std::pair<int, int>> positions;
+        for (const auto& position : *positions_field) {
+            auto line = int_field(position, { "line" });
+            auto character = int_field(position, { "character" });
+            if (!line || !character) {
+                return error_reply(id, !line ? line.error() : character.error());
+            }
+            positions.emplace_back(*line, *character);
+        }
+
+        auto selection_ranges = appstate.core.selection_ranges(*uri, positions);
+        if (!selection_ranges) {
+            return error_reply(id, selection_ranges.error());
+        }
+
+        // Each SelectionRange nests its parent, so the ranges are chained
+        // from the outermost in.
+        json result = json::array();
+        for (const auto& ranges : *selection_ranges) {
+            json selection = nullptr;
+            for (auto it = ranges.rbegin(); it != ranges.rend(); ++it) {
+                json next{
+                    { "range", {
+                        { "start", { { "line", it->start_line }, { "character", it->start_character } } },
+                        { "end", { { "line", it->end_line }, { "character", it->end_character } } },
+                    } },
+                };
+                if (!selection.is_null()) {
+                    next["parent"] = std::move(selection);
+                }
+                selection = std::move(next);
+            }
+            result.push_back(std::move(selection));
+        }
+        json result_body{
+            { "id", id },
+            { "result", result }
+        };
+        return result_body;
+    } else if (method == "workspace/didChangeWorkspaceFolders") {
+        const json* event = find_field(body, { "params", "event" });
+        if (!event || !event->is_object()) {
+            return notification_error(appstate, method,
+                { ErrorCode::InvalidParams, "Expected an object as params.event" });
+        }
+        auto uris_of = [&](const char* change) {
+            std::vector<std::string> uris;
+            const json* folders = find_field(*event, { change });
+            for (const auto& folder : folders && folders->is_array() ? *folders : json::array()) {
+                if (auto uri = string_field(folder, { "uri" })) {
+                    uris.push_back(*uri);
+                }
+            }
+            return uris;
+        };
+        // Only the folders named are indexed or dropped from the index.
+        // Removed first, so that a folder both removed and added is reindexed.
+        std::set<std::string> affected;
+        for (const auto& uri : uris_of("removed")) {
+            if (appstate.core.remove_folder(uri)) {
+                auto documents = appstate.core.documents_in(uri);
+                affected.insert(documents.begin(), documents.end());
+            }
+        }
+        for (const auto& uri : uris_of("added")) {
+            add_workspace_folder(uri, appstate);
+            auto documents = appstate.core.documents_in(uri);
+            affected.insert(documents.begin(), documents.end());
+        }
+        // Open documents under those folders may now resolve their includes
+        // differently.
+        if (!publish_diagnostics || !appstate.push_notifications) {
+            return std::nullopt;
+        }
+        for (const auto& uri : affected) {
+            if (!appstate.outbound.push(diagnostics_notification(uri, appstate), message_buffer.encoding())
+                    && appstate.use_logfile) {
+                fmt::print(appstate.logfile_stream, "Outbound queue full, dropped a notification\n");
+            }
+        }
+        return std::nullopt;
+    } else if (method == "workspace/didChangeWatchedFiles") {
+        const json* changes = find_field(body, { "params", "changes" });
+        if (!changes || !changes->is_array()) {
+            return notification_error(appstate, method,
+                { ErrorCode::InvalidParams, "Expected an array as params.changes" });
+        }
+        // A branch switch changes many files at once; each folder is indexed
+        // again once, unchanged files coming from the summary cache.
+        std::set<std::string> folders;
+        for (const auto& change : *changes) {
+            if (auto uri = string_field(change, { "uri" })) {
+                if (auto folder = appstate.core.indexed_folder_of(*uri)) {
+                    folders.insert(*folder);
+                }
+            }
+        }
+        for (const auto& uri : folders) {
+            index_workspace_folder(uri, appstate);
+        }
+        return std::nullopt;
+    } else if (method == "workspace/symbol") {
+        auto query = string_field(body, { "params", "query" });
+        if (!query) {
+            return error_reply(id, query.error());
+        }
+        json result = json::array();
+        for (const auto& [uri, symbol] : appstate.core.workspace_symbols(*query)) {
+            // LSP SymbolKind.
+            int kind = 13;
+            if (symbol.kind == SymbolKind::Function) {
+                kind = 12;
+            } else if (symbol.kind == SymbolKind::Struct) {
+                kind = 23;
+            }
+            json position{ { "line", symbol.line }, { "character", symbol.character } };
+            json end{ { "line", symbol.line }, { "character", symbol.character + static_cast<int>(symbol.name.size()) } };
+            result.push_back({
+                { "name", symbol.name },
+                { "kind", kind },
+                { "location", {
+                    { "uri", uri },
+                    { "range", { { "start", position }, { "end", end } } },
+                } },
+            });
+        }
+        json result_body{
+            { "id", id },
+            { "result", result }
+        };
+        return result_body;
+    } else if (method == "glslls/profileDocument") {
+        auto uri = string_field(body, { "params", "textDocument", "uri" });
+        if (!uri) {
+            return error_reply(id, uri.error());
+        }
+        auto profile = appstate.core.profile(*uri);
+        if (!profile) {
+            return error_reply(id, profile.error());
+        }
+        json result = profile_to_json(*profile);
+        result["report"] = profile_report(*profile);
+        result["trace"] = profile_trace(*profile);
+        json result_body{
+            { "id", id },
+            { "result", result }
+        };
+        return result_body;
+    } else if (method == "glslls/stats") {
+        json result_body{
+            { "id", id },
+            { "result", get_stats(appstate) }
+        };
+        return result_body;
+    } else if (method == "shutdown") {
+        save_snapshot(appstate);
+        // Clients may kill the server once they have the reply, without
+        // waiting for it to exit and the logger to write what is queued.
+        appstate.logfile_stream.drain();
+        json result_body{
+            { "id", id },
+            { "result", nullptr }
+        };
+        return result_body;
+    }
+
+    // If the workspace has not yet been initialized but the client sends a
+    // message that doesn't have method "initialize" then we'll return an error
+    // as per LSP spec.
+    if (!appstate.core.is_initialized()) {
+        return error_reply(id, { ErrorCode::ServerNotInitialized, "Server not yet initialized." });
+    }
+
+    // If we don't know the method requested, we end up here.
+    if (!method.empty()) {
+        return error_reply(id, { ErrorCode::MethodNotFound, fmt::format("Method '{}' not supported.", method) });
+    }
+
+    // Responses to our own requests, if we made any, would land here too.
+    return error_reply(id, { ErrorCode::InvalidRequest, "Expected a method." });
+}
+
+static void log_response(AppState& appstate, const std::string& message, BodyEncoding encoding)
+{
+    if (!appstate.use_logfile || !appstate.verbose) {
+        return;
+    }
+    if (encoding == BodyEncoding::Json) {
+        fmt::print(appstate.logfile_stream, "<<< Sending message: \n{}\n\n", message);
+    } else {
+        fmt::print(appstate.logfile_stream, "<<< Sending {} byte message as {}\n\n", message.size(), content_type_of(encoding));
+    }
+}
+
+// Replies to a shed request, or lets a coalesced change through without its
+// diagnostics.
+static std::optional<json> shed_message(const MessageBuffer& message_buffer, AppState& appstate,
+    Admission admission)
+{
+    const json& body = message_buffer.body();
+    const std::string& method = method_of(body);
+    if (appstate.use_logfile) {
+        fmt::print(appstate.logfile_stream, "Overloaded, shed '{}' for {}\n", method, uri_of(body));
+    }
+    const json* id = find_field(body, { "id" });
+    if (admission == Admission::ContentModified) {
+        return error_reply(*id, { ErrorCode::ContentModified, "The document changed since the request." });
+    } else if (admission == Admission::ServerCancelled) {
+        return error_reply(*id, { ErrorCode::ServerCancelled, "Cancelled to keep up with newer requests." });
+    }
+    return handle_message(message_buffer, appstate, false);
+}
+
+void process_message(const MessageBuffer& message_buffer, AppState& appstate, Admission admission)
+{
+    const json& body = message_buffer.body();
+    appstate.watchdog.set_message(method_of(body), uri_of(body));
+    appstate.watchdog.set_phase("log");
+    if (appstate.use_logfile) {
+        fmt::print(appstate.logfile_stream, ">>> Received message of type '{}'\n", method_of(body));
+        if (appstate.verbose) {
+            fmt::print(appstate.logfile_stream, "Body: \n{}\n\n", dump_json(body, 4));
+        }
+    }
+
+    appstate.watchdog.set_phase("handle");
+    auto message = admission == Admission::Handle
+        ? handle_message(message_buffer, appstate)
+        : shed_message(message_buffer, appstate, admission);
+    if (message.has_value()) {
+        if (!appstate.outbound.push(std::move(message.value()), message_buffer.encoding())
+                && appstate.use_logfile) {
+            fmt::print(appstate.logfile_stream, "Outbound queue full, dropped a notification\n");
+        }
+    }
+    appstate.logfile_stream.flush();
+}
+
+void process_inbound(AppState& appstate)
+{
+    while (!appstate.exit_requested) {
+        auto next = appstate.inbound.pop();
+        if (!next.has_value()) {
+            return;
+        }
+        process_message(next->message, appstate, next->admission);
+    }
+}
+
+std::optional<std::string> next_frame(AppState& appstate, size_t max_size)
+{
+    for (;;) {
+        auto message = appstate.outbound.pop();
+        if (!message.has_value()) {
+            return std::nullopt;
+        }
+        appstate.watchdog.set_phase("serialize");
+        std::string frame = make_response(message->body, message->encoding);
+        if (frame.size() > max_size) {
+            if (appstate.use_logfile) {
+                fmt::print(appstate.logfile_stream, "Error: Dropped a {} byte message, the transport takes at most {}\n",
+                    frame.size(), max_size);
+            }
+            const json* id = find_field(message->body, { "id" });
+            if (!id) {
+                continue;
+            }
+            frame = make_response(error_reply(*id,
+                                      { ErrorCode::RequestFailed, "The result is too large for the transport." }),
+                message->encoding);
+            if (frame.size() > max_size) {
+                continue;
+            }
+        }
+        appstate.watchdog.set_phase("log");
+        log_response(appstate, frame, message->encoding);
+        return frame;
+    }
+}
+
+void ev_handler(struct mg_connection* c, int ev, void* p)
+{
+    AppState& appstate = *static_cast<AppState*>(c->mgr->user_data);
+
+    if (ev == MG_EV_POLL) {
+        WatchedIteration iteration(appstate.watchdog, "snapshot");
+        maybe_save_snapshot(appstate);
+        maybe_reindex(appstate);
+    } else if (ev == MG_EV_HTTP_REQUEST) {
+        WatchedIteration iteration(appstate.watchdog, "read");
+        struct http_message* hm = (struct http_message*)p;
+
+        std::string content(hm->message.p, hm->message.len);
+
+        MessageBuffer message_buffer;
+        message_buffer.handle_string(content);
+
+        if (message_buffer.message_completed()) {
+            const json& body = message_buffer.body();
+            appstate.watchdog.set_message(method_of(body), uri_of(body));
+            appstate.watchdog.set_phase("log");
+            if (appstate.use_logfile) {
+                fmt::print(appstate.logfile_stream, ">>> Received message of type '{}'\n", method_of(body));
+                if (appstate.verbose) {
+                    fmt::print(appstate.logfile_stream, "Headers:\n");
+                    for (auto elem : message_buffer.headers()) {
+                        auto pretty_header = fmt::format("{}: {}\n", elem.first, elem.second);
+                        appstate.logfile_stream << pretty_header;
+                    }
+                    fmt::print(appstate.logfile_stream, "Body: \n{}\n\n", dump_json(body, 4));
+                    if (message_buffer.encoding() == BodyEncoding::Json) {
+                        fmt::print(appstate.logfile_stream, "Raw: \n{}\n\n", message_buffer.raw());
+                    }
+                }
+            }
+
+            appstate.watchdog.set_phase("handle");
+            auto message = handle_message(message_buffer, appstate);
+            if (message.has_value()) {
+                appstate.watchdog.set_phase("serialize");
+                std::string response = make_response(message.value(), message_buffer.encoding());
+                auto content_type = fmt::format("Content-Type: {}", content_type_of(message_buffer.encoding()));
+                appstate.watchdog.set_phase("write");
+                mg_send_head(c, 200, response.length(), content_type.c_str());
+                mg_send(c, response.data(), static_cast<int>(response.length()));
+                appstate.watchdog.set_phase("log");
+                log_response(appstate, response, message_buffer.encoding());
+            }
+            appstate.logfile_stream.flush();
+            message_buffer.clear();
+        }
+    }
+}
+
@@ -0,0 +1,104 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "nlohmann/json.hpp"
+
+#include "allocator.hpp"
+#include "core.hpp"
+#include "inboundqueue.hpp"
+#include "logger.hpp"
+#include "messagebuffer.hpp"
+#include "outboundqueue.hpp"
+#include "watchdog.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+
+using json = nlohmann::json;
+
+struct mg_connection;
+
+struct AppState {
+    AppState();
+
+    // Background tasks of the core log too, so the log outlives it.
+    bool verbose = false;
+    bool use_logfile = false;
+    AsyncLogger logfile_stream;
+
+    Core core;
+
+    // Messages for the stream based transports, waiting to be handled and
+    // waiting to be written.
+    InboundQueue inbound;
+    OutboundQueue outbound;
+    // Set by those transports. Notifications other than the reply to a
+    // message, which nothing else would write, are only queued then.
+    bool push_notifications = false;
+
+    // Reports iterations of the I/O loop that take too long. Destroyed
+    // before the log it writes to.
+    StallWatchdog watchdog;
+
+    // Client supplied initializationOptions.
+    json config = json::object();
+
+    // The state is snapshotted every `snapshot_interval` while it is dirty,
+    // and on shutdown. An empty path disables snapshots.
+    std::string snapshot_path;
+    std::chrono::seconds snapshot_interval{ 30 };
+    std::chrono::steady_clock::time_point last_snapshot;
+    bool snapshot_dirty = false;
+
+    // How often the git indexes of indexed folders are checked for changes.
+    std::chrono::seconds index_check_interval{ 5 };
+    std::chrono::steady_clock::time_point last_index_check;
+
+    // Set once the client sent the "exit" notification.
+    bool exit_requested = false;
+
+    // Set by executables built with the slab allocator, which glslls/stats
+    // then reports on.
+    std::function<AllocatorStats()> allocator_stats;
+};
+
+std::string make_response(const json& response, BodyEncoding encoding = BodyEncoding::Json);
+
+// Analyzes `uri` if needed and returns its diagnostics as LSP Diagnostic[].
+json get_diagnostics(const std::string& uri, AppState& appstate);
+
+// Returns the response or notification to send back, if any, without the
+// "jsonrpc" member. Malformed messages and invalid params get an error reply
+// (or, for notifications, are logged and dropped); nothing throws. Without
+// `publish_diagnostics`, document changes are applied but not analyzed.
+std::optional<json> handle_message(const MessageBuffer& message_buffer, AppState& appstate,
+    bool publish_diagnostics = true);
+
+// Logs a completed message, handles it as admitted and queues the response,
+// if any, on appstate.outbound.
+void process_message(const MessageBuffer& message_buffer, AppState& appstate,
+    Admission admission = Admission::Handle);
+
+// Processes the messages on appstate.inbound in order. Used by the stream
+// based transports, which queue everything they read before processing it.
+void process_inbound(AppState& appstate);
+
+// Encodes the next queued outbound message into a frame. A response that
+// would be larger than `max_size` is replaced by an error reply for its id;
+// such notifications are dropped.
+std::optional<std::string> next_frame(AppState& appstate, size_t max_size = SIZE_MAX);
+
+void maybe_save_snapshot(AppState& appstate);
+
+// Indexes the folders whose git index changed again, at most every
+// appstate.index_check_interval.
+void maybe_reindex(AppState& appstate);
+
+// Mongoose event handler for the HTTP transport. Expects the AppState as the
+// manager's user data.
+void ev_handler(struct mg_connection* c, int ev, void* p);
+
+#endif /* SERVER_H */
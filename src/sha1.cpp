@@ -0,0 +1,139 @@
+#include "sha1.hpp"
+#include "text.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static uint32_t rotate_left(uint32_t value, int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+Sha1::Sha1()
+    : m_state{ 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 }
+{
+}
+
+void Sha1::update(const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    m_length += size;
+    if (m_block_size > 0) {
+        size_t taken = std::min(size, sizeof(m_block) - m_block_size);
+        std::memcpy(m_block + m_block_size, bytes, taken);
+        m_block_size += taken;
+        bytes += taken;
+        size -= taken;
+        if (m_block_size < sizeof(m_block)) {
+            return;
+        }
+        process_block(m_block);
+        m_block_size = 0;
+    }
+    for (; size >= sizeof(m_block); bytes += sizeof(m_block), size -= sizeof(m_block)) {
+        process_block(bytes);
+    }
+    std::memcpy(m_block, bytes, size);
+    m_block_size = size;
+}
+
+Sha1Digest Sha1::finish()
+{
+    uint64_t bits = m_length * 8;
+    const uint8_t padding = 0x80;
+    update(&padding, 1);
+    const uint8_t zero = 0;
+    while (m_block_size != 56) {
+        update(&zero, 1);
+    }
+    uint8_t length[8];
+    for (int i = 0; i < 8; ++i) {
+        length[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    }
+    update(length, sizeof(length));
+
+    Sha1Digest digest;
+    for (int i = 0; i < 20; ++i) {
+        digest[i] = static_cast<uint8_t>(m_state[i / 4] >> (24 - 8 * (i % 4)));
+    }
+    return digest;
+}
+
+void Sha1::process_block(const uint8_t* block)
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = static_cast<uint32_t>(block[4 * i]) << 24 | static_cast<uint32_t>(block[4 * i + 1]) << 16
+            | static_cast<uint32_t>(block[4 * i + 2]) << 8 | block[4 * i + 3];
+    }
+    for (int i = 16; i < 80; ++i) {
+        w[i] = rotate_left(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3], e = m_state[4];
+    for (int i = 0; i < 80; ++i) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        uint32_t t = rotate_left(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotate_left(b, 30);
+        b = a;
+        a = t;
+    }
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+    m_state[4] += e;
+}
+
+Sha1Digest git_blob_id(std::string_view content)
+{
+    std::string header = "blob " + std::to_string(content.size());
+    Sha1 sha1;
+    sha1.update(header.c_str(), header.size() + 1);
+    sha1.update(content.data(), content.size());
+    return sha1.finish();
+}
+
+std::string to_hex(const Sha1Digest& digest)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(2 * digest.size());
+    for (uint8_t byte : digest) {
+        hex += digits[byte >> 4];
+        hex += digits[byte & 15];
+    }
+    return hex;
+}
+
+bool from_hex(std::string_view hex, Sha1Digest& digest)
+{
+    if (hex.size() != 2 * digest.size()) {
+        return false;
+    }
+    auto value = [](char c) {
+        return is_digit(c) ? c - '0' : to_lower(c) - 'a' + 10;
+    };
+    for (size_t i = 0; i < digest.size(); ++i) {
+        if (!is_hex_digit(hex[2 * i]) || !is_hex_digit(hex[2 * i + 1])) {
+            return false;
+        }
+        digest[i] = static_cast<uint8_t>(value(hex[2 * i]) * 16 + value(hex[2 * i + 1]));
+    }
+    return true;
+}
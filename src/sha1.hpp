@@ -0,0 +1,39 @@
+#ifndef SHA1_H
+#define SHA1_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using Sha1Digest = std::array<uint8_t, 20>;
+
+// SHA-1, as git uses it to name objects. Not for anything security related.
+class Sha1
+{
+
+public:
+    Sha1();
+
+    void update(const void* data, size_t size);
+    Sha1Digest finish();
+
+private:
+    void process_block(const uint8_t* block);
+
+    uint32_t m_state[5];
+    uint64_t m_length = 0;
+    uint8_t m_block[64];
+    size_t m_block_size = 0;
+};
+
+// The id git gives a blob with this content: the SHA-1 of "blob <size>\0"
+// followed by the content.
+Sha1Digest git_blob_id(std::string_view content);
+
+std::string to_hex(const Sha1Digest& digest);
+// Fails on anything but 40 hex digits.
+bool from_hex(std::string_view hex, Sha1Digest& digest);
+
+#endif /* SHA1_H */
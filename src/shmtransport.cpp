@@ -0,0 +1,325 @@
+#include "shmtransport.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const uint32_t shm_magic = 0x676c736d;
+
+// How often a reader polls an empty ring before going to sleep. Spinning for
+// a little while keeps the latency of back-to-back messages in the
+// microseconds without burning a core when idle.
+static const int spin_limit = 2000;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared atomics must be lock free");
+
+// Positions are byte offsets that only ever grow; they are reduced modulo the
+// capacity when indexing. Producer and consumer state live on separate cache
+// lines.
+struct ShmRingHeader {
+    alignas(64) std::atomic<uint64_t> head;
+    std::atomic<uint32_t> written;
+    std::atomic<uint32_t> writer_waiting;
+
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> consumed;
+    std::atomic<uint32_t> reader_waiting;
+};
+
+struct ShmSegment {
+    uint32_t magic;
+    uint32_t capacity;
+    ShmRingHeader to_server;
+    ShmRingHeader to_client;
+
+    // Followed by the data of to_server, then by the data of to_client.
+};
+
+static void futex_wait(std::atomic<uint32_t>* word, uint32_t expected, int timeout_ms)
+{
+    timespec timeout;
+    timespec* timeout_ptr = nullptr;
+    if (timeout_ms >= 0) {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        timeout_ptr = &timeout;
+    }
+    // Not FUTEX_PRIVATE_FLAG: the word is shared with another process.
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, timeout_ptr, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t>* word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static std::string shm_object_name(const std::string& name)
+{
+    return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+
+ShmRing::ShmRing(ShmRingHeader* header, char* data, uint32_t capacity)
+    : m_header(header)
+    , m_data(data)
+    , m_capacity(capacity)
+{
+}
+
+bool ShmRing::write(const char* data, uint32_t size, int timeout_ms)
+{
+    const uint64_t needed = sizeof(uint32_t) + static_cast<uint64_t>(size);
+    if (m_broken || needed > m_capacity) {
+        return false;
+    }
+    using clock = std::chrono::steady_clock;
+    const auto deadline = clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+
+    // The reader can write anything to the segment: a tail ahead of the head
+    // or more than the capacity behind it gives the ring up.
+    const uint64_t head = m_header->head.load(std::memory_order_relaxed);
+    auto free_space = [&]() -> uint64_t {
+        const uint64_t used = head - m_header->tail.load(std::memory_order_acquire);
+        if (used > m_capacity) {
+            m_broken = true;
+            return 0;
+        }
+        return m_capacity - used;
+    };
+    while (free_space() < needed) {
+        if (m_broken) {
+            return false;
+        }
+        int wait_ms = 100;
+        if (timeout_ms >= 0) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now());
+            if (remaining.count() <= 0) {
+                m_broken = true;
+                return false;
+            }
+            wait_ms = static_cast<int>(std::min<int64_t>(remaining.count(), wait_ms));
+        }
+
+        // Announce that we are about to sleep before checking one last time,
+        // so that the reader can't miss us.
+        uint32_t consumed = m_header->consumed.load();
+        m_header->writer_waiting.store(1);
+        if (free_space() < needed && !m_broken) {
+            futex_wait(&m_header->consumed, consumed, wait_ms);
+        }
+        m_header->writer_waiting.store(0, std::memory_order_relaxed);
+    }
+
+    copy_in(head, reinterpret_cast<const char*>(&size), sizeof(size));
+    copy_in(head + sizeof(size), data, size);
+    m_header->head.store(head + needed);
+    m_header->written.fetch_add(1);
+    if (m_header->reader_waiting.load()) {
+        futex_wake(&m_header->written);
+    }
+    return true;
+}
+
+bool ShmRing::read(std::string& frame, int timeout_ms)
+{
+    if (m_broken) {
+        return false;
+    }
+    using clock = std::chrono::steady_clock;
+    const auto deadline = clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+
+    const uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+    for (int spins = 0; m_header->head.load(std::memory_order_acquire) == tail; ++spins) {
+        if (spins < spin_limit) {
+            continue;
+        }
+
+        int wait_ms = -1;
+        if (timeout_ms >= 0) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now());
+            if (remaining.count() <= 0) {
+                return false;
+            }
+            wait_ms = static_cast<int>(remaining.count());
+        }
+
+        uint32_t written = m_header->written.load();
+        m_header->reader_waiting.store(1);
+        if (m_header->head.load() == tail) {
+            futex_wait(&m_header->written, written, wait_ms);
+        }
+        m_header->reader_waiting.store(0, std::memory_order_relaxed);
+    }
+
+    // The other process can write anything to the segment: a frame must lie
+    // within what was published and fit in the ring, or the ring is given up.
+    const uint64_t available = m_header->head.load(std::memory_order_acquire) - tail;
+    if (available < sizeof(uint32_t) || available > m_capacity) {
+        m_broken = true;
+        return false;
+    }
+    uint32_t size;
+    copy_out(tail, reinterpret_cast<char*>(&size), sizeof(size));
+    if (size > available - sizeof(size) || size > m_capacity - sizeof(size)) {
+        m_broken = true;
+        return false;
+    }
+    frame.resize(size);
+    copy_out(tail + sizeof(size), &frame[0], size);
+
+    m_header->tail.store(tail + sizeof(size) + size);
+    m_header->consumed.fetch_add(1);
+    if (m_header->writer_waiting.load()) {
+        futex_wake(&m_header->consumed);
+    }
+    return true;
+}
+
+bool ShmRing::broken() const
+{
+    return m_broken;
+}
+
+uint32_t ShmRing::max_frame_size() const
+{
+    return m_capacity - sizeof(uint32_t);
+}
+
+void ShmRing::copy_in(uint64_t pos, const char* data, uint32_t size)
+{
+    uint32_t offset = pos & (m_capacity - 1);
+    uint32_t first = std::min(size, m_capacity - offset);
+    std::memcpy(m_data + offset, data, first);
+    std::memcpy(m_data, data + first, size - first);
+}
+
+void ShmRing::copy_out(uint64_t pos, char* data, uint32_t size) const
+{
+    uint32_t offset = pos & (m_capacity - 1);
+    uint32_t first = std::min(size, m_capacity - offset);
+    std::memcpy(data, m_data + offset, first);
+    std::memcpy(data + first, m_data, size - first);
+}
+
+std::unique_ptr<ShmTransport> ShmTransport::create(const std::string& name, uint32_t capacity)
+{
+    uint32_t rounded = 4096;
+    while (rounded < capacity && rounded < (1u << 30)) {
+        rounded <<= 1;
+    }
+    const size_t size = sizeof(ShmSegment) + 2 * static_cast<size_t>(rounded);
+
+    // A segment left behind by a server that crashed is simply replaced.
+    auto object_name = shm_object_name(name);
+    shm_unlink(object_name.c_str());
+    int fd = shm_open(object_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+        return nullptr;
+    }
+    if (ftruncate(fd, size) == -1) {
+        close(fd);
+        shm_unlink(object_name.c_str());
+        return nullptr;
+    }
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        shm_unlink(object_name.c_str());
+        return nullptr;
+    }
+
+    auto segment = new (memory) ShmSegment{};
+    segment->capacity = rounded;
+    std::atomic_thread_fence(std::memory_order_release);
+    segment->magic = shm_magic;
+
+    return std::unique_ptr<ShmTransport>(new ShmTransport(object_name, segment, size, true));
+}
+
+std::unique_ptr<ShmTransport> ShmTransport::open(const std::string& name)
+{
+    auto object_name = shm_object_name(name);
+    int fd = shm_open(object_name.c_str(), O_RDWR, 0600);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(ShmSegment)) {
+        close(fd);
+        return nullptr;
+    }
+    const size_t size = st.st_size;
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+
+    auto segment = static_cast<ShmSegment*>(memory);
+    if (segment->magic != shm_magic || sizeof(ShmSegment) + 2 * static_cast<size_t>(segment->capacity) > size) {
+        munmap(memory, size);
+        return nullptr;
+    }
+
+    return std::unique_ptr<ShmTransport>(new ShmTransport(object_name, segment, size, false));
+}
+
+ShmTransport::ShmTransport(const std::string& name, ShmSegment* segment, size_t size, bool owner)
+    : m_name(name)
+    , m_segment(segment)
+    , m_size(size)
+    , m_owner(owner)
+{
+    char* data = reinterpret_cast<char*>(segment) + sizeof(ShmSegment);
+    auto to_server = std::make_unique<ShmRing>(&segment->to_server, data, segment->capacity);
+    auto to_client = std::make_unique<ShmRing>(&segment->to_client, data + segment->capacity, segment->capacity);
+    if (owner) {
+        m_incoming = std::move(to_server);
+        m_outgoing = std::move(to_client);
+    } else {
+        m_incoming = std::move(to_client);
+        m_outgoing = std::move(to_server);
+    }
+}
+
+ShmTransport::~ShmTransport()
+{
+    munmap(m_segment, m_size);
+    if (m_owner) {
+        shm_unlink(m_name.c_str());
+    }
+}
+
+bool ShmTransport::send(const std::string& frame, int timeout_ms)
+{
+    if (frame.size() > max_frame_size()) {
+        return false;
+    }
+    return m_outgoing->write(frame.data(), static_cast<uint32_t>(frame.size()), timeout_ms);
+}
+
+bool ShmTransport::receive(std::string& frame, int timeout_ms)
+{
+    return m_incoming->read(frame, timeout_ms);
+}
+
+bool ShmTransport::broken() const
+{
+    return m_incoming->broken() || m_outgoing->broken();
+}
+
+size_t ShmTransport::max_frame_size() const
+{
+    return m_outgoing->max_frame_size();
+}
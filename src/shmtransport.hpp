@@ -0,0 +1,81 @@
+#ifndef SHMTRANSPORT_H
+#define SHMTRANSPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+struct ShmSegment;
+struct ShmRingHeader;
+
+// One direction of a shared memory transport: a lock-free single-producer,
+// single-consumer ring of length-prefixed frames. Readers block on a futex in
+// the shared segment, so no file descriptors have to be passed around.
+class ShmRing
+{
+
+public:
+    ShmRing(ShmRingHeader* header, char* data, uint32_t capacity);
+
+    // Waits up to `timeout_ms` (-1 for ever) while the ring is full. Fails
+    // for frames that can never fit, and without waiting once the ring is
+    // broken. A reader not making room in time breaks it.
+    bool write(const char* data, uint32_t size, int timeout_ms);
+
+    // Waits up to `timeout_ms` (-1 for ever) for a frame. Fails without
+    // waiting once the ring is broken.
+    bool read(std::string& frame, int timeout_ms);
+
+    // Whether a frame or position was found inconsistent with the ring's
+    // capacity, or the reader stopped reading, from which there is no
+    // recovering.
+    bool broken() const;
+
+    // The largest frame that fits.
+    uint32_t max_frame_size() const;
+
+private:
+    void copy_in(uint64_t pos, const char* data, uint32_t size);
+    void copy_out(uint64_t pos, char* data, uint32_t size) const;
+
+    ShmRingHeader* m_header;
+    char* m_data;
+    uint32_t m_capacity;
+    bool m_broken = false;
+};
+
+// A pair of rings in a POSIX shared memory segment, one per direction. The
+// server creates the segment, a co-located client opens it by name.
+class ShmTransport
+{
+
+public:
+    // `capacity` is the size of each ring in bytes and is rounded up to a
+    // power of two. Returns nullptr on failure.
+    static std::unique_ptr<ShmTransport> create(const std::string& name, uint32_t capacity);
+    static std::unique_ptr<ShmTransport> open(const std::string& name);
+
+    virtual ~ShmTransport();
+
+    ShmTransport(const ShmTransport&) = delete;
+    ShmTransport& operator=(const ShmTransport&) = delete;
+
+    bool send(const std::string& frame, int timeout_ms);
+    bool receive(std::string& frame, int timeout_ms);
+    // Whether either ring is broken; the transport should be closed.
+    bool broken() const;
+    size_t max_frame_size() const;
+
+private:
+    ShmTransport(const std::string& name, ShmSegment* segment, size_t size, bool owner);
+
+    std::string m_name;
+    ShmSegment* m_segment;
+    size_t m_size;
+    bool m_owner;
+    std::unique_ptr<ShmRing> m_outgoing;
+    std::unique_ptr<ShmRing> m_incoming;
+};
+
+#endif /* SHMTRANSPORT_H */
@@ -0,0 +1,413 @@
+#include "snapshot.hpp"
+#include "jsonfields.hpp"
+#include "scopetree.hpp"
+#include "text.hpp"
+
+#include <experimental/filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace fs = std::experimental::filesystem;
+
+// Bump whenever the layout below changes; older snapshots are ignored.
+static const int snapshot_format = 5;
+
+struct FileStamp {
+    int64_t mtime = 0;
+    uint64_t size = 0;
+};
+
+AnalysisKey analysis_key(const std::string& uri, uint64_t hash)
+{
+    auto stage = find_language(uri);
+    return { stage ? static_cast<int>(*stage) : -1, hash };
+}
+
+// Snapshots are read back from disk and may be truncated or edited, so every
+// field is checked before it is used: reading never throws.
+static bool read_value(const json& value, int& out)
+{
+    if (!is_int(value)) {
+        return false;
+    }
+    out = value.get<int>();
+    return true;
+}
+
+static bool read_value(const json& value, int64_t& out)
+{
+    if (!value.is_number_integer()) {
+        return false;
+    }
+    out = value.get<int64_t>();
+    return true;
+}
+
+static bool read_value(const json& value, uint64_t& out)
+{
+    if (!value.is_number_unsigned()) {
+        return false;
+    }
+    out = value.get<uint64_t>();
+    return true;
+}
+
+static bool read_value(const json& value, bool& out)
+{
+    if (!value.is_boolean()) {
+        return false;
+    }
+    out = value.get<bool>();
+    return true;
+}
+
+static bool read_value(const json& value, std::string& out)
+{
+    if (!value.is_string()) {
+        return false;
+    }
+    out = value.get<std::string>();
+    return true;
+}
+
+template <typename T>
+static bool read_at(const json& array, size_t index, T& out)
+{
+    return array.is_array() && index < array.size() && read_value(array[index], out);
+}
+
+template <typename T>
+static bool read_key(const json& object, const char* key, T& out)
+{
+    if (!object.is_object()) {
+        return false;
+    }
+    auto it = object.find(key);
+    return it != object.end() && read_value(*it, out);
+}
+
+// The array under `key`, or nullptr.
+static const json* array_at(const json& object, const char* key)
+{
+    if (!object.is_object()) {
+        return nullptr;
+    }
+    auto it = object.find(key);
+    return it != object.end() && it->is_array() ? &*it : nullptr;
+}
+
+static json diagnostic_to_json(const Diagnostic& diagnostic)
+{
+    return {
+        diagnostic.line,
+        diagnostic.start_character,
+        diagnostic.end_character,
+        diagnostic.severity,
+        diagnostic.severity_name,
+        diagnostic.message,
+    };
+}
+
+static bool diagnostic_from_json(const json& entry, Diagnostic& diagnostic)
+{
+    return read_at(entry, 0, diagnostic.line)
+        && read_at(entry, 1, diagnostic.start_character)
+        && read_at(entry, 2, diagnostic.end_character)
+        && read_at(entry, 3, diagnostic.severity)
+        && read_at(entry, 4, diagnostic.severity_name)
+        && read_at(entry, 5, diagnostic.message);
+}
+
+static json symbol_to_json(const SymbolOccurrence& symbol)
+{
+    return {
+        symbol.name,
+        symbol.type,
+        static_cast<int>(symbol.kind),
+        symbol.line,
+        symbol.character,
+    };
+}
+
+static bool symbol_from_json(const json& entry, SymbolOccurrence& symbol)
+{
+    int kind;
+    if (!read_at(entry, 2, kind) || kind < 0 || kind > static_cast<int>(SymbolKind::Struct)) {
+        return false;
+    }
+    symbol.kind = static_cast<SymbolKind>(kind);
+    return read_at(entry, 0, symbol.name)
+        && read_at(entry, 1, symbol.type)
+        && read_at(entry, 3, symbol.line)
+        && read_at(entry, 4, symbol.character);
+}
+
+static json scope_to_json(const Scope& scope)
+{
+    json declarations = json::array();
+    for (const auto& declaration : scope.declarations) {
+        declarations.push_back(symbol_to_json(declaration));
+    }
+    return {
+        static_cast<int>(scope.kind),
+        scope.parent,
+        scope.start_line,
+        scope.start_character,
+        scope.end_line,
+        scope.end_character,
+        scope.hash,
+        declarations,
+    };
+}
+
+// Children aren't stored; they are linked back from the parents. Returns
+// nullptr for malformed scopes.
+static std::shared_ptr<const ScopeTree> scopes_from_json(const json& entry)
+{
+    if (!entry.is_array()) {
+        return nullptr;
+    }
+    auto tree = std::make_shared<ScopeTree>();
+    for (const auto& item : entry) {
+        Scope scope;
+        int kind;
+        if (!read_at(item, 0, kind) || kind < 0 || kind > static_cast<int>(ScopeKind::Loop)) {
+            return nullptr;
+        }
+        scope.kind = static_cast<ScopeKind>(kind);
+        if (!read_at(item, 1, scope.parent) || !read_at(item, 2, scope.start_line)
+            || !read_at(item, 3, scope.start_character) || !read_at(item, 4, scope.end_line)
+            || !read_at(item, 5, scope.end_character) || !read_at(item, 6, scope.hash)
+            || item.size() < 8 || !item[7].is_array()) {
+            return nullptr;
+        }
+        for (const auto& declaration : item[7]) {
+            SymbolOccurrence symbol;
+            if (!symbol_from_json(declaration, symbol)) {
+                return nullptr;
+            }
+            scope.declarations.push_back(std::move(symbol));
+        }
+        // Parents come before their children.
+        if (scope.parent >= static_cast<int>(tree->scopes.size()) || (scope.parent < 0) != tree->scopes.empty()) {
+            return nullptr;
+        }
+        if (scope.parent >= 0) {
+            tree->scopes[scope.parent].children.push_back(static_cast<int>(tree->scopes.size()));
+        }
+        tree->scopes.push_back(std::move(scope));
+    }
+    return tree;
+}
+
+static json analysis_to_json(const Analysis& analysis)
+{
+    json diagnostics = json::array();
+    for (const auto& diagnostic : analysis.diagnostics) {
+        diagnostics.push_back(diagnostic_to_json(diagnostic));
+    }
+    json symbols = json::array();
+    for (const auto& symbol : analysis.symbols) {
+        symbols.push_back(symbol_to_json(symbol));
+    }
+    json scopes = json::array();
+    if (analysis.scopes) {
+        for (const auto& scope : analysis.scopes->scopes) {
+            scopes.push_back(scope_to_json(scope));
+        }
+    }
+    return {
+        { "hash", analysis.hash },
+        { "parsed", analysis.parsed },
+        { "info_log", analysis.info_log },
+        { "diagnostics", diagnostics },
+        { "symbols", symbols },
+        { "scopes", scopes },
+    };
+}
+
+// Returns nullptr for malformed analyses.
+static std::shared_ptr<const Analysis> analysis_from_json(const json& entry)
+{
+    auto analysis = std::make_shared<Analysis>();
+    const json* diagnostics = array_at(entry, "diagnostics");
+    const json* symbols = array_at(entry, "symbols");
+    const json* scopes = array_at(entry, "scopes");
+    if (!read_key(entry, "hash", analysis->hash) || !read_key(entry, "parsed", analysis->parsed)
+        || !read_key(entry, "info_log", analysis->info_log) || !diagnostics || !symbols || !scopes) {
+        return nullptr;
+    }
+    for (const auto& item : *diagnostics) {
+        Diagnostic diagnostic;
+        if (!diagnostic_from_json(item, diagnostic)) {
+            return nullptr;
+        }
+        analysis->diagnostics.push_back(std::move(diagnostic));
+    }
+    for (const auto& item : *symbols) {
+        SymbolOccurrence symbol;
+        if (!symbol_from_json(item, symbol)) {
+            return nullptr;
+        }
+        analysis->symbols.push_back(std::move(symbol));
+    }
+    analysis->scopes = scopes_from_json(*scopes);
+    if (!analysis->scopes) {
+        return nullptr;
+    }
+    return analysis;
+}
+
+static std::optional<FileStamp> stat_document(const std::string& uri)
+{
+    auto path = uri_to_path(uri);
+    if (path.empty()) {
+        return std::nullopt;
+    }
+
+    std::error_code ec;
+    FileStamp stamp;
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    stamp.mtime = mtime.time_since_epoch().count();
+    stamp.size = fs::file_size(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return stamp;
+}
+
+bool write_snapshot(const std::string& path, const Workspace& workspace, const AnalysisCache& cache)
+{
+    json documents = json::array();
+    json analyses = json::array();
+    for (const auto& [uri, document] : workspace.documents()) {
+        json entry{
+            { "uri", uri },
+            { "hash", document.hash },
+            { "text", document.text },
+        };
+        if (auto stamp = stat_document(uri)) {
+            entry["mtime"] = stamp->mtime;
+            entry["size"] = stamp->size;
+        }
+        documents.push_back(entry);
+
+        AnalysisKey key = analysis_key(uri, document.hash);
+        auto cached = cache.find(key);
+        if (cached != cache.end()) {
+            json analysis = analysis_to_json(*cached->second);
+            analysis["stage"] = key.first;
+            analyses.push_back(std::move(analysis));
+        }
+    }
+
+    json snapshot{
+        { "format", snapshot_format },
+        { "documents", documents },
+        { "analyses", analyses },
+    };
+    auto bytes = json::to_cbor(snapshot);
+
+    // Write next to the destination and rename, so that a crash while writing
+    // never leaves a truncated snapshot behind.
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        if (!out) {
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmp_path, path, ec);
+    return !ec;
+}
+
+std::optional<RestoredSnapshot> restore_snapshot(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return std::nullopt;
+    }
+    std::vector<uint8_t> bytes{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+
+    // Everything is read and checked before anything is restored: a
+    // snapshot with any malformed part is discarded as a whole.
+    json snapshot = json::from_cbor(bytes, true, false);
+    int format = 0;
+    if (snapshot.is_discarded() || !read_key(snapshot, "format", format) || format != snapshot_format) {
+        return std::nullopt;
+    }
+    const json* analyses = array_at(snapshot, "analyses");
+    const json* documents = array_at(snapshot, "documents");
+    if (!analyses || !documents) {
+        return std::nullopt;
+    }
+
+    RestoredSnapshot restored;
+    for (const auto& entry : *analyses) {
+        int stage;
+        auto analysis = analysis_from_json(entry);
+        if (!analysis || !read_key(entry, "stage", stage)) {
+            return std::nullopt;
+        }
+        restored.analyses[{ stage, analysis->hash }] = analysis;
+    }
+
+    struct SavedDocument {
+        std::string uri;
+        std::string text;
+        uint64_t hash = 0;
+        std::optional<FileStamp> stamp;
+    };
+    std::vector<SavedDocument> saved;
+    for (const auto& entry : *documents) {
+        SavedDocument document;
+        if (!read_key(entry, "uri", document.uri) || !read_key(entry, "text", document.text)
+            || !read_key(entry, "hash", document.hash)) {
+            return std::nullopt;
+        }
+        if (entry.count("mtime")) {
+            FileStamp stamp;
+            if (!read_key(entry, "mtime", stamp.mtime) || !read_key(entry, "size", stamp.size)) {
+                return std::nullopt;
+            }
+            document.stamp = stamp;
+        }
+        saved.push_back(std::move(document));
+    }
+
+    for (auto& document : saved) {
+        // A document whose text doesn't hash to the recorded value was
+        // corrupted somewhere; the client will send it again anyway.
+        if (hash_string(document.text) != document.hash) {
+            continue;
+        }
+        if (restored.analyses.count(analysis_key(document.uri, document.hash)) == 0) {
+            restored.stale_documents.emplace_back(document.uri, document.text);
+        }
+
+        // The saved text may hold edits the client never saved and opens
+        // again with, so its analysis is kept. But if the backing file was
+        // touched, the client may open the file's content instead.
+        auto stamp = stat_document(document.uri);
+        bool touched = stamp.has_value() && document.stamp.has_value()
+            && (stamp->mtime != document.stamp->mtime || stamp->size != document.stamp->size);
+        if (touched) {
+            std::ifstream file(uri_to_path(document.uri), std::ios::binary);
+            std::string disk_text{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+            if (file && restored.analyses.count(analysis_key(document.uri, hash_string(disk_text))) == 0) {
+                restored.stale_documents.emplace_back(document.uri, std::move(disk_text));
+            }
+        }
+    }
+
+    return restored;
+}
@@ -0,0 +1,52 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "nlohmann/json.hpp"
+
+#include "analysis.hpp"
+#include "workspace.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+using json = nlohmann::json;
+
+// A shader's analysis depends on its stage, given by the extension of its
+// URI, as much as on its content: the same text opened as .vert and as .frag
+// has two analyses. Of the stage, or -1 for URIs of no stage, and of
+// Document::hash.
+using AnalysisKey = std::pair<int, uint64_t>;
+
+AnalysisKey analysis_key(const std::string& uri, uint64_t hash);
+
+// Analyses already computed for a document content.
+using AnalysisCache = std::map<AnalysisKey, std::shared_ptr<const Analysis>>;
+
+struct RestoredSnapshot {
+    // Analyses of the documents open when the snapshot was taken, for when
+    // the client opens them again.
+    AnalysisCache analyses;
+
+    // Documents whose analysis has to be recomputed, with the text to analyze:
+    // those the snapshot has no analysis of, with their saved text, and those
+    // whose file changed since, with the file's text.
+    std::vector<std::pair<std::string, std::string>> stale_documents;
+};
+
+// Writes the open documents and the analyses cached for them to `path` in
+// CBOR. The file is replaced atomically.
+bool write_snapshot(const std::string& path, const Workspace& workspace, const AnalysisCache& cache);
+
+// Reads a snapshot written by write_snapshot(). Nothing is reopened: the
+// analyses wait for the client to open documents of the same content.
+// Documents backed by a file are revalidated against the file's mtime and, if
+// that changed, against the hash of its content. Returns std::nullopt if the
+// snapshot doesn't exist or can't be read.
+std::optional<RestoredSnapshot> restore_snapshot(const std::string& path);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,268 @@
+#include "syntaxtree.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <string_view>
+#include <tuple>
+
+static bool contains(const SyntaxRange& range, int line, int character)
+{
+    return std::tie(range.start_line, range.start_character) <= std::tie(line, character)
+        && std::tie(line, character) <= std::tie(range.end_line, range.end_character);
+}
+
+static bool operator==(const SyntaxRange& a, const SyntaxRange& b)
+{
+    return std::tie(a.start_line, a.start_character, a.end_line, a.end_character)
+        == std::tie(b.start_line, b.start_character, b.end_line, b.end_character);
+}
+
+namespace {
+
+// Builds the tree in a single pass over the tokens with a stack of the open
+// nodes. Like the scope tree builder it never fails: unbalanced brackets are
+// left open or ignored, and whatever is open at the end of the document ends
+// with its last token.
+class SyntaxTreeBuilder
+{
+
+public:
+    SyntaxTreeBuilder(std::string_view text, const std::vector<Token>& tokens)
+        : m_text(text)
+        , m_tokens(tokens)
+    {
+        SyntaxNode document;
+        document.range.end_line = static_cast<int>(std::count(text.begin(), text.end(), '\n'));
+        document.range.end_character = static_cast<int>(text.size() - (text.rfind('\n') + 1));
+        m_tree.nodes.push_back(document);
+        m_stack.push_back({ 0, 0 });
+        m_tree.leaves.reserve(tokens.size());
+    }
+
+    SyntaxTree build()
+    {
+        for (size_t i = 0; i < m_tokens.size(); ++i) {
+            const Token& token = m_tokens[i];
+            if (text_of(i) == "#" && (i == 0 || m_tokens[i - 1].line != token.line)) {
+                i = directive(i);
+                continue;
+            }
+
+            std::string_view text = text_of(i);
+            bool closer = text == ")" || text == "]" || text == "}";
+            if (!closer && text != ";" && text != ",") {
+                if (top_kind() == SyntaxKind::Document || top_kind() == SyntaxKind::Block) {
+                    open(SyntaxKind::Statement, i);
+                } else if (top_kind() == SyntaxKind::Parentheses || top_kind() == SyntaxKind::Brackets
+                    || top_kind() == SyntaxKind::Braces) {
+                    open(SyntaxKind::Element, i);
+                }
+            }
+
+            if (text == "(") {
+                open(SyntaxKind::Parentheses, i);
+            } else if (text == "[") {
+                open(SyntaxKind::Brackets, i);
+            } else if (text == "{") {
+                open(is_initializer(i) ? SyntaxKind::Braces : SyntaxKind::Block, i);
+            } else if (text == "," && top_kind() == SyntaxKind::Element) {
+                close_top(i - 1);
+            } else if (closer) {
+                close_bracket(i);
+                continue;
+            }
+
+            add_leaf(i);
+            if (text == ";" && top_kind() == SyntaxKind::Statement) {
+                close_top(i);
+            }
+        }
+
+        while (m_stack.size() > 1) {
+            close_top(m_tokens.size() - 1);
+        }
+        return std::move(m_tree);
+    }
+
+private:
+    struct Open {
+        int node;
+        size_t token;
+    };
+
+    std::string_view text_of(size_t token) const
+    {
+        return token_text(m_text, m_tokens[token]);
+    }
+
+    SyntaxKind top_kind() const
+    {
+        return m_tree.nodes[m_stack.back().node].kind;
+    }
+
+    void open(SyntaxKind kind, size_t token)
+    {
+        SyntaxNode node;
+        node.kind = kind;
+        node.parent = m_stack.back().node;
+        node.range.start_line = m_tokens[token].line;
+        node.range.start_character = m_tokens[token].character;
+        m_stack.push_back({ static_cast<int>(m_tree.nodes.size()), token });
+        m_tree.nodes.push_back(node);
+    }
+
+    // Ends the innermost open node with token `last`.
+    void close_top(size_t last)
+    {
+        SyntaxRange& range = m_tree.nodes[m_stack.back().node].range;
+        range.end_line = m_tokens[last].line;
+        range.end_character = m_tokens[last].character + m_tokens[last].length;
+        m_stack.pop_back();
+    }
+
+    void add_leaf(size_t token)
+    {
+        SyntaxLeaf leaf;
+        leaf.line = m_tokens[token].line;
+        leaf.character = m_tokens[token].character;
+        leaf.length = m_tokens[token].length;
+        leaf.parent = m_stack.back().node;
+        m_tree.leaves.push_back(leaf);
+    }
+
+    // A directive takes the rest of its line.
+    size_t directive(size_t first)
+    {
+        size_t last = first;
+        while (last + 1 < m_tokens.size() && m_tokens[last + 1].line == m_tokens[first].line) {
+            ++last;
+        }
+        open(SyntaxKind::Directive, first);
+        for (size_t i = first; i <= last; ++i) {
+            add_leaf(i);
+        }
+        close_top(last);
+        return last;
+    }
+
+    // Braces after "=", or nested in other initializer braces, hold values
+    // rather than statements.
+    bool is_initializer(size_t brace) const
+    {
+        if (brace == 0) {
+            return false;
+        }
+        std::string_view previous = text_of(brace - 1);
+        return previous == "=" || top_kind() == SyntaxKind::Element;
+    }
+
+    void close_bracket(size_t closer)
+    {
+        std::string_view text = text_of(closer);
+        auto matches = [&](SyntaxKind kind) {
+            if (text == ")") {
+                return kind == SyntaxKind::Parentheses;
+            } else if (text == "]") {
+                return kind == SyntaxKind::Brackets;
+            }
+            return kind == SyntaxKind::Block || kind == SyntaxKind::Braces;
+        };
+        // Parentheses and brackets don't reach out of the braces they are in.
+        size_t depth = m_stack.size();
+        while (depth > 1 && !matches(m_tree.nodes[m_stack[depth - 1].node].kind)) {
+            SyntaxKind kind = m_tree.nodes[m_stack[depth - 1].node].kind;
+            if (text != "}" && (kind == SyntaxKind::Block || kind == SyntaxKind::Braces)) {
+                depth = 1;
+                break;
+            }
+            --depth;
+        }
+        if (depth <= 1) {
+            add_leaf(closer);
+            return;
+        }
+
+        while (m_stack.size() > depth) {
+            close_top(closer - 1);
+        }
+        size_t open_token = m_stack.back().token;
+        add_leaf(closer);
+        close_top(closer);
+
+        // A body ends its statement: that of a function, an if, a loop or a
+        // bare block. Struct and interface blocks go on to their ";", an if
+        // to its else and a do to its while.
+        if (text == "}" && top_kind() == SyntaxKind::Statement) {
+            size_t statement = m_stack.back().token;
+            std::string_view before = open_token == statement ? "" : text_of(open_token - 1);
+            bool body = before.empty() || before == ")" || before == "else" || before == "do";
+            std::string_view next = closer + 1 < m_tokens.size() ? text_of(closer + 1) : "";
+            bool continues = next == "else" || (next == "while" && text_of(statement) == "do");
+            if (body && !continues) {
+                close_top(closer);
+            }
+        }
+    }
+
+    std::string_view m_text;
+    const std::vector<Token>& m_tokens;
+    SyntaxTree m_tree;
+    std::vector<Open> m_stack;
+};
+
+}
+
+SyntaxTree build_syntax_tree(std::string_view text, const std::vector<Token>& tokens)
+{
+    return SyntaxTreeBuilder(text, tokens).build();
+}
+
+std::vector<std::vector<SyntaxRange>> selection_ranges(const SyntaxTree& tree,
+    const std::vector<std::pair<int, int>>& positions)
+{
+    std::vector<std::vector<SyntaxRange>> result(positions.size());
+    if (tree.nodes.empty()) {
+        return result;
+    }
+
+    std::vector<size_t> order(positions.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return positions[a] < positions[b]; });
+
+    // The first token not ending before the position only moves forward as
+    // the positions do.
+    auto leaf = tree.leaves.begin();
+    for (size_t index : order) {
+        auto [line, character] = positions[index];
+        leaf = std::lower_bound(leaf, tree.leaves.end(), positions[index],
+            [](const SyntaxLeaf& leaf, const std::pair<int, int>& position) {
+                return std::make_pair(static_cast<int>(leaf.line), static_cast<int>(leaf.character + leaf.length))
+                    < position;
+            });
+
+        auto& ranges = result[index];
+        int node = 0;
+        if (leaf != tree.leaves.end()) {
+            SyntaxRange token;
+            token.start_line = token.end_line = leaf->line;
+            token.start_character = leaf->character;
+            token.end_character = leaf->character + leaf->length;
+            if (contains(token, line, character)) {
+                ranges.push_back(token);
+            }
+            // Between tokens, the nodes starting at the next one don't
+            // contain the position.
+            node = leaf->parent;
+            while (node > 0 && !contains(tree.nodes[node].range, line, character)) {
+                node = tree.nodes[node].parent;
+            }
+        }
+        for (; node >= 0; node = tree.nodes[node].parent) {
+            const SyntaxRange& range = tree.nodes[node].range;
+            if (ranges.empty() || !(ranges.back() == range)) {
+                ranges.push_back(range);
+            }
+        }
+    }
+    return result;
+}
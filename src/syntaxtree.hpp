@@ -0,0 +1,70 @@
+#ifndef SYNTAXTREE_H
+#define SYNTAXTREE_H
+
+#include "lexer.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+enum class SyntaxKind : uint8_t {
+    Document,
+    Directive,
+    Statement,
+    // Braces holding statements: function and control flow bodies, struct and
+    // interface block members.
+    Block,
+    // Braces holding an initializer list.
+    Braces,
+    Parentheses,
+    Brackets,
+    // What is between two commas, or a comma and a bracket, of the three
+    // kinds above.
+    Element,
+};
+
+// [start, end), 0-based.
+struct SyntaxRange {
+    int start_line = 0;
+    int start_character = 0;
+    int end_line = 0;
+    int end_character = 0;
+};
+
+struct SyntaxNode {
+    SyntaxKind kind = SyntaxKind::Document;
+    int parent = -1;
+    SyntaxRange range;
+};
+
+// A token and the innermost node it belongs to.
+struct SyntaxLeaf {
+    uint32_t line = 0;
+    uint32_t character = 0;
+    uint32_t length = 0;
+    int parent = 0;
+};
+
+// The syntactic nesting of a document, built from its tokens like the scope
+// tree, so it is there whether the document parses or not. Nodes are stored
+// flat, each one after its parent, with the document as nodes[0]; going from
+// a token to the document is a walk up the parent links.
+struct SyntaxTree {
+    std::vector<SyntaxNode> nodes;
+
+    // Sorted by position.
+    std::vector<SyntaxLeaf> leaves;
+};
+
+SyntaxTree build_syntax_tree(std::string_view text, const std::vector<Token>& tokens);
+
+// For each (line, character) position, the ranges containing it from the
+// innermost out: the token at the position, if any, then every node up to
+// the document, each strictly larger than the one before. Positions can come
+// in any order; they are looked up in a single sweep over the tokens.
+std::vector<std::vector<SyntaxRange>> selection_ranges(const SyntaxTree& tree,
+    const std::vector<std::pair<int, int>>& positions);
+
+#endif /* SYNTAXTREE_H */
@@ -0,0 +1,66 @@
+#include "text.hpp"
+
+std::string_view line_at(std::string_view text, size_t line)
+{
+    size_t begin = 0;
+    for (size_t i = 0; i < line; ++i) {
+        begin = text.find('\n', begin);
+        if (begin == std::string_view::npos) {
+            return {};
+        }
+        ++begin;
+    }
+    return text.substr(begin, text.find('\n', begin) - begin);
+}
+
+uint64_t hash_string(std::string_view s)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : s) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static int hex_value(char c)
+{
+    return is_digit(c) ? c - '0' : to_lower(c) - 'a' + 10;
+}
+
+std::string uri_to_path(std::string_view uri)
+{
+    const std::string_view scheme = "file://";
+    if (uri.substr(0, scheme.size()) != scheme) {
+        return {};
+    }
+
+    std::string path;
+    path.reserve(uri.size() - scheme.size());
+    for (size_t i = scheme.size(); i < uri.size(); ++i) {
+        if (uri[i] == '%' && i + 2 < uri.size() && is_hex_digit(uri[i + 1]) && is_hex_digit(uri[i + 2])) {
+            path += static_cast<char>(hex_value(uri[i + 1]) * 16 + hex_value(uri[i + 2]));
+            i += 2;
+        } else {
+            path += uri[i];
+        }
+    }
+    return path;
+}
+
+std::string path_to_uri(std::string_view path)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    std::string uri = "file://";
+    uri.reserve(uri.size() + path.size());
+    for (char c : path) {
+        if (is_identifier_char(c) || c == '/' || c == '-' || c == '.' || c == '~') {
+            uri += c;
+        } else {
+            uri += '%';
+            uri += digits[static_cast<unsigned char>(c) >> 4];
+            uri += digits[static_cast<unsigned char>(c) & 15];
+        }
+    }
+    return uri;
+}
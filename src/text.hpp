@@ -0,0 +1,176 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+// Text utilities working on views of the caller's text. Nothing here
+// allocates except where a std::string is returned; views returned point
+// into the argument, which must outlive them.
+
+// ASCII classification. Unlike <cctype>, it doesn't depend on the C locale
+// and takes a plain char.
+inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool is_alpha(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+inline bool is_hex_digit(char c)
+{
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+inline bool is_identifier_start(char c)
+{
+    return is_alpha(c) || c == '_';
+}
+
+inline bool is_identifier_char(char c)
+{
+    return is_identifier_start(c) || is_digit(c);
+}
+
+inline char to_lower(char c)
+{
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+inline bool equals_ignore_case(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (to_lower(a[i]) != to_lower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr std::string_view whitespace = " \f\n\r\t\v";
+
+inline std::string_view trim_right(std::string_view s, std::string_view delimiters = whitespace)
+{
+    return s.substr(0, s.find_last_not_of(delimiters) + 1);
+}
+
+inline std::string_view trim_left(std::string_view s, std::string_view delimiters = whitespace)
+{
+    auto begin = s.find_first_not_of(delimiters);
+    return begin == std::string_view::npos ? s.substr(s.size()) : s.substr(begin);
+}
+
+inline std::string_view trim(std::string_view s, std::string_view delimiters = whitespace)
+{
+    return trim_left(trim_right(s, delimiters), delimiters);
+}
+
+// Iterates over the fields of a text between occurrences of a separator,
+// computing each one as it goes. Like Python's str.split(separator): empty
+// fields are kept, and an empty text has one empty field.
+class SplitIterator
+{
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view*;
+    using reference = const std::string_view&;
+
+    // The end iterator.
+    SplitIterator() = default;
+
+    SplitIterator(std::string_view text, std::string_view separator)
+        : m_rest(text)
+        , m_separator(separator)
+        , m_at_end(false)
+    {
+        advance();
+    }
+
+    reference operator*() const { return m_field; }
+    pointer operator->() const { return &m_field; }
+
+    SplitIterator& operator++()
+    {
+        advance();
+        return *this;
+    }
+
+    SplitIterator operator++(int)
+    {
+        SplitIterator previous = *this;
+        advance();
+        return previous;
+    }
+
+    bool operator==(const SplitIterator& other) const
+    {
+        return m_at_end == other.m_at_end && (m_at_end || m_field.data() == other.m_field.data());
+    }
+
+    bool operator!=(const SplitIterator& other) const { return !(*this == other); }
+
+private:
+    void advance()
+    {
+        if (m_last) {
+            m_at_end = true;
+            return;
+        }
+        auto pos = m_separator.empty() ? std::string_view::npos : m_rest.find(m_separator);
+        if (pos == std::string_view::npos) {
+            m_field = m_rest;
+            m_last = true;
+        } else {
+            m_field = m_rest.substr(0, pos);
+            m_rest.remove_prefix(pos + m_separator.size());
+        }
+    }
+
+    std::string_view m_rest;
+    std::string_view m_separator;
+    std::string_view m_field;
+    bool m_last = false;
+    bool m_at_end = true;
+};
+
+struct SplitRange {
+    SplitIterator first;
+
+    SplitIterator begin() const { return first; }
+    SplitIterator end() const { return {}; }
+};
+
+// for (std::string_view line : split(text, "\n")) ...
+inline SplitRange split(std::string_view text, std::string_view separator)
+{
+    return { SplitIterator(text, separator) };
+}
+
+// Line `line` (0-based) of `text` without its line break, or an empty view
+// past the last line.
+std::string_view line_at(std::string_view text, size_t line);
+
+// 64-bit FNV-1a. Stable across runs, so it can be persisted.
+uint64_t hash_string(std::string_view s);
+
+// Returns the local path of a `file://` URI, or an empty string for any other
+// scheme.
+std::string uri_to_path(std::string_view uri);
+
+// The `file://` URI of an absolute local path, percent-encoding everything
+// but unreserved characters and '/'.
+std::string path_to_uri(std::string_view path);
+
+#endif /* TEXT_H */
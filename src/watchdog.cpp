@@ -0,0 +1,149 @@
+#include "watchdog.hpp"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+StallWatchdog::StallWatchdog() = default;
+
+StallWatchdog::~StallWatchdog()
+{
+    stop();
+}
+
+void StallWatchdog::start(milliseconds threshold, std::function<void(std::string)> log)
+{
+    if (m_thread.joinable() || threshold.count() <= 0) {
+        return;
+    }
+    m_threshold = threshold;
+    m_log = std::move(log);
+    m_stopping = false;
+    m_thread = std::thread([this]() { run(); });
+}
+
+void StallWatchdog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void StallWatchdog::begin_iteration(const char* phase)
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_busy = true;
+    m_reported = false;
+    m_started = steady_clock::now();
+    m_phase = phase;
+    m_method.clear();
+    m_uri.clear();
+}
+
+void StallWatchdog::end_iteration()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    std::string report;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_busy = false;
+        if (!m_reported) {
+            return;
+        }
+        auto duration = duration_cast<milliseconds>(steady_clock::now() - m_started);
+        m_longest_stall = std::max(m_longest_stall, duration);
+        report = fmt::format("Event loop stall ended after {} ms in phase '{}'\n", duration.count(), m_phase);
+    }
+    m_log(std::move(report));
+}
+
+void StallWatchdog::set_phase(const char* phase)
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_phase = phase;
+}
+
+void StallWatchdog::set_message(const std::string& method, const std::string& uri)
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_method = method;
+    m_uri = uri;
+}
+
+uint64_t StallWatchdog::stall_count() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stalls;
+}
+
+milliseconds StallWatchdog::longest_stall() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_longest_stall;
+}
+
+std::map<std::string, uint64_t> StallWatchdog::stalls_by_phase() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stalls_by_phase;
+}
+
+// Checks four times per threshold, so stalls are noticed at most a quarter
+// of the threshold late.
+void StallWatchdog::run()
+{
+    const milliseconds interval = std::max(m_threshold / 4, milliseconds(1));
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_wake.wait_for(lock, interval, [this]() { return m_stopping; })) {
+        if (!m_busy || m_reported || steady_clock::now() - m_started < m_threshold) {
+            continue;
+        }
+        m_reported = true;
+        ++m_stalls;
+        ++m_stalls_by_phase[m_phase];
+        auto duration = duration_cast<milliseconds>(steady_clock::now() - m_started);
+        std::string report = fmt::format("Event loop stalled for {} ms in phase '{}'", duration.count(), m_phase);
+        if (!m_method.empty()) {
+            report += fmt::format(", handling '{}'", m_method);
+        }
+        if (!m_uri.empty()) {
+            report += fmt::format(" for {}", m_uri);
+        }
+        report += "\n";
+
+        lock.unlock();
+        m_log(std::move(report));
+        lock.lock();
+    }
+}
+
+WatchedIteration::WatchedIteration(StallWatchdog& watchdog, const char* phase)
+    : m_watchdog(watchdog)
+{
+    m_watchdog.begin_iteration(phase);
+}
+
+WatchedIteration::~WatchedIteration()
+{
+    m_watchdog.end_iteration();
+}
@@ -0,0 +1,84 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Watches the I/O loop from a thread of its own and reports iterations that
+// take longer than a threshold: what the loop was doing (its phase), and the
+// method and document of the message it was handling.
+//
+// The loop marks where each iteration starts and ends; time spent waiting
+// for input in between doesn't count. A stall is reported once, while it
+// lasts, and again with its duration when the iteration completes.
+class StallWatchdog
+{
+
+public:
+    StallWatchdog();
+    virtual ~StallWatchdog();
+
+    StallWatchdog(const StallWatchdog&) = delete;
+    StallWatchdog& operator=(const StallWatchdog&) = delete;
+
+    // Starts watching. `log` gets the reports and is called from either
+    // thread. Without a call to start(), marking iterations does nothing.
+    void start(std::chrono::milliseconds threshold, std::function<void(std::string)> log);
+    void stop();
+
+    void begin_iteration(const char* phase);
+    void end_iteration();
+
+    // `phase` must be a string literal, or live as long.
+    void set_phase(const char* phase);
+    void set_message(const std::string& method, const std::string& uri);
+
+    uint64_t stall_count() const;
+    std::chrono::milliseconds longest_stall() const;
+    std::map<std::string, uint64_t> stalls_by_phase() const;
+
+private:
+    void run();
+
+    std::chrono::milliseconds m_threshold{ 0 };
+    std::function<void(std::string)> m_log;
+    std::thread m_thread;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+
+    bool m_busy = false;
+    bool m_reported = false;
+    std::chrono::steady_clock::time_point m_started;
+    const char* m_phase = "";
+    std::string m_method;
+    std::string m_uri;
+
+    uint64_t m_stalls = 0;
+    std::chrono::milliseconds m_longest_stall{ 0 };
+    std::map<std::string, uint64_t> m_stalls_by_phase;
+};
+
+// Marks one iteration of the I/O loop for the scope's duration.
+class WatchedIteration
+{
+
+public:
+    WatchedIteration(StallWatchdog& watchdog, const char* phase);
+    ~WatchedIteration();
+
+    WatchedIteration(const WatchedIteration&) = delete;
+    WatchedIteration& operator=(const WatchedIteration&) = delete;
+
+private:
+    StallWatchdog& m_watchdog;
+};
+
+#endif /* WATCHDOG_H */
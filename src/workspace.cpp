@@ -1,4 +1,5 @@
 #include "workspace.hpp"
+#include "text.hpp"
 
 Workspace::Workspace(){};
 Workspace::~Workspace(){};
@@ -13,14 +14,22 @@ void Workspace::set_initialized(bool new_value)
     m_initialized = new_value;
 };
 
-std::map<std::string, std::string>& Workspace::documents()
+std::map<std::string, Document>& Workspace::documents()
 {
     return m_documents;
 };
 
-void Workspace::add_document(std::string key, std::string text)
+const std::map<std::string, Document>& Workspace::documents() const
 {
-    m_documents[key] = text;
+    return m_documents;
+};
+
+void Workspace::add_document(std::string key, std::string text, int version)
+{
+    Document& document = m_documents[key];
+    document.hash = hash_string(text);
+    document.text = std::move(text);
+    document.version = version;
 }
 
 bool Workspace::remove_document(std::string key)
@@ -33,12 +42,78 @@ bool Workspace::remove_document(std::string key)
     return false;
 }
 
-bool Workspace::change_document(std::string key, std::string text)
+bool Workspace::change_document(std::string key, std::string text, int version)
 {
     auto it = m_documents.find(key);
     if (it != m_documents.end()) {
-        m_documents[key] = text;
+        it->second.hash = hash_string(text);
+        it->second.text = std::move(text);
+        it->second.version = version;
         return true;
     }
     return false;
 }
+
+const std::map<std::string, WorkspaceFolder>& Workspace::folders() const
+{
+    return m_folders;
+}
+
+static std::string folder_key(std::string path)
+{
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+    return path;
+}
+
+static bool contains(const std::string& folder_path, const std::string& path)
+{
+    return path.compare(0, folder_path.size(), folder_path) == 0
+        && (path.size() == folder_path.size() || path[folder_path.size()] == '/' || folder_path == "/");
+}
+
+void Workspace::add_folder(WorkspaceFolder folder)
+{
+    folder.path = folder_key(std::move(folder.path));
+    std::string path = folder.path;
+    m_folders[path] = std::move(folder);
+}
+
+bool Workspace::remove_folder(const std::string& uri)
+{
+    return m_folders.erase(folder_key(uri_to_path(uri))) > 0;
+}
+
+const WorkspaceFolder* Workspace::find_folder(const std::string& uri) const
+{
+    auto it = m_folders.find(folder_key(uri_to_path(uri)));
+    return it == m_folders.end() ? nullptr : &it->second;
+}
+
+const WorkspaceFolder* Workspace::folder_of(const std::string& uri) const
+{
+    std::string path = uri_to_path(uri);
+    const WorkspaceFolder* innermost = nullptr;
+    for (const auto& [folder_path, folder] : m_folders) {
+        if (contains(folder_path, path) && (!innermost || folder_path.size() > innermost->path.size())) {
+            innermost = &folder;
+        }
+    }
+    return innermost;
+}
+
+std::vector<std::string> Workspace::documents_in(const std::string& uri) const
+{
+    std::string folder_path = folder_key(uri_to_path(uri));
+    std::vector<std::string> uris;
+    if (folder_path.empty()) {
+        return uris;
+    }
+    for (const auto& [document_uri, document] : m_documents) {
+        if (contains(folder_path, uri_to_path(document_uri))) {
+            uris.push_back(document_uri);
+        }
+    }
+    return uris;
+}
@@ -1,9 +1,32 @@
 #ifndef WORKSPACE_H
 #define WORKSPACE_H
 
+#include <cstdint>
 #include <map>
 #include <string>
 #include <utility>
+#include <vector>
+
+struct Document
+{
+    std::string text;
+    int version = 0;
+
+    // Hash of `text`. Cached results are keyed by it so that they can be
+    // revalidated after a restart without reparsing.
+    uint64_t hash = 0;
+};
+
+// A root of the workspace. Documents under it are analyzed with its
+// settings.
+struct WorkspaceFolder
+{
+    std::string uri;
+    std::string path;
+
+    // Searched in order for includes not found next to the including file.
+    std::vector<std::string> include_paths;
+};
 
 class Workspace
 {
@@ -15,14 +38,29 @@ public:
     bool is_initialized();
     void set_initialized(bool new_value);
 
-    std::map<std::string, std::string>& documents();
-    void add_document(std::string key, std::string text);
+    std::map<std::string, Document>& documents();
+    const std::map<std::string, Document>& documents() const;
+    void add_document(std::string key, std::string text, int version = 0);
     bool remove_document(std::string key);
-    bool change_document(std::string key, std::string text);
+    bool change_document(std::string key, std::string text, int version = 0);
+
+    // Folders are keyed by path, without trailing slashes, so that URIs
+    // spelling the same directory differently name the same folder. Adding a
+    // folder again replaces its settings.
+    const std::map<std::string, WorkspaceFolder>& folders() const;
+    void add_folder(WorkspaceFolder folder);
+    bool remove_folder(const std::string& uri);
+    // The folder `uri` names, or nullptr.
+    const WorkspaceFolder* find_folder(const std::string& uri) const;
+    // The innermost folder containing `uri`, or nullptr.
+    const WorkspaceFolder* folder_of(const std::string& uri) const;
+    // The open documents inside the directory `uri`, a folder or not.
+    std::vector<std::string> documents_in(const std::string& uri) const;
 
 private:
     bool m_initialized = false;
-    std::map<std::string, std::string> m_documents;
+    std::map<std::string, Document> m_documents;
+    std::map<std::string, WorkspaceFolder> m_folders;
 };
 
 #endif /* WORKSPACE_H */
@@ -0,0 +1,444 @@
+#include "workspaceindex.hpp"
+#include "gitindex.hpp"
+#include "headers.hpp"
+#include "jsonfields.hpp"
+#include "text.hpp"
+
+#include "nlohmann/json.hpp"
+
+#include <condition_variable>
+#include <experimental/filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <set>
+
+namespace fs = std::experimental::filesystem;
+using json = nlohmann::json;
+
+// Bump whenever the layout below changes; older caches are ignored.
+static const int index_format = 1;
+
+// Summaries not used by this many builds in a row are dropped on save.
+static const uint64_t max_unused_builds = 64;
+
+static bool is_indexed(const std::string& path)
+{
+    return find_language(path).has_value() || is_header(path);
+}
+
+static std::optional<std::string> read_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+    std::string text{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    if (file.bad()) {
+        return std::nullopt;
+    }
+    return text;
+}
+
+static json summary_to_json(const FileSummary& summary)
+{
+    json globals = json::array();
+    for (const auto& global : summary.globals) {
+        globals.push_back({ global.name, global.type, static_cast<int>(global.kind), global.line, global.character });
+    }
+    return { summary.parsed, summary.errors, summary.warnings, globals };
+}
+
+// Nothing here may throw: the cache is read on a worker, and a corrupt one
+// just means summaries are rebuilt.
+static std::optional<FileSummary> summary_from_json(const json& entry)
+{
+    if (!entry.is_array() || entry.size() != 4 || !entry[0].is_boolean() || !is_int(entry[1]) || !is_int(entry[2])
+        || !entry[3].is_array()) {
+        return std::nullopt;
+    }
+    FileSummary summary;
+    summary.parsed = entry[0].get<bool>();
+    summary.errors = entry[1].get<int>();
+    summary.warnings = entry[2].get<int>();
+    for (const auto& global : entry[3]) {
+        if (!global.is_array() || global.size() != 5 || !global[0].is_string() || !global[1].is_string()
+            || !is_int(global[2]) || !is_int(global[3]) || !is_int(global[4])) {
+            return std::nullopt;
+        }
+        int kind = global[2].get<int>();
+        if (kind < static_cast<int>(SymbolKind::Variable) || kind > static_cast<int>(SymbolKind::Struct)) {
+            return std::nullopt;
+        }
+        SymbolOccurrence symbol;
+        symbol.name = global[0].get<std::string>();
+        symbol.type = global[1].get<std::string>();
+        symbol.kind = static_cast<SymbolKind>(kind);
+        symbol.line = global[3].get<int>();
+        symbol.character = global[4].get<int>();
+        summary.globals.push_back(std::move(symbol));
+    }
+    return summary;
+}
+
+WorkspaceIndex::WorkspaceIndex() {}
+
+WorkspaceIndex::~WorkspaceIndex() {}
+
+bool WorkspaceIndex::load(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::vector<uint8_t> bytes{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+    json cache = json::from_cbor(bytes, true, false);
+    if (cache.is_discarded() || !cache.is_object()) {
+        return false;
+    }
+    auto format = cache.find("format");
+    auto builds = cache.find("builds");
+    auto summaries = cache.find("summaries");
+    if (format == cache.end() || *format != index_format || builds == cache.end() || !builds->is_number_unsigned()
+        || summaries == cache.end() || !summaries->is_array()) {
+        return false;
+    }
+
+    // Builds are counted on from where the cache left off, so that the ages
+    // of its summaries stay meaningful.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_builds = std::max(m_builds, builds->get<uint64_t>());
+    for (const auto& entry : *summaries) {
+        Sha1Digest id;
+        if (!entry.is_array() || entry.size() != 4 || !entry[0].is_string() || !entry[1].is_string()
+            || !entry[2].is_number_unsigned() || !from_hex(entry[0].get<std::string>(), id)) {
+            continue;
+        }
+        auto summary = summary_from_json(entry[3]);
+        if (summary) {
+            auto& cached = m_summaries[{ id, entry[1].get<std::string>() }];
+            cached.summary = std::move(*summary);
+            cached.last_used = std::max(cached.last_used, entry[2].get<uint64_t>());
+        }
+    }
+    return true;
+}
+
+bool WorkspaceIndex::save(const std::string& path) const
+{
+    json summaries = json::array();
+    uint64_t builds;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        builds = m_builds;
+        for (const auto& [key, cached] : m_summaries) {
+            if (cached.last_used + max_unused_builds > m_builds) {
+                summaries.push_back({ to_hex(key.first), key.second, cached.last_used, summary_to_json(cached.summary) });
+            }
+        }
+    }
+    json cache{
+        { "format", index_format },
+        { "builds", builds },
+        { "summaries", summaries },
+    };
+    auto bytes = json::to_cbor(cache);
+
+    // As with snapshots, a crash while writing never leaves a truncated
+    // cache behind.
+    std::lock_guard<std::mutex> save_lock(m_save_mutex);
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        if (!out) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp_path, path, ec);
+    return !ec;
+}
+
+namespace {
+
+struct Candidate {
+    std::string path;
+    std::string uri;
+    // Set for files git tracks.
+    const GitIndexEntry* entry = nullptr;
+};
+
+struct Indexed {
+    bool ok = false;
+    Sha1Digest id{};
+    bool from_git_index = false;
+    bool cache_hit = false;
+};
+
+// Files are claimed one at a time by the helper tasks and the building
+// thread alike. Helpers that start after every file was claimed find
+// nothing left, so the building thread never waits on a queued task.
+struct BuildJob {
+    std::vector<Candidate> candidates;
+    std::vector<Indexed> results;
+    std::atomic<size_t> next{ 0 };
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t done = 0;
+
+    template <typename F>
+    void run(F&& index_file)
+    {
+        for (size_t i = next++; i < candidates.size(); i = next++) {
+            index_file(candidates[i], results[i]);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (++done == candidates.size()) {
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+}
+
+IndexStats WorkspaceIndex::build(const std::string& root, Scheduler& scheduler, const Summarize& summarize)
+{
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    uint64_t build;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        build = ++m_builds;
+        auto& previous = m_roots[root].cancelled;
+        if (previous) {
+            *previous = true;
+        }
+        previous = cancelled;
+    }
+
+    std::error_code ec;
+    std::string root_path = fs::canonical(root, ec).string();
+    if (ec) {
+        return {};
+    }
+
+    // Tracked files come with their ids, even in hidden directories; the
+    // walk adds the untracked ones.
+    auto job = std::make_shared<BuildJob>();
+    std::set<std::string> listed;
+    auto git = read_git_index(root_path);
+    if (git) {
+        std::string prefix = root_path.size() > git->work_tree.size()
+            ? root_path.substr(git->work_tree.size() + 1) + "/"
+            : "";
+        for (const auto& [path, entry] : git->entries) {
+            if (path.compare(0, prefix.size(), prefix) == 0 && is_indexed(path)) {
+                std::string absolute = git->work_tree + "/" + path;
+                job->candidates.push_back({ absolute, path_to_uri(absolute), &entry });
+                listed.insert(absolute);
+            }
+        }
+    }
+    for (auto it = fs::recursive_directory_iterator(root_path, ec); !ec && it != fs::recursive_directory_iterator();
+         it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if (fs::is_directory(it->status()) && !name.empty() && name[0] == '.') {
+            it.disable_recursion_pending();
+        } else if (fs::is_regular_file(it->status()) && is_indexed(name)) {
+            std::string absolute = it->path().string();
+            if (listed.count(absolute) == 0) {
+                job->candidates.push_back({ absolute, path_to_uri(absolute), nullptr });
+            }
+        }
+    }
+    job->results.resize(job->candidates.size());
+
+    auto index_file = [&](const Candidate& candidate, Indexed& result) {
+        if (m_cancelled || *cancelled) {
+            return;
+        }
+        std::optional<std::string> text;
+        if (candidate.entry && git_entry_matches(*git, *candidate.entry, candidate.path)) {
+            result.id = candidate.entry->id;
+            result.from_git_index = true;
+        } else {
+            text = read_file(candidate.path);
+            if (!text) {
+                return;
+            }
+            result.id = git_blob_id(*text);
+        }
+
+        SummaryKey key{ result.id, fs::path(candidate.path).extension().string() };
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto cached = m_summaries.find(key);
+            if (cached != m_summaries.end()) {
+                cached->second.last_used = build;
+                result.ok = result.cache_hit = true;
+                return;
+            }
+        }
+
+        if (!text) {
+            text = read_file(candidate.path);
+        }
+        auto summary = text ? summarize(candidate.uri, *text) : std::nullopt;
+        if (!summary) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_summaries[key] = { std::move(*summary), build };
+        result.ok = true;
+    };
+
+    if (!job->candidates.empty()) {
+        size_t helpers = std::min<size_t>(scheduler.num_threads(), job->candidates.size());
+        for (size_t i = 0; i < helpers; ++i) {
+            scheduler.submit(Scheduler::Priority::Background, [job, index_file]() { job->run(index_file); });
+        }
+        job->run(index_file);
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->finished.wait(lock, [&]() { return job->done == job->candidates.size(); });
+    }
+
+    IndexStats stats;
+    std::map<std::string, SummaryKey> files;
+    for (size_t i = 0; i < job->candidates.size(); ++i) {
+        const Indexed& result = job->results[i];
+        if (!result.ok) {
+            continue;
+        }
+        const Candidate& candidate = job->candidates[i];
+        files[candidate.uri] = { result.id, fs::path(candidate.path).extension().string() };
+        ++stats.files;
+        ++(result.from_git_index ? stats.from_git_index : stats.hashed);
+        ++(result.cache_hit ? stats.cache_hits : stats.summarized);
+    }
+
+    // A root removed or rebuilt meanwhile keeps what it has now.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats.summaries = m_summaries.size();
+    auto it = m_roots.find(root);
+    if (it != m_roots.end() && it->second.cancelled == cancelled && !*cancelled) {
+        it->second.files = std::move(files);
+        it->second.stats = stats;
+        it->second.git_index = git ? git->path : std::string();
+        if (git) {
+            it->second.git_index_mtime_seconds = git->mtime_seconds;
+            it->second.git_index_mtime_nanoseconds = git->mtime_nanoseconds;
+        }
+    }
+    return stats;
+}
+
+bool WorkspaceIndex::has_root(const std::string& root) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_roots.count(root) > 0;
+}
+
+// Each change is reported once: the mtime seen now is recorded, so that a
+// build taking longer than the interval between calls isn't restarted.
+std::vector<std::string> WorkspaceIndex::changed_roots()
+{
+    std::vector<std::string> changed;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& [root, indexed] : m_roots) {
+        if (indexed.git_index.empty()) {
+            continue;
+        }
+        uint32_t seconds = 0;
+        uint32_t nanoseconds = 0;
+        git_index_mtime(indexed.git_index, seconds, nanoseconds);
+        if (seconds != indexed.git_index_mtime_seconds || nanoseconds != indexed.git_index_mtime_nanoseconds) {
+            indexed.git_index_mtime_seconds = seconds;
+            indexed.git_index_mtime_nanoseconds = nanoseconds;
+            changed.push_back(root);
+        }
+    }
+    return changed;
+}
+
+bool WorkspaceIndex::remove_root(const std::string& root)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_roots.find(root);
+    if (it == m_roots.end()) {
+        return false;
+    }
+    *it->second.cancelled = true;
+    m_roots.erase(it);
+    return true;
+}
+
+void WorkspaceIndex::cancel()
+{
+    m_cancelled = true;
+}
+
+std::vector<std::pair<std::string, SymbolOccurrence>> WorkspaceIndex::find_symbols(
+    std::string_view query, size_t limit) const
+{
+    auto matches = [&](const std::string& name) {
+        if (query.size() > name.size()) {
+            return false;
+        }
+        for (size_t i = 0; i + query.size() <= name.size(); ++i) {
+            if (equals_ignore_case(std::string_view(name).substr(i, query.size()), query)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::vector<std::pair<std::string, SymbolOccurrence>> found;
+    std::set<std::string> seen;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& [root, indexed] : m_roots) {
+        for (const auto& [uri, key] : indexed.files) {
+            auto cached = m_summaries.find(key);
+            if (cached == m_summaries.end() || !seen.insert(uri).second) {
+                continue;
+            }
+            for (const auto& global : cached->second.summary.globals) {
+                if (found.size() == limit) {
+                    return found;
+                }
+                if (matches(global.name)) {
+                    found.emplace_back(uri, global);
+                }
+            }
+        }
+    }
+    return found;
+}
+
+IndexStats WorkspaceIndex::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    IndexStats total;
+    for (const auto& [root, indexed] : m_roots) {
+        total.files += indexed.stats.files;
+        total.from_git_index += indexed.stats.from_git_index;
+        total.hashed += indexed.stats.hashed;
+        total.cache_hits += indexed.stats.cache_hits;
+        total.summarized += indexed.stats.summarized;
+    }
+    total.summaries = m_summaries.size();
+    return total;
+}
+
+std::map<std::string, IndexStats> WorkspaceIndex::root_stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<std::string, IndexStats> stats;
+    for (const auto& [root, indexed] : m_roots) {
+        stats[root] = indexed.stats;
+        stats[root].summaries = m_summaries.size();
+    }
+    return stats;
+}
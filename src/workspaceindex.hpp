@@ -0,0 +1,133 @@
+#ifndef WORKSPACEINDEX_H
+#define WORKSPACEINDEX_H
+
+#include "analysis.hpp"
+#include "scheduler.hpp"
+#include "sha1.hpp"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// What workspace wide queries need of a file, without the file.
+struct FileSummary {
+    bool parsed = false;
+    int errors = 0;
+    int warnings = 0;
+    std::vector<SymbolOccurrence> globals;
+};
+
+struct IndexStats {
+    size_t files = 0;
+
+    // How the content key of each file was found: taken from the git index,
+    // or by reading and hashing the file.
+    size_t from_git_index = 0;
+    size_t hashed = 0;
+
+    // Files whose summary was cached, and files summarized.
+    size_t cache_hits = 0;
+    size_t summarized = 0;
+
+    // Summaries kept, including those of files not in the workspace now.
+    size_t summaries = 0;
+};
+
+// The shader files under each workspace root, summarized, and a persistent
+// cache of summaries keyed by content, which all roots share: a file found
+// under several roots, or on several branches, is summarized once.
+//
+// The key is the id git gives the content as a blob. For files that git
+// tracks and whose stat data is unchanged since git last looked at them, it
+// comes straight from the git index, so a file whose blob was summarized
+// before (on any branch, in any earlier session) isn't even read.
+class WorkspaceIndex
+{
+
+public:
+    // Summarizes a file of the given URI and text, or fails if it isn't a
+    // shader.
+    using Summarize = std::function<std::optional<FileSummary>(const std::string& uri, const std::string& text)>;
+
+    WorkspaceIndex();
+    virtual ~WorkspaceIndex();
+
+    // Merges the summaries of a cache written by save().
+    bool load(const std::string& path);
+    // Writes the summaries used in the last 64 builds. The file is replaced
+    // atomically.
+    bool save(const std::string& path) const;
+
+    // Indexes the shaders and headers under `root`, replacing the file list
+    // of that root only. Those are the files found walking the directory,
+    // skipping hidden directories, and in a git work tree also the files git
+    // tracks. Files are read and summarized in background tasks on
+    // `scheduler`, helped by the calling thread. A build of the same root
+    // still running is stopped.
+    IndexStats build(const std::string& root, Scheduler& scheduler, const Summarize& summarize);
+
+    // Whether `root` was built, or is being built, and not removed since.
+    bool has_root(const std::string& root) const;
+
+    // Roots in a git work tree whose index file was rewritten since they
+    // were built or last returned here, as by a checkout or a commit, and
+    // that should be built again.
+    std::vector<std::string> changed_roots();
+
+    // Stops the build of `root`, if running, and forgets its files. The
+    // summaries stay until save() finds them unused.
+    bool remove_root(const std::string& root);
+
+    // Stops running builds early, and any started later.
+    void cancel();
+
+    // Global declarations whose name contains `query`, ignoring case, with
+    // the URIs of their files; at most `limit` of them. Files under nested
+    // roots are reported once.
+    std::vector<std::pair<std::string, SymbolOccurrence>> find_symbols(std::string_view query, size_t limit) const;
+
+    // Of all roots together, and of each root, by the path given to build().
+    IndexStats stats() const;
+    std::map<std::string, IndexStats> root_stats() const;
+
+private:
+    struct CachedSummary {
+        FileSummary summary;
+        // The build() it was last used by.
+        uint64_t last_used = 0;
+    };
+
+    // A summary depends on the file's extension, which gives the stage, as
+    // much as on its content.
+    using SummaryKey = std::pair<Sha1Digest, std::string>;
+
+    struct Root {
+        std::map<std::string, SummaryKey> files;
+        IndexStats stats;
+        // Of the build of the root that is running or ran last.
+        std::shared_ptr<std::atomic<bool>> cancelled;
+        // The git index the last build listed files from, if any, and its
+        // mtime then.
+        std::string git_index;
+        uint32_t git_index_mtime_seconds = 0;
+        uint32_t git_index_mtime_nanoseconds = 0;
+    };
+
+    mutable std::mutex m_mutex;
+    std::map<SummaryKey, CachedSummary> m_summaries;
+    std::map<std::string, Root> m_roots;
+    uint64_t m_builds = 0;
+    std::atomic<bool> m_cancelled{ false };
+
+    // Only one save() writes the file at a time.
+    mutable std::mutex m_save_mutex;
+};
+
+#endif /* WORKSPACEINDEX_H */
@@ -0,0 +1,135 @@
+// Checks lex() on the constructs it must get right, and that lex_parallel()
+// gives exactly the tokens of lex() wherever the chunk boundaries fall.
+
+#include "corpus.hpp"
+#include "lexer.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                #condition);                                                      \
+            ++failures;                                                           \
+        }                                                                         \
+    } while (0)
+
+static bool same_tokens(const std::vector<Token>& a, const std::vector<Token>& b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].kind != b[i].kind || a[i].offset != b[i].offset || a[i].length != b[i].length
+            || a[i].line != b[i].line || a[i].character != b[i].character) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<std::string> texts_of(const std::string& text)
+{
+    std::vector<std::string> texts;
+    for (const auto& token : lex(text)) {
+        texts.emplace_back(token_text(text, token));
+    }
+    return texts;
+}
+
+// Every chunk count from one chunk to one chunk per line, so that every line
+// starts a chunk at least once.
+static void check_parallel(const std::string& text)
+{
+    auto serial = lex(text);
+    size_t lines = 1;
+    for (char c : text) {
+        lines += c == '\n';
+    }
+    for (unsigned chunks = 1; chunks <= lines + 1; ++chunks) {
+        if (!same_tokens(serial, lex_parallel(text, chunks))) {
+            std::fprintf(stderr, "lex_parallel() with %u chunks differs from lex() on:\n%s\n", chunks, text.c_str());
+            ++failures;
+        }
+    }
+}
+
+static void test_tokens()
+{
+    std::string text = "uniform vec4 color;\nx <<= 0x1Fu + 1.5e-3;\n#define A \"s\"\n";
+    auto tokens = lex(text);
+    CHECK((texts_of(text) == std::vector<std::string>{ "uniform", "vec4", "color", ";", "x", "<<=", "0x1Fu", "+",
+        "1.5e-3", ";", "#", "define", "A", "\"s\"" }));
+    CHECK(tokens.size() == 14);
+    if (tokens.size() == 14) {
+        CHECK(tokens[0].kind == TokenKind::Identifier);
+        CHECK(tokens[3].kind == TokenKind::Punctuation);
+        CHECK(tokens[6].kind == TokenKind::Number);
+        CHECK(tokens[8].kind == TokenKind::Number);
+        CHECK(tokens[13].kind == TokenKind::String);
+        CHECK(tokens[5].line == 1 && tokens[5].character == 2);
+        CHECK(tokens[13].line == 2 && tokens[13].character == 10);
+    }
+}
+
+static void test_comments()
+{
+    CHECK((texts_of("a /* b\nc */ d // e\nf") == std::vector<std::string>{ "a", "d", "f" }));
+    CHECK((texts_of("a // b \\\nc\nd") == std::vector<std::string>{ "a", "d" }));
+    CHECK((texts_of("a // b \\\r\nc\r\nd") == std::vector<std::string>{ "a", "d" }));
+    CHECK((texts_of("a /* unterminated\nb") == std::vector<std::string>{ "a" }));
+    CHECK((texts_of("#define F(x) \\\n    (x + 1)") == std::vector<std::string>{ "#", "define", "F", "(", "x", ")", "(",
+        "x", "+", "1", ")" }));
+    CHECK(lex("").empty());
+}
+
+static void test_parallel_boundaries()
+{
+    // Chunk boundaries inside block comments, continued line comments and
+    // continued macros, including comments that look like they close or open
+    // one another.
+    check_parallel("a\n/*\nb\n*/\nc\n");
+    check_parallel("/* x\n// y\n*/ z\n/*\n*/\n");
+    check_parallel("a // b \\\nc \\\nd\ne\n");
+    check_parallel("/* a */ b /* c\nd */ e // f /* g\nh */\n");
+    check_parallel("#define M(a) \\\n  a /* \\\n  */ + 1\nM(2)\n");
+    check_parallel("x\r\n/*\r\ny\r\n*/\r\nz // w \\\r\nv\r\n");
+    check_parallel("/* never closed\na\nb\nc\n");
+    check_parallel("\n\n\n\n");
+    check_parallel("");
+}
+
+static void test_parallel_corpus()
+{
+    for (uint32_t seed = 1; seed <= 4; ++seed) {
+        CorpusOptions options;
+        options.seed = seed;
+        options.size = 64 << 10;
+        options.comment_density = 0.5;
+        options.macro_density = 0.5;
+        std::string text = generate_shader(options, "frag");
+        auto serial = lex(text);
+        for (unsigned chunks : { 2u, 3u, 7u, 64u, 997u }) {
+            CHECK(same_tokens(serial, lex_parallel(text, chunks)));
+        }
+        CHECK(same_tokens(serial, lex_document(text)));
+    }
+}
+
+int main()
+{
+    test_tokens();
+    test_comments();
+    test_parallel_boundaries();
+    test_parallel_corpus();
+    if (failures) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,397 @@
+#include "corpus.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <random>
+
+namespace {
+
+class Random
+{
+
+public:
+    explicit Random(uint32_t seed)
+        : m_engine(seed)
+    {
+    }
+
+    uint32_t below(uint32_t n)
+    {
+        return n == 0 ? 0 : static_cast<uint32_t>(m_engine() % n);
+    }
+
+    bool chance(double p)
+    {
+        return m_engine() < p * 4294967296.0;
+    }
+
+private:
+    std::mt19937 m_engine;
+};
+
+uint32_t mix_seed(uint32_t seed, const std::string& stage, int index)
+{
+    // FNV-1a over everything that tells shaders apart.
+    uint32_t hash = 2166136261u;
+    auto add = [&](uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            hash = (hash ^ ((value >> (8 * i)) & 0xff)) * 16777619u;
+        }
+    };
+    add(seed);
+    add(static_cast<uint32_t>(index));
+    for (char c : stage) {
+        add(static_cast<unsigned char>(c));
+    }
+    return hash;
+}
+
+const char* const member_types[] = { "float", "vec2", "vec3", "vec4" };
+
+struct Aggregate {
+    std::string name;
+
+    // Member 0 is always a float, so expressions can use it.
+    std::vector<std::string> member_types;
+};
+
+// Every generated function is `float name(vec3 p, float k)`, so any of them
+// can call any earlier one.
+class ShaderWriter
+{
+
+public:
+    ShaderWriter(const CorpusOptions& options, const std::string& stage, int index)
+        : m_options(options)
+        , m_stage(stage)
+        , m_random(mix_seed(options.seed, stage, index))
+        , m_stem("shader" + std::to_string(index) + "_" + stage)
+    {
+    }
+
+    std::string shader(std::vector<GeneratedFile>* headers)
+    {
+        bool broken = m_random.chance(m_options.error_rate);
+        m_error_function = broken ? static_cast<int>(m_random.below(std::max(m_options.functions, 1))) : -1;
+
+        m_out = "#version 450\n";
+        if (m_options.include_depth > 0) {
+            m_out += "#extension GL_GOOGLE_include_directive : require\n";
+        }
+        m_out += "\n";
+        prologue();
+
+        std::string body = m_out;
+        m_out.clear();
+        // The deepest header comes first in the translation unit.
+        std::vector<GeneratedFile> chain;
+        for (int level = m_options.include_depth; level >= 1; --level) {
+            chain.push_back({ header_name(level), header_text(level) });
+        }
+        if (headers) {
+            headers->insert(headers->end(), chain.rbegin(), chain.rend());
+        }
+        m_out = body;
+        if (m_options.include_depth > 0) {
+            m_out += "#include \"" + header_name(1) + "\"\n\n";
+        }
+
+        declarations("");
+        for (int f = 0; f < m_options.functions || m_out.size() < m_options.size; ++f) {
+            function(m_stage + "_f" + std::to_string(f), f == m_error_function);
+        }
+        main();
+        return m_out;
+    }
+
+private:
+    std::string header_name(int level) const
+    {
+        return m_stem + "_" + std::to_string(level) + ".glsl";
+    }
+
+    // Headers are generated before the shader's own code, deepest first, so
+    // each file can use what the files it includes declare.
+    std::string header_text(int level)
+    {
+        std::string guard = "H_" + m_stem + "_" + std::to_string(level);
+        for (auto& c : guard) {
+            c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+        m_out = "#ifndef " + guard + "\n#define " + guard + "\n\n";
+        if (level < m_options.include_depth) {
+            m_out += "#include \"" + header_name(level + 1) + "\"\n\n";
+        }
+        std::string prefix = "inc" + std::to_string(level) + "_";
+        declarations(prefix);
+        for (int f = 0; f < 2; ++f) {
+            function(prefix + "f" + std::to_string(f), false);
+        }
+        m_out += "#endif\n";
+        return m_out;
+    }
+
+    void prologue()
+    {
+        if (m_stage == "vert") {
+            m_out += "layout(location = 0) in vec3 position;\nlayout(location = 0) out vec3 v_color;\n\n";
+        } else if (m_stage == "frag") {
+            m_out += "layout(location = 0) in vec3 v_color;\nlayout(location = 0) out vec4 color;\n\n";
+        } else if (m_stage == "comp") {
+            m_out += "layout(local_size_x = 8, local_size_y = 8) in;\n"
+                     "layout(std430, binding = 1) buffer Output { float values[]; } result;\n\n";
+        } else if (m_stage == "geom") {
+            m_out += "layout(triangles) in;\nlayout(triangle_strip, max_vertices = 3) out;\n"
+                     "layout(location = 0) out float g_value;\n\n";
+        } else if (m_stage == "tesc") {
+            m_out += "layout(vertices = 3) out;\n\n";
+        } else if (m_stage == "tese") {
+            m_out += "layout(triangles, equal_spacing, ccw) in;\n\n";
+        }
+    }
+
+    void declarations(const std::string& prefix)
+    {
+        for (int s = 0; s < m_options.structs; ++s) {
+            Aggregate aggregate;
+            aggregate.name = prefix + "S" + std::to_string(s);
+            m_out += "struct " + aggregate.name + " {\n";
+            members(aggregate, "m");
+            m_out += "};\n\n";
+            m_structs.push_back(aggregate);
+        }
+
+        // One uniform block per file, with an instance name.
+        Aggregate block;
+        block.name = prefix + "params";
+        m_out += "layout(std140) uniform " + prefix + "Params {\n";
+        members(block, "u");
+        m_out += "} " + block.name + ";\n\n";
+        m_blocks.push_back(block);
+
+        if (m_options.macro_density > 0) {
+            m_out += "#define " + prefix + "SCALE(x) ((x) * 1.5)\n";
+            m_out += "#define " + prefix + "BLEND(a, b) \\\n    mix((a), (b), 0.25)\n\n";
+            m_macros.push_back(prefix);
+        }
+    }
+
+    void members(Aggregate& aggregate, const std::string& prefix)
+    {
+        for (int m = 0; m < std::max(m_options.struct_members, 1); ++m) {
+            std::string type = m == 0 ? "float" : member_types[m_random.below(4)];
+            aggregate.member_types.push_back(type);
+            m_out += "    " + type + " " + prefix + std::to_string(m) + ";\n";
+        }
+    }
+
+    void comment(const std::string& indent)
+    {
+        switch (m_random.below(3)) {
+        case 0:
+            m_out += indent + "// step " + std::to_string(m_random.below(1000)) + "\n";
+            break;
+        case 1: {
+            // Up to a few dozen lines of commented-out code.
+            m_out += indent + "/* a block comment\n";
+            int lines = static_cast<int>(m_random.below(40));
+            for (int l = 0; l < lines; ++l) {
+                m_out += indent + "   float commented" + std::to_string(l) + " = 1.0;\n";
+            }
+            m_out += indent + " */\n";
+            break;
+        }
+        case 2:
+            m_out += indent + "// a comment continued \\\n" + indent + "   on the next line\n";
+            break;
+        }
+    }
+
+    // A float expression of p and k.
+    std::string expression()
+    {
+        if (!m_macros.empty() && m_random.chance(m_options.macro_density)) {
+            const auto& prefix = m_macros[m_random.below(m_macros.size())];
+            return m_random.below(2) ? prefix + "SCALE(k)" : prefix + "BLEND(k, p.x)";
+        }
+        switch (m_random.below(6)) {
+        case 0:
+            return "dot(p, vec3(0.5, 0.25, 0.125))";
+        case 1:
+            return "sin(k) * " + std::to_string(m_random.below(9) + 1) + ".0";
+        case 2:
+            if (!m_functions.empty()) {
+                return m_functions[m_random.below(m_functions.size())] + "(p.zyx, k * 0.5)";
+            }
+            return "length(p)";
+        case 3:
+            if (!m_blocks.empty()) {
+                return m_blocks[m_random.below(m_blocks.size())].name + ".u0 * k";
+            }
+            return "k";
+        case 4:
+            return "clamp(p.y, 0.0, 1.0)";
+        default:
+            return "max(k, p.z)";
+        }
+    }
+
+    void statement(const std::string& indent, int& counter)
+    {
+        if (m_random.chance(m_options.comment_density)) {
+            comment(indent);
+        }
+        std::string n = std::to_string(counter++);
+        switch (m_random.below(5)) {
+        case 0:
+        case 1:
+            m_out += indent + "float t" + n + " = " + expression() + ";\n";
+            m_out += indent + "acc += t" + n + ";\n";
+            break;
+        case 2:
+            m_out += indent + "for (int i" + n + " = 0; i" + n + " < 4; ++i" + n + ") {\n";
+            m_out += indent + "    acc += " + expression() + ";\n";
+            m_out += indent + "}\n";
+            break;
+        case 3:
+            m_out += indent + "if (acc > " + std::to_string(m_random.below(4)) + ".5) {\n";
+            m_out += indent + "    acc -= " + expression() + ";\n";
+            m_out += indent + "} else {\n";
+            m_out += indent + "    acc += 1.0;\n";
+            m_out += indent + "}\n";
+            break;
+        case 4:
+            if (!m_structs.empty()) {
+                const auto& aggregate = m_structs[m_random.below(m_structs.size())];
+                m_out += indent + aggregate.name + " s" + n + ";\n";
+                m_out += indent + "s" + n + ".m0 = " + expression() + ";\n";
+                m_out += indent + "acc += s" + n + ".m0;\n";
+            } else {
+                m_out += indent + "acc *= 0.5;\n";
+            }
+            break;
+        }
+    }
+
+    void function(const std::string& name, bool broken)
+    {
+        m_out += "float " + name + "(vec3 p, float k)\n{\n    float acc = 0.0;\n";
+        int statements = 3 + static_cast<int>(m_random.below(6));
+        int counter = 0;
+        int error_at = broken ? static_cast<int>(m_random.below(statements)) : -1;
+        for (int s = 0; s < statements; ++s) {
+            if (s == error_at) {
+                error();
+            }
+            statement("    ", counter);
+        }
+        m_out += "    return acc;\n}\n\n";
+        m_functions.push_back(name);
+    }
+
+    void error()
+    {
+        switch (m_random.below(3)) {
+        case 0:
+            m_out += "    acc += 1.0\n";
+            break;
+        case 1:
+            m_out += "    acc += undeclared_value;\n";
+            break;
+        case 2:
+            m_out += "    vec2 mismatch = vec3(1.0);\n";
+            break;
+        }
+    }
+
+    void main()
+    {
+        // The last function generated, or a constant without any.
+        auto call = [&](const std::string& argument) {
+            return m_functions.empty() ? std::string("1.0") : m_functions.back() + "(" + argument + ", 1.0)";
+        };
+        m_out += "void main()\n{\n";
+        if (m_stage == "vert") {
+            m_out += "    v_color = vec3(" + call("position") + ");\n"
+                     "    gl_Position = vec4(position, 1.0);\n";
+        } else if (m_stage == "frag") {
+            m_out += "    color = vec4(v_color * " + call("v_color") + ", 1.0);\n";
+        } else if (m_stage == "comp") {
+            m_out += "    vec3 p = vec3(gl_GlobalInvocationID);\n"
+                     "    result.values[gl_LocalInvocationIndex] = " + call("p") + ";\n";
+        } else if (m_stage == "geom") {
+            m_out += "    for (int v = 0; v < 3; ++v) {\n"
+                     "        g_value = " + call("gl_in[v].gl_Position.xyz") + ";\n"
+                     "        gl_Position = gl_in[v].gl_Position;\n"
+                     "        EmitVertex();\n"
+                     "    }\n"
+                     "    EndPrimitive();\n";
+        } else if (m_stage == "tesc") {
+            m_out += "    gl_out[gl_InvocationID].gl_Position = gl_in[gl_InvocationID].gl_Position;\n"
+                     "    float level = 1.0 + abs(" + call("gl_in[0].gl_Position.xyz") + ");\n"
+                     "    gl_TessLevelOuter[0] = level;\n"
+                     "    gl_TessLevelOuter[1] = level;\n"
+                     "    gl_TessLevelOuter[2] = level;\n"
+                     "    gl_TessLevelInner[0] = level;\n";
+        } else if (m_stage == "tese") {
+            m_out += "    vec3 p = gl_TessCoord.x * gl_in[0].gl_Position.xyz\n"
+                     "        + gl_TessCoord.y * gl_in[1].gl_Position.xyz\n"
+                     "        + gl_TessCoord.z * gl_in[2].gl_Position.xyz;\n"
+                     "    gl_Position = vec4(p * " + call("p") + ", 1.0);\n";
+        }
+        // Edits made by edit_shader() go here.
+        m_out += "}\n";
+    }
+
+    const CorpusOptions& m_options;
+    std::string m_stage;
+    Random m_random;
+    std::string m_stem;
+    std::string m_out;
+    int m_error_function = -1;
+
+    std::vector<Aggregate> m_structs;
+    std::vector<Aggregate> m_blocks;
+    std::vector<std::string> m_macros;
+    std::vector<std::string> m_functions;
+};
+
+}
+
+const std::vector<std::string>& corpus_stages()
+{
+    static const std::vector<std::string> stages{ "vert", "tesc", "tese", "geom", "frag", "comp" };
+    return stages;
+}
+
+Corpus generate_corpus(const CorpusOptions& options)
+{
+    Corpus corpus;
+    const auto& stages = options.stages.empty() ? corpus_stages() : options.stages;
+    for (const auto& stage : stages) {
+        for (int index = 0; index < options.shaders; ++index) {
+            std::string text = generate_shader(options, stage, index, &corpus.headers);
+            corpus.shaders.push_back({ "shader" + std::to_string(index) + "." + stage, std::move(text) });
+        }
+    }
+    return corpus;
+}
+
+std::string generate_shader(const CorpusOptions& options, const std::string& stage, int index,
+    std::vector<GeneratedFile>* headers)
+{
+    return ShaderWriter(options, stage, index).shader(headers);
+}
+
+std::string edit_shader(const std::string& text, int revision)
+{
+    auto end = text.rfind('}');
+    if (end == std::string::npos) {
+        return text;
+    }
+    std::string edits;
+    for (int r = 1; r <= revision; ++r) {
+        edits += "    float edit" + std::to_string(r) + " = " + std::to_string(r) + ".0;\n";
+    }
+    return text.substr(0, end) + edits + text.substr(end);
+}
@@ -0,0 +1,71 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Generates synthetic GLSL for benchmarks and fuzzing. The output depends only
+// on the options: randomness comes from std::mt19937, whose sequence is fixed
+// by the standard, and never goes through the implementation-defined
+// standard distributions.
+
+struct CorpusOptions {
+    uint32_t seed = 1;
+
+    // Number of shaders per stage.
+    int shaders = 1;
+
+    // File extensions of the stages to generate, as understood by
+    // find_language(). Empty means all of them.
+    std::vector<std::string> stages;
+
+    // Functions are added beyond `functions` until a shader reaches about
+    // `size` bytes.
+    int functions = 8;
+    size_t size = 0;
+
+    // Each shader includes a chain of this many headers. Headers use
+    // GL_GOOGLE_include_directive and have include guards.
+    int include_depth = 0;
+
+    // Fractions, between 0 and 1, of statements using a macro and of
+    // statements preceded by a comment (block comments and // comments
+    // continued with a backslash included).
+    double macro_density = 0.1;
+    double comment_density = 0.05;
+
+    // Structs per shader and members per struct or uniform block.
+    int structs = 2;
+    int struct_members = 4;
+
+    // Fraction of shaders with a compile error injected.
+    double error_rate = 0;
+};
+
+struct GeneratedFile {
+    // Relative to the corpus root.
+    std::string path;
+    std::string text;
+};
+
+struct Corpus {
+    std::vector<GeneratedFile> shaders;
+    std::vector<GeneratedFile> headers;
+};
+
+// The stages find_language() supports, by file extension.
+const std::vector<std::string>& corpus_stages();
+
+Corpus generate_corpus(const CorpusOptions& options);
+
+// A single shader of the given stage; `index` tells shaders of the same
+// options apart. Headers it includes are named <stem>_<level>.glsl.
+std::string generate_shader(const CorpusOptions& options, const std::string& stage, int index = 0,
+    std::vector<GeneratedFile>* headers = nullptr);
+
+// `text` as after the `revision`th edit of a user typing into its last
+// function body.
+std::string edit_shader(const std::string& text, int revision);
+
+#endif /* CORPUS_H */
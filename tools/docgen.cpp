@@ -0,0 +1,299 @@
+// Compiles docs/builtins.txt into the C++ source of the builtin
+// documentation table read by src/builtindocs.cpp: a minimal perfect hash over
+// the names and each entry's text compressed on its own against a shared
+// dictionary. See src/docstable.hpp for the format.
+//
+//     glslls_docgen docs/builtins.txt builtin_docs_table.cpp
+
+#include "docstable.hpp"
+#include "text.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Doc {
+    std::string name;
+    std::string signatures;
+    std::string description;
+};
+
+static bool parse_docs(const std::string& path, std::vector<Doc>& docs)
+{
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        std::fprintf(stderr, "%s: can't read\n", path.c_str());
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << stream.rdbuf();
+    const std::string text = buffer.str();
+
+    bool in_description = false;
+    int number = 0;
+    for (std::string_view line : split(text, "\n")) {
+        ++number;
+        line = trim_right(line);
+        if (line.substr(0, 1) == "#") {
+            continue;
+        }
+        if (line.substr(0, 1) == "@") {
+            Doc doc;
+            doc.name = trim(line.substr(1));
+            if (doc.name.empty()) {
+                std::fprintf(stderr, "%s:%d: expected a name after @\n", path.c_str(), number);
+                return false;
+            }
+            docs.push_back(std::move(doc));
+            in_description = false;
+            continue;
+        }
+        if (line.empty() && !in_description) {
+            continue;
+        }
+        if (docs.empty()) {
+            std::fprintf(stderr, "%s:%d: expected an entry, starting with @\n", path.c_str(), number);
+            return false;
+        }
+        Doc& doc = docs.back();
+        if (line == "--") {
+            in_description = true;
+        } else if (in_description) {
+            // Lines are joined into paragraphs, which blank lines separate.
+            if (line.empty()) {
+                doc.description += "\n\n";
+            } else {
+                if (!doc.description.empty() && doc.description.back() != '\n') {
+                    doc.description += ' ';
+                }
+                doc.description += line;
+            }
+        } else {
+            doc.signatures += line;
+            doc.signatures += '\n';
+        }
+    }
+
+    std::map<std::string, int> seen;
+    for (auto& doc : docs) {
+        doc.description = trim(doc.description);
+        if (seen[doc.name]++) {
+            std::fprintf(stderr, "%s: %s is documented twice\n", path.c_str(), doc.name.c_str());
+            return false;
+        }
+        if (doc.signatures.empty() || doc.description.empty()) {
+            std::fprintf(stderr, "%s: %s needs a signature and a description\n", path.c_str(), doc.name.c_str());
+            return false;
+        }
+        if (doc.signatures.size() + doc.description.size() > 0xffff) {
+            std::fprintf(stderr, "%s: %s is too long\n", path.c_str(), doc.name.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// Hash and displace: buckets of names are placed largest first, each with the
+// first displacement sending all of its names to free slots.
+static bool build_hash(const std::vector<Doc>& docs, std::vector<uint16_t>& displacements, std::vector<int>& slots)
+{
+    const uint32_t entry_count = static_cast<uint32_t>(docs.size());
+    const uint32_t bucket_count = std::max<uint32_t>(1, entry_count / 4);
+    std::vector<std::vector<int>> buckets(bucket_count);
+    for (int i = 0; i < static_cast<int>(docs.size()); ++i) {
+        buckets[docs_hash(docs[i].name, 0) % bucket_count].push_back(i);
+    }
+    std::vector<uint32_t> order(bucket_count);
+    for (uint32_t i = 0; i < bucket_count; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    displacements.assign(bucket_count, 0);
+    slots.assign(entry_count, -1);
+    for (uint32_t bucket : order) {
+        if (buckets[bucket].empty()) {
+            break;
+        }
+        bool placed = false;
+        for (uint32_t displacement = 1; displacement <= 0xffff && !placed; ++displacement) {
+            std::vector<uint32_t> taken;
+            for (int doc : buckets[bucket]) {
+                uint32_t slot = docs_hash(docs[doc].name, displacement) % entry_count;
+                if (slots[slot] != -1 || std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+                    break;
+                }
+                taken.push_back(slot);
+            }
+            if (taken.size() == buckets[bucket].size()) {
+                for (size_t i = 0; i < taken.size(); ++i) {
+                    slots[taken[i]] = buckets[bucket][i];
+                }
+                displacements[bucket] = static_cast<uint16_t>(displacement);
+                placed = true;
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs of one to four words seen more than once, the most bytes saved first,
+// until the dictionary is full. The most valuable go last, nearest to the
+// texts.
+static std::string build_dictionary(const std::vector<std::string>& texts, size_t capacity)
+{
+    std::map<std::string, int> counts;
+    for (const auto& text : texts) {
+        for (std::string_view line : split(text, "\n")) {
+            std::vector<size_t> starts;
+            for (size_t i = 0; i < line.size(); ++i) {
+                if (is_identifier_char(line[i]) && (i == 0 || !is_identifier_char(line[i - 1]))) {
+                    starts.push_back(i);
+                }
+            }
+            starts.push_back(line.size());
+            for (size_t first = 0; first + 1 < starts.size(); ++first) {
+                for (size_t words = 1; words <= 4 && first + words < starts.size(); ++words) {
+                    auto fragment = line.substr(starts[first], starts[first + words] - starts[first]);
+                    if (fragment.size() >= 4) {
+                        ++counts[std::string(fragment)];
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<std::pair<size_t, std::string>> scored;
+    for (const auto& [fragment, count] : counts) {
+        if (count > 1) {
+            scored.emplace_back((count - 1) * (fragment.size() - 2), fragment);
+        }
+    }
+    std::stable_sort(scored.begin(), scored.end(),
+        [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<std::string> chosen;
+    size_t size = 0;
+    for (const auto& [score, fragment] : scored) {
+        if (size + fragment.size() > capacity) {
+            continue;
+        }
+        bool covered = std::any_of(chosen.begin(), chosen.end(),
+            [&](const std::string& other) { return other.find(fragment) != std::string::npos; });
+        if (!covered) {
+            chosen.push_back(fragment);
+            size += fragment.size();
+        }
+    }
+    std::string dictionary;
+    for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) {
+        dictionary += *it;
+    }
+    return dictionary;
+}
+
+static void write_bytes(std::ostream& out, const std::string& bytes)
+{
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        out << (i % 16 == 0 ? "\n   " : "") << ' ' << static_cast<unsigned>(static_cast<unsigned char>(bytes[i])) << ',';
+    }
+    out << '\n';
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3) {
+        std::fprintf(stderr, "Usage: %s BUILTINS_TXT OUTPUT_CPP\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<Doc> docs;
+    if (!parse_docs(argv[1], docs)) {
+        return 1;
+    }
+    if (docs.empty()) {
+        std::fprintf(stderr, "%s: no entries\n", argv[1]);
+        return 1;
+    }
+    std::vector<uint16_t> displacements;
+    std::vector<int> slots;
+    if (!build_hash(docs, displacements, slots)) {
+        std::fprintf(stderr, "Couldn't build a perfect hash of %zu names\n", docs.size());
+        return 1;
+    }
+
+    std::vector<std::string> texts;
+    size_t text_size = 0;
+    for (const auto& doc : docs) {
+        texts.push_back(doc.signatures + doc.description);
+        text_size += texts.back().size();
+    }
+    const std::string dictionary = build_dictionary(texts, 2048);
+
+    std::string names;
+    std::string data;
+    std::ostringstream entries;
+    for (int doc : slots) {
+        const std::string& text = texts[doc];
+        std::string compressed = lz_compress(text, dictionary);
+        std::string check;
+        if (!lz_decompress(reinterpret_cast<const uint8_t*>(compressed.data()), compressed.size(), dictionary,
+                text.size(), check)
+            || check != text) {
+            std::fprintf(stderr, "%s doesn't survive compression\n", docs[doc].name.c_str());
+            return 1;
+        }
+        entries << "    { " << names.size() << ", " << data.size() << ", " << docs[doc].name.size() << ", "
+                << compressed.size() << ", " << text.size() << ", " << docs[doc].signatures.size() << " }, // "
+                << docs[doc].name << '\n';
+        names += docs[doc].name;
+        data += compressed;
+    }
+
+    std::ostringstream out;
+    out << "// Generated by tools/docgen.cpp from " << argv[1] << ". Do not edit.\n"
+        << "// " << docs.size() << " entries, " << text_size << " bytes of text in " << data.size()
+        << " bytes with a dictionary of " << dictionary.size() << ".\n\n"
+        << "#include \"docstable.hpp\"\n\n"
+        << "static const DocsEntry entries[] = {\n" << entries.str() << "};\n\n"
+        << "static const uint16_t displacements[] = {";
+    for (size_t i = 0; i < displacements.size(); ++i) {
+        out << (i % 16 == 0 ? "\n   " : "") << ' ' << displacements[i] << ',';
+    }
+    out << "\n};\n\n"
+        << "static const char names[] = {";
+    write_bytes(out, names);
+    out << "};\n\n"
+        << "static const uint8_t data[] = {";
+    write_bytes(out, data);
+    out << "};\n\n"
+        << "static const uint8_t dictionary[] = {";
+    write_bytes(out, dictionary);
+    out << "};\n\n"
+        << "const DocsTable builtin_docs_table = {\n"
+        << "    entries,\n"
+        << "    " << docs.size() << ",\n"
+        << "    displacements,\n"
+        << "    " << displacements.size() << ",\n"
+        << "    names,\n"
+        << "    data,\n"
+        << "    dictionary,\n"
+        << "    " << dictionary.size() << ",\n"
+        << "};\n";
+
+    std::ofstream file(argv[2], std::ios::binary);
+    file << out.str();
+    if (!file) {
+        std::fprintf(stderr, "%s: can't write\n", argv[2]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Writes a synthetic GLSL corpus, as used by the benchmarks and the fuzzer,
+// to a directory. The same options always produce the same files, so a
+// corpus can be described by its command line instead of being shipped.
+
+#include "CLI/CLI.hpp"
+
+#include "corpus.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <experimental/filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+static bool write_files(const fs::path& out, const std::vector<GeneratedFile>& files, size_t& bytes)
+{
+    for (const auto& file : files) {
+        std::ofstream stream(out / file.path, std::ios::binary);
+        stream << file.text;
+        if (!stream) {
+            std::fprintf(stderr, "Can't write %s\n", (out / file.path).string().c_str());
+            return false;
+        }
+        bytes += file.text.size();
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    CLI::App app{ "Synthetic GLSL corpus generator" };
+
+    CorpusOptions options;
+    std::string out = "corpus";
+
+    app.add_option("--seed", options.seed, "Seed of the generator", true);
+    app.add_option("--shaders", options.shaders, "Shaders per stage", true);
+    app.add_option("--stage", options.stages, "Stages to generate, by file extension (default: all)");
+    app.add_option("--functions", options.functions, "Minimum number of functions per shader", true);
+    app.add_option("--size", options.size, "Approximate minimum size of a shader in bytes", true);
+    app.add_option("--include-depth", options.include_depth, "Length of each shader's chain of headers", true);
+    app.add_option("--macro-density", options.macro_density, "Fraction of expressions using a macro", true);
+    app.add_option("--comment-density", options.comment_density, "Fraction of statements preceded by a comment", true);
+    app.add_option("--structs", options.structs, "Structs per file", true);
+    app.add_option("--struct-members", options.struct_members, "Members per struct and uniform block", true);
+    app.add_option("--error-rate", options.error_rate, "Fraction of shaders with a compile error", true);
+    app.add_option("--out", out, "Directory the corpus is written to", true);
+
+    CLI11_PARSE(app, argc, argv);
+
+    for (const auto& stage : options.stages) {
+        const auto& stages = corpus_stages();
+        if (std::find(stages.begin(), stages.end(), stage) == stages.end()) {
+            std::fprintf(stderr, "Unknown stage %s\n", stage.c_str());
+            return 1;
+        }
+    }
+
+    auto corpus = generate_corpus(options);
+    fs::create_directories(out);
+    size_t bytes = 0;
+    if (!write_files(out, corpus.shaders, bytes) || !write_files(out, corpus.headers, bytes)) {
+        return 1;
+    }
+    std::printf("%zu shaders, %zu headers, %zu bytes written to %s\n",
+        corpus.shaders.size(), corpus.headers.size(), bytes, out.c_str());
+    return 0;
+}